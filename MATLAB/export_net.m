@@ -0,0 +1,104 @@
+function export_net(net, filename)
+%EXPORT_NET writes a feedforward network to a text file for nn-eval
+%
+% export_net(NET, FILENAME) takes a trained feedforward network NET (e.g.
+% a feedforwardnet or patternnet, see setup_default_pnet) and writes its
+% input and output processing (removeconstantrows, mapminmax), the weights
+% and biases and the transfer functions of all layers to FILENAME, such
+% that it can be evaluated by nn-eval (nn_inference.h) without MATLAB.
+%
+% Supported are networks with one input, layers that are connected one
+% after another (as created by feedforwardnet and patternnet) and the
+% transfer functions tansig, logsig, purelin and softmax.
+%
+% Format (all numbers with full precision, matrices row by row):
+% # nn-net NLAYERS
+% # inputs NRAW NUSED       (NUSED <= NRAW after removeconstantrows)
+% indices of the used inputs (0-based)
+% xoffset, gain (NUSED values each) and ymin of mapminmax
+% # layer NOUT NIN TRANSFERFCN
+% weights (NOUT lines with NIN values), biases (one line with NOUT values)
+% ...
+% # outputs NOUT
+% xoffset, gain (NOUT values each) and ymin of the (reverse) mapminmax
+
+% by Thomas Madlener, 2015
+
+if nargin < 2, error('Requires a network and a file name.'); end
+if ~isa(net, 'network'), error('first argument is no network'), end
+if net.numInputs ~= 1, error('only networks with one input are supported'), end
+nLayers = net.numLayers;
+for i = 2:nLayers
+    if any(net.layerConnect(i,:) ~= ((1:nLayers) == i-1))
+        error('only layers that are connected one after another are supported')
+    end
+end
+
+fid = fopen(filename, 'w');
+if fid < 0, error(['could not open ' filename]), end
+
+fprintf(fid, '# nn-net %d\n', nLayers);
+
+% input processing
+nRaw = net.inputs{1}.size;
+[used, xoffset, gain, ymin] = get_processing(net.inputs{1}, nRaw);
+fprintf(fid, '# inputs %d %d\n', nRaw, length(used));
+write_row(fid, used - 1);
+write_row(fid, xoffset);
+write_row(fid, gain);
+write_row(fid, ymin);
+
+% layers
+for i = 1:nLayers
+    if i == 1, W = net.IW{1,1}; else W = net.LW{i,i-1}; end
+    transferFcn = net.layers{i}.transferFcn;
+    if ~any(strcmp(transferFcn, {'tansig', 'logsig', 'purelin', 'softmax'}))
+        fclose(fid);
+        error(['transfer function ' transferFcn ' is not supported'])
+    end
+    fprintf(fid, '# layer %d %d %s\n', size(W,1), size(W,2), transferFcn);
+    for j = 1:size(W,1), write_row(fid, W(j,:)); end
+    write_row(fid, net.b{i});
+end
+
+% output processing (reverse mapminmax, removeconstantrows is not undone)
+nOut = net.outputs{nLayers}.size;
+[~, xoffset, gain, ymin] = get_processing(net.outputs{nLayers}, nOut);
+fprintf(fid, '# outputs %d\n', length(xoffset));
+write_row(fid, xoffset);
+write_row(fid, gain);
+write_row(fid, ymin);
+
+fclose(fid);
+end
+
+function [used, xoffset, gain, ymin] = get_processing(io, n)
+%GET_PROCESSING collects the settings of removeconstantrows and mapminmax
+% of an input or output (identity if they are not used)
+used = 1:n;
+xoffset = zeros(1, n);
+gain = ones(1, n);
+ymin = 0;
+for k = 1:length(io.processFcns)
+    settings = io.processSettings{k};
+    switch io.processFcns{k}
+        case 'removeconstantrows'
+            used = used(settings.keep);
+            xoffset = xoffset(settings.keep);
+            gain = gain(settings.keep);
+        case 'mapminmax'
+            xoffset = settings.xoffset(:)';
+            gain = settings.gain(:)';
+            ymin = settings.ymin;
+        otherwise
+            warning(['ignoring processing function ' io.processFcns{k}])
+    end
+end
+end
+
+function write_row(fid, values)
+%WRITE_ROW writes a vector as one line with full precision
+fprintf(fid, '%.17g ', values(1:end-1));
+if ~isempty(values), fprintf(fid, '%.17g', values(end)); end
+fprintf(fid, '\n');
+end
@@ -0,0 +1,62 @@
+function [x] = matfile_readin(filename, varargin)
+%MATFILE_READIN read in MAT-file(s) written by root2dat
+%
+% [X] = matfile_readin(FILENAME, VARNAME, CONCAT) takes a filename FILENAME
+% of a MAT-file written by root2dat (i.e. root2dat input.root output.mat)
+% and returns the NxM matrix stored in it, where N is the number of values
+% per sample (same order as in the .dat files) and M is the number of
+% samples. This is the same matrix that datfile_readin returns for the
+% corresponding .dat file, but without any text parsing and without the loss
+% of precision of the .dat files. VARNAME is the name of the matrix in the
+% MAT-file (defaults to 'data', root2dat -v changes it).
+% The FILENAME can contain wildcards such that all files fitting the
+% wildcard will be loaded. If all data from the read in files shall be
+% concatenated set CONCAT to true (defaults to true). If CONCAT is set to
+% false the function returns a cell-array of NxM matrices.
+
+% by Thomas Madlener, 2015
+
+varname = 'data';
+concat = true;
+if ~isempty(varargin)
+    validateattributes(varargin{1}, {'char'}, {'nonempty'}, 'matfile_readin', 'varname');
+    varname = varargin{1};
+end
+if length(varargin) > 1
+    validateattributes(varargin{2}, {'logical'},{'nonnan'}, 'matfile_readin', 'concat');
+    concat = varargin{2};
+end
+validateattributes(filename, {'char'}, {'nonempty'}, 'matfile_readin', 'filename');
+
+files=dir(filename); % expand wildcard and get all files
+if isempty(files)
+    error('Found no file matching: %s', filename)
+end
+if length(files) == 1 % if there is only one file do not put the values into a cell
+    concat = true;
+end
+
+% dir does not return the path -> take it from the passed filename
+directories = strsplit(filename,'/');
+dirname = strjoin(directories(1:end-1), '/');
+if ~isempty(dirname), dirname = [dirname, '/']; end
+
+if ~concat
+    x = cell(size(files));
+else
+    x = [];
+end
+
+for i=1:length(files)
+    fname = [dirname, files(i).name];
+    tmp = load(fname, varname);
+    if ~isfield(tmp, varname)
+        error('Found no variable %s in file: %s', varname, fname)
+    end
+    fprintf('Loaded file: %s\n', fname)
+    if ~concat
+        x{i} = tmp.(varname);
+    else
+        x = [x, tmp.(varname)];
+    end
+end
@@ -1,15 +1,55 @@
 #pragma once
 
 #include "RootBranch.hpp"
+#include "RootCut.hpp"
+#include "RootColumnCache.hpp"
 
 namespace RootToolBox {
 
+  /** check if the branch holds a single value per entry (leaf branch, e.g. "Z0/D") instead of an object (e.g. a std::vector) */
+  inline bool isScalarBranch(TBranch* branch) { return branch != 0 && std::string(branch->GetClassName()).empty(); }
+
+  /**
+   * helper class that reads single entries of a branch that holds either a std::vector<T> or a single T (scalar branch) per entry.
+   * Sets the address of the branch on construction and resets it on destruction
+   */
+  template<typename T> class BranchEntryReader {
+  public:
+    BranchEntryReader(TBranch* branch, bool scalar) : __branch(branch), __scalar(scalar), __vector(0), __value()
+    {
+      if(__scalar) __branch->SetAddress(&__value);
+      else __branch->SetAddress(&__vector);
+    }
+
+    ~BranchEntryReader() { __branch->ResetAddress(); delete __vector; }
+
+    /** read entry iEvent. @returns the return value of TBranch::GetEntry (<= 0 on failure) */
+    int get(Long64_t iEvent) { int getRes = __branch->GetEntry(iEvent); return (__scalar || __vector != 0) ? getRes : 0; }
+
+    size_t size() const { return __scalar ? 1 : __vector->size(); } /**< number of values in the current entry */
+
+    T operator[](size_t i) const { return __scalar ? __value : (*__vector)[i]; } /**< value i of the current entry */
+
+    /** append all values of the current entry to values */
+    void appendTo(std::vector<T>& values) const
+    {
+      if(__scalar) values.push_back(__value);
+      else values.insert(values.end(), __vector->begin(), __vector->end());
+    }
+
+  private:
+    TBranch* __branch; /**< the branch */
+    bool __scalar; /**< scalar branch */
+    std::vector<T>* __vector; /**< buffer for vector branches (allocated by ROOT) */
+    T __value; /**< buffer for scalar branches */
+  };
+
     /** class that holds the data that is in a branch */
   template<typename T> class RootBranchData {
   public:
 
     /** empty ctor */
-    RootBranchData() : __branch(NULL), __name("") {}
+    RootBranchData() : __branch(NULL), __name(""), __scalar(false) {}
 
     /** ctor from string and TTree */
     RootBranchData(std::string name, TTree* tree);
@@ -17,6 +57,48 @@ namespace RootToolBox {
     /** fetch data from event (iEvent) from the rootfile and add it to the __data vector */
     void addEvent(int iEvent);
 
+    /** allocate nChunks (empty) chunks that can be filled independently (e.g. from different threads) by fetchChunk */
+    void prepareChunks(size_t nChunks) { __chunks.clear(); __chunks.resize(nChunks); }
+
+    /**
+     * fetch the data from events between iEvent1 and iEvent2 (including iEvent1, excluding iEvent2) into chunk iChunk.
+     * The passed tree has to contain a branch with the name of this branch, but can be a different TTree instance than the one
+     * used at construction (i.e. from a TFile handle owned by another thread).
+     * NOTE: different chunks can be filled concurrently, as long as every thread uses its own TTree instance
+     */
+    void fetchChunk(TTree* tree, size_t iChunk, int iEvent1, int iEvent2);
+
+    /** append all chunks (in order) to the __data vector and release the memory of the chunks */
+    void mergeChunks();
+
+    /**
+     * read the data from events between iEvent1 and iEvent2 (including iEvent1, excluding iEvent2) into values (without adding
+     * them to __data). The number of values per event is stored in nValues
+     * @returns false if any of the entries could not be read (for these 0 values are stored)
+     */
+    bool readEvents(int iEvent1, int iEvent2, std::vector<T>& values, std::vector<size_t>& nValues);
+
+    /**
+     * fetch the data from event iEvent and add only the values for which the bit in the bitmap is set to __data.
+     * @param offset, the position of the first value of this event in the bitmap
+     */
+    void addEventSelected(int iEvent, const SelectionBitmap& bitmap, size_t offset);
+
+    /** add all values for which the bit in the bitmap is set to __data */
+    void addSelected(const std::vector<T>& values, const SelectionBitmap& bitmap);
+
+    /** keep only the values in __data for which the bit in the bitmap is set (bitmap has to have the same size as __data) */
+    void applySelection(const SelectionBitmap& bitmap);
+
+    /**
+     * fetch the data from all events and add them to the __data vector. If there is a valid column in the cache it is taken from
+     * there, else the data are read from the file and stored in the cache afterwards (only if all entries could be read, such that
+     * an incomplete column is never cached).
+     * @param cached, set to true if the data were taken from the cache
+     * @returns false if not all entries could be read
+     */
+    bool fetchAllCached(const RootColumnCache& cache, const std::string& treename, bool& cached);
+
     /** get (a reference to the vector) data */
     const std::vector<T>& getData() const { return __data; }
 
@@ -25,21 +107,28 @@ namespace RootToolBox {
 
     TBranch* getBranchPtr() const { return __rootBranch.getBranchPtr(); }
 
+    /** check if the branch holds a single value per entry (instead of a std::vector) */
+    bool isScalar() const { return __scalar; }
+
     void print() const { __rootBranch.print(); }
 
   protected:
     std::vector<T> __data; /**< content of the branch */ // NOTE: somehow this has to be expanded to take other types aswell!
 
+    std::vector<std::vector<T> > __chunks; /**< partial contents of the branch, filled by fetchChunk and merged into __data */
+
     RootToolBox::RootBranch __rootBranch;
 
     TBranch* __branch;
     std::string __name;
+    bool __scalar; /**< branch holds one value per entry */
   };
 
   template<typename T>
   RootBranchData<T>::RootBranchData(std::string name, TTree* tree) : __name(name)
   {
     __branch = tree->GetBranch(name.c_str());
+    __scalar = isScalarBranch(__branch);
   }
 
   // ================================================= FETCH DATA =================================================================
@@ -51,11 +140,8 @@ namespace RootToolBox {
       return;
     }
 
-    std::vector<T>* tmp = 0; // temporary pointer to vector needed for SetAddress
-    __branch->SetAddress(&tmp);
-    __branch->GetEntry(iEvent);
-
-    int getRes = __branch->GetEntry(iEvent); // preserve value to do some error catching
+    BranchEntryReader<T> entry(__branch, __scalar);
+    int getRes = entry.get(iEvent); // preserve value to do some error catching
     if(getRes == 0) {
       std::cout << "entry " << iEvent << " does not exist for branch " << __name <<  "!" << std::endl;
       return;
@@ -63,12 +149,119 @@ namespace RootToolBox {
       std::cout << "ERROR: there was a I/O conversion issue while getting entry " << iEvent << " from branch " << __name << std::endl;
       return;
     }
-    if(tmp != 0) {
-      for(T d : *tmp) {
-	__data.push_back(d);
-// 	std::cout << " added " << d << " to __data" << std::endl;
+    entry.appendTo(__data);
+  }
+
+  // ================================================= FETCH CHUNK ================================================================
+  template<typename T>
+  void RootBranchData<T>::fetchChunk ( TTree* tree, size_t iChunk, int iEvent1, int iEvent2 )
+  {
+    TBranch* branch = tree->GetBranch(__name.c_str());
+    if(branch == 0) {
+      std::cout << "could not find branch " << __name << " in passed tree. Not fetching chunk " << iChunk << std::endl;
+      return;
+    }
+
+    BranchEntryReader<T> entry(branch, __scalar);
+    std::vector<T>& chunk = __chunks[iChunk];
+    if(__scalar) chunk.reserve(chunk.size() + iEvent2 - iEvent1);
+    for(int i = iEvent1; i < iEvent2; ++i) {
+      int getRes = entry.get(i);
+      if(getRes <= 0) {
+        std::cout << "ERROR: could not get entry " << i << " from branch " << __name << " (return value " << getRes << ")" << std::endl;
+        continue;
+      }
+      entry.appendTo(chunk);
+    }
+  }
+
+  // ================================================= MERGE CHUNKS ===============================================================
+  template<typename T>
+  void RootBranchData<T>::mergeChunks()
+  {
+    size_t nTotal = __data.size();
+    for(const std::vector<T>& chunk : __chunks) nTotal += chunk.size();
+    __data.reserve(nTotal);
+
+    for(const std::vector<T>& chunk : __chunks) __data.insert(__data.end(), chunk.begin(), chunk.end());
+    std::vector<std::vector<T> >().swap(__chunks);
+  }
+
+  // ================================================= READ EVENTS ================================================================
+  template<typename T>
+  bool RootBranchData<T>::readEvents ( int iEvent1, int iEvent2, std::vector<T>& values, std::vector<size_t>& nValues )
+  {
+    bool ok = true;
+    BranchEntryReader<T> entry(__branch, __scalar);
+    if(__scalar) values.reserve(values.size() + iEvent2 - iEvent1);
+    for(int i = iEvent1; i < iEvent2; ++i) {
+      int getRes = entry.get(i);
+      if(getRes <= 0) {
+        std::cout << "ERROR: could not get entry " << i << " from branch " << __name << " (return value " << getRes << ")" << std::endl;
+        nValues.push_back(0);
+        ok = false;
+        continue;
+      }
+      entry.appendTo(values);
+      nValues.push_back(entry.size());
+    }
+    return ok;
+  }
+
+  // ============================================= SELECTED DATA HANDLING =========================================================
+  template<typename T>
+  void RootBranchData<T>::addEventSelected ( int iEvent, const SelectionBitmap& bitmap, size_t offset )
+  {
+    BranchEntryReader<T> entry(__branch, __scalar);
+    int getRes = entry.get(iEvent);
+    if(getRes <= 0) {
+      std::cout << "ERROR: could not get entry " << iEvent << " from branch " << __name << " (return value " << getRes << ")" << std::endl;
+    } else {
+      for(size_t i = 0; i < entry.size() && offset + i < bitmap.size(); ++i) {
+        if(bitmap.test(offset + i)) __data.push_back(entry[i]);
       }
     }
+  }
+
+  template<typename T>
+  void RootBranchData<T>::addSelected ( const std::vector<T>& values, const SelectionBitmap& bitmap )
+  {
+    __data.reserve(__data.size() + bitmap.count());
+    for(size_t i = 0; i < values.size(); ++i) {
+      if(bitmap.test(i)) __data.push_back(values[i]);
+    }
+  }
+
+  template<typename T>
+  void RootBranchData<T>::applySelection ( const SelectionBitmap& bitmap )
+  {
+    if(bitmap.size() != __data.size()) {
+      std::cout << "ERROR: cannot apply selection with " << bitmap.size() << " entries to branch " << __name << " with " << __data.size() << " entries" << std::endl;
+      return;
+    }
+    size_t nKept = 0;
+    for(size_t i = 0; i < __data.size(); ++i) {
+      if(bitmap.test(i)) __data[nKept++] = __data[i];
+    }
+    __data.resize(nKept);
+  }
+
+  // ================================================= FETCH ALL CACHED ===========================================================
+  template<typename T>
+  bool RootBranchData<T>::fetchAllCached ( const RootColumnCache& cache, const std::string& treename, bool& cached )
+  {
+    std::vector<T> values;
+    bool ok = true;
+    cached = cache.load(treename, __name, values);
+    if(!cached) {
+      std::vector<size_t> nValues;
+      ok = readEvents(0, __branch->GetEntries(), values, nValues);
+      if(ok) cache.store(treename, __name, values);
+      else std::cout << "ERROR: branch " << __name << " could not be read completely, not storing it in the cache" << std::endl;
+    }
 
+    if(__data.empty()) __data.swap(values);
+    else __data.insert(__data.end(), values.begin(), values.end());
+    return ok;
   }
 }
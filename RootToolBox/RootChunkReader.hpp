@@ -0,0 +1,197 @@
+// tmadlener: my try on making some kind of a toolbox that can be easily reused to handle root stuff
+// RootChunkReader: reads only some (projected) branches of a tree in chunks of events
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <tuple>
+#include <algorithm>
+
+#include "RootFile.hpp"
+#include "RootBranchData.hpp"
+#include "toolboxhelper.hpp"
+
+// boost
+#include <boost/any.hpp>
+
+namespace RootToolBox {
+
+  /**
+   * class that reads the data of only the requested branches of a tree in chunks of a fixed number of events.
+   * The buffers holding the data of a chunk are reused for every chunk, so that the memory needed is bounded by the chunk size.
+   * usage:
+   *   RootChunkReader reader(file, "testtree", {"Z0", "Z1"}, 1000);
+   *   while(reader.next()) { const std::vector<double>& z0 = reader.getColumn<double>("Z0"); ... }
+   */
+  class RootChunkReader {
+  public:
+
+    /** ctor from a tree, the names of the branches that shall be read and the number of events per chunk */
+    RootChunkReader(TTree* tree, std::vector<std::string> branchnames, int chunkSize);
+
+    /** ctor from a RootFile and the name of the tree */
+    RootChunkReader(const RootFile& file, std::string treename, std::vector<std::string> branchnames, int chunkSize) :
+      RootChunkReader(file.getTree(treename).getTreePtr(), branchnames, chunkSize) {}
+
+    /** dtor */
+    ~RootChunkReader();
+
+    /** read the next chunk into the buffers. @returns false if there are no more events */
+    bool next();
+
+    /** start reading again at event iEvent on the next call to next() */
+    void reset(int iEvent = 0) { __nextEvent = iEvent; __firstEvent = __lastEvent = iEvent; }
+
+    /** get the data of the current chunk of the branch with name @param name */
+    template<typename T>
+    const std::vector<T>& getColumn(std::string name) const;
+
+    /**
+     * get the data of the current chunk of the branch with index @param index (in the order passed to the ctor). Branches with an unknown
+     * type keep their index, but their data cannot be got (exits, as for a wrong T)
+     */
+    template<typename T>
+    const std::vector<T>& getColumn(int index) const;
+
+    size_t getNValues() const { return __nValues; } /**< get the number of values (per branch) in the current chunk */
+
+    int getFirstEvent() const { return __firstEvent; } /**< get the first event of the current chunk */
+
+    int getLastEvent() const { return __lastEvent; } /**< get the last event (excluded) of the current chunk */
+
+    int getNEvents() const { return __nEvents; } /**< get the number of events in the tree */
+
+  protected:
+    std::vector<std::tuple<boost::any, std::string, e_dataTypes> > __branchdata; /**< the branches that are read */
+    RootToolBox::NameIndex __branchindex; /**< index of the branches by name */
+    std::vector<boost::any> __buffers; /**< std::vector of the right type for every branch (reused for every chunk) */
+    std::vector<size_t> __nValuesPerEvent; /**< buffer for the number of values in every event (reused for every chunk) */
+
+    int __chunkSize; /**< number of events per chunk */
+    int __nEvents; /**< number of events in the tree */
+    int __nextEvent; /**< first event of the next chunk */
+    int __firstEvent; /**< first event of the current chunk */
+    int __lastEvent; /**< last event (excluded) of the current chunk */
+    size_t __nValues; /**< number of values in the current chunk */
+
+    /** read the events of the current chunk for the branch with index iBr */
+    template<typename T>
+    size_t readChunk(size_t iBr);
+
+  private:
+    RootChunkReader(const RootChunkReader&); /**< not copyable (owns the RootBranchData in __branchdata) */
+    RootChunkReader& operator=(const RootChunkReader&); /**< not copyable (owns the RootBranchData in __branchdata) */
+  };
+
+  // ================================================== CTOR ======================================================================
+  RootChunkReader::RootChunkReader ( TTree* tree, std::vector<std::string> branchnames, int chunkSize ) :
+    __chunkSize(std::max(chunkSize, 1)), __nEvents(0), __nextEvent(0), __firstEvent(0), __lastEvent(0), __nValues(0)
+  {
+    if(tree == 0) {
+      std::cout << "passed tree to RootChunkReader is invalid! Not reading anything" << std::endl;
+      return;
+    }
+    __nEvents = tree->GetEntries();
+
+    for(std::string name : branchnames) {
+      size_t nBefore = __branchdata.size();
+      addBranchDataToTree(__branchdata, tree, name);
+      if(__branchdata.size() == nBefore) { // unknown type (warning already printed): keep an empty slot, such that the indices match
+        __branchdata.push_back(std::make_tuple(boost::any(), name, c_unknown));
+      }
+
+      switch(std::get<2>(__branchdata.back())) {
+      case c_double: __buffers.push_back(std::vector<double>()); break;
+      case c_int: __buffers.push_back(std::vector<int>()); break;
+      case c_uint: __buffers.push_back(std::vector<unsigned int>()); break;
+      case c_usint: __buffers.push_back(std::vector<unsigned short int>()); break;
+      default: __buffers.push_back(boost::any());
+      }
+      __branchindex.insert(std::make_pair(name, __branchdata.size() - 1));
+    }
+  }
+
+  // ================================================== DTOR ======================================================================
+  RootChunkReader::~RootChunkReader()
+  {
+    for(size_t iBr = 0; iBr < __branchdata.size(); ++iBr) {
+      switch(std::get<2>(__branchdata[iBr])) {
+      case c_double: delete boost::any_cast<RootBranchData<double>*>(std::get<0>(__branchdata[iBr])); break;
+      case c_int: delete boost::any_cast<RootBranchData<int>*>(std::get<0>(__branchdata[iBr])); break;
+      case c_uint: delete boost::any_cast<RootBranchData<unsigned int>*>(std::get<0>(__branchdata[iBr])); break;
+      case c_usint: delete boost::any_cast<RootBranchData<unsigned short int>*>(std::get<0>(__branchdata[iBr])); break;
+      default: break;
+      }
+    }
+  }
+
+  // ================================================== NEXT ======================================================================
+  bool RootChunkReader::next()
+  {
+    if(__nextEvent >= __nEvents || __branchdata.empty()) return false;
+
+    __firstEvent = __nextEvent;
+    __lastEvent = std::min(__nEvents, __firstEvent + __chunkSize);
+    __nextEvent = __lastEvent;
+
+    int iFirst = -1; // first branch that could be read
+    for(size_t iBr = 0; iBr < __branchdata.size(); ++iBr) {
+      size_t nValues = 0;
+      switch(std::get<2>(__branchdata[iBr])) {
+      case c_double: nValues = readChunk<double>(iBr); break;
+      case c_int: nValues = readChunk<int>(iBr); break;
+      case c_uint: nValues = readChunk<unsigned int>(iBr); break;
+      case c_usint: nValues = readChunk<unsigned short int>(iBr); break;
+      default: continue; // empty slot of a branch with unknown type
+      }
+      if(iFirst < 0) {
+        iFirst = iBr;
+        __nValues = nValues;
+      } else if(nValues != __nValues) {
+        std::cout << "WARNING: branch " << std::get<1>(__branchdata[iBr]) << " has " << nValues << " values in events " << __firstEvent
+                  << " to " << __lastEvent << ", but branch " << std::get<1>(__branchdata[iFirst]) << " has " << __nValues << std::endl;
+        __nValues = std::min(nValues, __nValues);
+      }
+    }
+    if(iFirst < 0) return false; // none of the branches can be read
+
+    return true;
+  }
+
+  template<typename T>
+  size_t RootChunkReader::readChunk ( size_t iBr )
+  {
+    std::vector<T>& buffer = *boost::any_cast<std::vector<T> >(&__buffers[iBr]);
+    buffer.clear(); // keeps the capacity, so that no reallocation is necessary for chunks of similar size
+    __nValuesPerEvent.clear();
+    boost::any_cast<RootBranchData<T>*>(std::get<0>(__branchdata[iBr]))->readEvents(__firstEvent, __lastEvent, buffer, __nValuesPerEvent);
+    return buffer.size();
+  }
+
+  // ================================================== GET COLUMN ================================================================
+  template<typename T>
+  const std::vector<T>& RootChunkReader::getColumn ( std::string name ) const
+  {
+    int pos = getPositionByName(__branchindex, name);
+    if(pos != -1) return getColumn<T>(pos);
+    else std::cout << "found no Branch with name " << name << " in RootChunkReader" << std::endl;
+
+    exit(-2);
+  }
+
+  template<typename T>
+  const std::vector<T>& RootChunkReader::getColumn ( int index ) const
+  {
+    if(index >= 0 && (uint) index < __buffers.size()) { // WARNING: c-style cast to suppress compiler warning
+      const std::vector<T>* column = boost::any_cast<std::vector<T> >(&__buffers[index]);
+      if(column != 0) return *column;
+      std::cout << "branch " << std::get<1>(__branchdata[index]) << " has an unknown type or is not of the requested type" << std::endl;
+    }
+    else std::cout << "index is out of range!" << std::endl;
+
+    exit(-2);
+  }
+
+}
@@ -0,0 +1,256 @@
+// tmadlener: my try on making some kind of a toolbox that can be easily reused to handle root stuff
+// RootColumnCache: persistent on-disk cache of decoded branch data (columns), to avoid paying the decompression on every run
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+
+// POSIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "toolboxtypes.hpp"
+
+namespace RootToolBox {
+
+  /** get the e_dataTypes value for a type (c_unknown for all types that cannot be cached) */
+  template<typename T> struct CacheDataType { static const int value = c_unknown; };
+  template<> struct CacheDataType<double> { static const int value = c_double; };
+  template<> struct CacheDataType<int> { static const int value = c_int; };
+  template<> struct CacheDataType<unsigned int> { static const int value = c_uint; };
+  template<> struct CacheDataType<unsigned short int> { static const int value = c_usint; };
+
+  /**
+   * header of a cache file. the file layout is:
+   * header | source path | tree name | branch name | padding to c_cacheAlignment | values (raw, native byte order)
+   * the values start at an aligned offset, so that the file can be mmapped and used directly
+   */
+  struct CacheFileHeader {
+    char magic[8]; /**< always "RTBCOL01" */
+    int64_t sourceSize; /**< size of the source file in bytes */
+    int64_t sourceMTime; /**< modification time of the source file in ns */
+    int32_t dataType; /**< e_dataTypes of the values */
+    uint32_t valueSize; /**< sizeof one value */
+    uint64_t nValues; /**< number of values */
+    uint32_t pathLength; /**< length of the source path (following the header) */
+    uint32_t treeLength; /**< length of the tree name (following the source path) */
+    uint32_t branchLength; /**< length of the branch name (following the tree name) */
+    uint32_t padding; /**< unused */
+    uint64_t dataOffset; /**< offset of the first value from the start of the file */
+  };
+
+  /** alignment of the values in the cache file */
+  const uint64_t c_cacheAlignment = 64;
+
+  /**
+   * class handling the cached columns of one source (root) file.
+   * The cache files are keyed by the (absolute) path, size and modification time of the source file, as well as tree and branch name.
+   * If the source file changes (size or modification time), the cached columns are no longer valid and are rewritten on the next store.
+   * The cache directory is taken from the environment variable ROOTTOOLBOX_CACHE_DIR (if it is set to an empty string, caching is
+   * disabled), and defaults to $HOME/.cache/roottoolbox
+   */
+  class RootColumnCache {
+  public:
+
+    /** ctor from the name of the source file */
+    RootColumnCache(std::string sourcefile);
+
+    /** ctor from the name of the source file and the cache directory (empty to disable caching) */
+    RootColumnCache(std::string sourcefile, std::string cachedir);
+
+    bool enabled() const { return __enabled; } /**< check if the cache can be used */
+
+    /** load the cached column for branch @param branch in tree @param tree into data. @returns false if there is no valid cached column */
+    template<typename T>
+    bool load(std::string tree, std::string branch, std::vector<T>& data) const;
+
+    /** store the column for branch @param branch in tree @param tree in the cache. @returns false if this was not possible */
+    template<typename T>
+    bool store(std::string tree, std::string branch, const std::vector<T>& data) const;
+
+    std::string getCacheDir() const { return __cachedir; } /**< get the cache directory */
+
+  protected:
+    std::string __sourcepath; /**< absolute path of the source file */
+    std::string __cachedir; /**< directory holding the cache files */
+    int64_t __sourceSize; /**< size of the source file */
+    int64_t __sourceMTime; /**< modification time of the source file in ns */
+    bool __enabled; /**< can the cache be used */
+
+    void init(std::string sourcefile, std::string cachedir); /**< stat the source file and create the cache directory */
+
+    std::string getCacheFileName(const std::string& tree, const std::string& branch) const; /**< get the name of the cache file */
+
+    /** check if the header (and the names following it) match this source file and the passed tree and branch */
+    bool checkHeader(const char* mapped, size_t fileSize, const std::string& tree, const std::string& branch, int dataType, size_t valueSize) const;
+  };
+
+  // ================================================== HELPERS ===================================================================
+  /** 64 bit FNV-1a hash of a string */
+  inline uint64_t fnv1aHash(const std::string& str, uint64_t hash = 14695981039346656037ULL)
+  {
+    for(char c : str) {
+      hash ^= (unsigned char) c;
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  /** create a directory (and all its parents). @returns false if it does not exist afterwards */
+  inline bool makeDirectories(const std::string& path)
+  {
+    for(size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+      std::string dir = path.substr(0, pos);
+      if(!dir.empty()) mkdir(dir.c_str(), 0755); // errors are checked below
+      if(pos == std::string::npos) break;
+    }
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+  }
+
+  // ================================================== CTORS =====================================================================
+  inline RootColumnCache::RootColumnCache ( std::string sourcefile ) : __sourceSize(0), __sourceMTime(0), __enabled(false)
+  {
+    std::string cachedir;
+    const char* envdir = getenv("ROOTTOOLBOX_CACHE_DIR");
+    const char* home = getenv("HOME");
+    if(envdir != 0) cachedir = envdir;
+    else if(home != 0) cachedir = std::string(home) + "/.cache/roottoolbox";
+    init(sourcefile, cachedir);
+  }
+
+  inline RootColumnCache::RootColumnCache ( std::string sourcefile, std::string cachedir ) : __sourceSize(0), __sourceMTime(0), __enabled(false)
+  {
+    init(sourcefile, cachedir);
+  }
+
+  inline void RootColumnCache::init ( std::string sourcefile, std::string cachedir )
+  {
+    __cachedir = cachedir;
+    if(__cachedir.empty()) return;
+
+    char resolved[PATH_MAX];
+    struct stat st;
+    if(realpath(sourcefile.c_str(), resolved) == 0 || stat(resolved, &st) != 0) return; // e.g. remote files cannot be cached
+    __sourcepath = resolved;
+    __sourceSize = st.st_size;
+    __sourceMTime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+    if(!makeDirectories(__cachedir)) {
+      std::cout << "WARNING: could not create cache directory " << __cachedir << ". Not using cache" << std::endl;
+      return;
+    }
+    __enabled = true;
+  }
+
+  // ============================================== CACHE FILE NAME ===============================================================
+  inline std::string RootColumnCache::getCacheFileName ( const std::string& tree, const std::string& branch ) const
+  {
+    // the size and modification time are not part of the name, so that stale files get overwritten instead of piling up
+    uint64_t hash = fnv1aHash(branch, fnv1aHash(tree + '\0', fnv1aHash(__sourcepath + '\0')));
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.col", (unsigned long long) hash);
+    return __cachedir + "/" + name;
+  }
+
+  // ============================================== CHECK HEADER ==================================================================
+  inline bool RootColumnCache::checkHeader ( const char* mapped, size_t fileSize, const std::string& tree, const std::string& branch,
+                                             int dataType, size_t valueSize ) const
+  {
+    if(fileSize < sizeof(CacheFileHeader)) return false;
+    CacheFileHeader header;
+    memcpy(&header, mapped, sizeof(header));
+    if(memcmp(header.magic, "RTBCOL01", 8) != 0) return false;
+    if(header.sourceSize != __sourceSize || header.sourceMTime != __sourceMTime) return false; // source has changed
+    if(header.dataType != dataType || header.valueSize != valueSize) return false;
+    if(header.pathLength != __sourcepath.size() || header.treeLength != tree.size() || header.branchLength != branch.size()) return false;
+    if(header.dataOffset + header.nValues * valueSize != fileSize) return false; // truncated file
+
+    const char* names = mapped + sizeof(header);
+    return __sourcepath.compare(0, std::string::npos, names, header.pathLength) == 0 &&
+      tree.compare(0, std::string::npos, names + header.pathLength, header.treeLength) == 0 &&
+      branch.compare(0, std::string::npos, names + header.pathLength + header.treeLength, header.branchLength) == 0;
+  }
+
+  // ==================================================== LOAD ====================================================================
+  template<typename T>
+  bool RootColumnCache::load ( std::string tree, std::string branch, std::vector<T>& data ) const
+  {
+    if(!__enabled || CacheDataType<T>::value == c_unknown) return false;
+
+    std::string filename = getCacheFileName(tree, branch);
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return false; }
+    void* mapped = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED) return false;
+
+    bool valid = checkHeader(static_cast<const char*>(mapped), st.st_size, tree, branch, CacheDataType<T>::value, sizeof(T));
+    if(valid) {
+      CacheFileHeader header;
+      memcpy(&header, mapped, sizeof(header));
+      data.resize(header.nValues);
+      if(header.nValues) memcpy(data.data(), static_cast<const char*>(mapped) + header.dataOffset, header.nValues * sizeof(T));
+    }
+    munmap(mapped, st.st_size);
+
+    return valid;
+  }
+
+  // ==================================================== STORE ===================================================================
+  template<typename T>
+  bool RootColumnCache::store ( std::string tree, std::string branch, const std::vector<T>& data ) const
+  {
+    if(!__enabled || CacheDataType<T>::value == c_unknown) return false;
+
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "RTBCOL01", 8);
+    header.sourceSize = __sourceSize;
+    header.sourceMTime = __sourceMTime;
+    header.dataType = CacheDataType<T>::value;
+    header.valueSize = sizeof(T);
+    header.nValues = data.size();
+    header.pathLength = __sourcepath.size();
+    header.treeLength = tree.size();
+    header.branchLength = branch.size();
+    uint64_t namesEnd = sizeof(header) + __sourcepath.size() + tree.size() + branch.size();
+    header.dataOffset = (namesEnd + c_cacheAlignment - 1) / c_cacheAlignment * c_cacheAlignment;
+
+    // write to a temporary file first and rename afterwards, so that readers never see a partially written file
+    std::string filename = getCacheFileName(tree, branch);
+    std::string tmpname = filename + ".tmp." + std::to_string(getpid());
+    FILE* file = fopen(tmpname.c_str(), "wb");
+    if(file == 0) return false;
+
+    std::vector<char> padding(header.dataOffset - namesEnd, 0);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok &= fwrite(__sourcepath.data(), 1, __sourcepath.size(), file) == __sourcepath.size();
+    ok &= fwrite(tree.data(), 1, tree.size(), file) == tree.size();
+    ok &= fwrite(branch.data(), 1, branch.size(), file) == branch.size();
+    ok &= fwrite(padding.data(), 1, padding.size(), file) == padding.size();
+    if(!data.empty()) ok &= fwrite(data.data(), sizeof(T), data.size(), file) == data.size();
+    ok &= fclose(file) == 0;
+
+    if(!ok || rename(tmpname.c_str(), filename.c_str()) != 0) {
+      std::cout << "WARNING: could not write cache file " << filename << std::endl;
+      unlink(tmpname.c_str());
+      return false;
+    }
+    return true;
+  }
+
+}
@@ -1,59 +1,378 @@
-// tmadlener: 25.03.2015 -> do this when there is more time
-
-// #pragma once
-//
-// #include <iostream>
-// #include <string>
-// #include <vector>
-//
-// namespace RootToolBox {
-//
-//   /** class to define a cut to be applied to the data from a tree */
-//   class RootCut {
-//
-//   public:
-//
-//     RootCut() : __name(""), __lower(false) {} /**< empty ctor to avoid unintended behavior */
-//
-//     RootCut(std::string name, std::vector<double> values); /**< ctor from name and two values (first is low, second is high) */
-//
-//     RootCut(std::string name, double value, bool low); /**< ctor from name and one value, as well as a bool to indicate if the value has to be higher (false) or lower (true) to survive the cut */
-//
-//     bool passCut(double value) const;
-//
-//   protected:
-//     std::string __name; /** the name of the branch that holds the values that shall be used to cut */
-//
-//     std::vector<double> __cutvalues;
-//
-//     bool __lower;
-//
-//   };
-//
-//   RootCut::RootCut(std::string name, std::vector<double> values) : __name(name)
-//   {
-//     if(values.size() > 2) { std::cout << "in ctor of RootCut, got " << values.size() << " values, will only use the firs two!" << std::endl; }
-//     if(values.size() < 2) {
-//       std::cout << "in ctor of RootCut, got " << values.size() << " values. Need two!" << std::endl;
-//       exit(-4);
-//     }
-//     for(size_t i = 0; i < 2; ++i) { __cutvalues.push_back(values[i]); }
-//   }
-//
-//   RootCut::RootCut(std::string name, double value, bool low) : __name(name), __lower(low)
-//   {
-//     __cutvalues.push_back(value);
-//   }
-//
-//   bool RootCut::passCut(double value) const
-//   {
-//     if(__cutvalues.size() == 2) {
-//       return (value >= __cutvalues[0]) && (value < __cutvalues[1]);
-//     } else if (__cutvalues.size() == 1) {
-//       return __lower ^ (value > __cutvalues[0]); // using XOR here
-//     }
-//
-//     return false; // default return is false
-//   }
-//
-// }
+// tmadlener: my try on making some kind of a toolbox that can be easily reused to handle root stuff
+// RootCut: cuts (and combinations of them) that can be applied to the data of a tree (column-wise)
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <limits>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "toolboxtypes.hpp"
+#include "vxdhelper.hpp"
+
+namespace RootToolBox {
+
+  /**
+   * bitmap holding one bit per value of a column. bit i is set if value i passes a selection
+   */
+  class SelectionBitmap {
+  public:
+    /** ctor, all bits are initialized to @param value */
+    SelectionBitmap(size_t size = 0, bool value = false) : __size(size), __words((size + 63) / 64, value ? ~uint64_t(0) : 0) { clearPadding(); }
+
+    size_t size() const { return __size; } /**< get the number of bits */
+
+    bool test(size_t i) const { return (__words[i / 64] >> (i % 64)) & 1; } /**< check if bit i is set */
+
+    void set(size_t i) { __words[i / 64] |= uint64_t(1) << (i % 64); } /**< set bit i */
+
+    uint64_t* data() { return __words.data(); } /**< get the underlying words */
+
+    const uint64_t* data() const { return __words.data(); } /**< get the underlying words */
+
+    size_t count() const; /**< get the number of set bits */
+
+    bool any(size_t begin, size_t end) const; /**< check if any bit between begin (including) and end (excluding) is set */
+
+    SelectionBitmap& operator&=(const SelectionBitmap& other); /**< bitwise and (sizes have to match) */
+
+    SelectionBitmap& operator|=(const SelectionBitmap& other); /**< bitwise or (sizes have to match) */
+
+  private:
+    size_t __size; /**< number of bits */
+    std::vector<uint64_t> __words; /**< bits, packed into words of 64 bits */
+
+    void clearPadding() { if(__size % 64) __words.back() &= (uint64_t(1) << (__size % 64)) - 1; } /**< unset the bits after __size */
+  };
+
+  /** a column of values (of any of the types in e_dataTypes) that can be used to evaluate a selection */
+  struct SelectionColumn {
+    SelectionColumn() : data(0), type(c_unknown), size(0) {}
+    SelectionColumn(const void* d, e_dataTypes t, size_t s) : data(d), type(t), size(s) {}
+
+    const void* data; /**< pointer to the first value */
+    e_dataTypes type; /**< the type of the values */
+    size_t size; /**< number of values */
+  };
+
+  /** columns by branch name */
+  typedef std::unordered_map<std::string, SelectionColumn> SelectionColumns;
+
+  /**
+   * class to define a cut to be applied to the data from a tree.
+   * Every cut is internally represented as an interval with (inclusive or exclusive) lower and upper edges
+   */
+  class RootCut {
+
+  public:
+
+    RootCut() : __name(""), __low(-std::numeric_limits<double>::infinity()), __high(std::numeric_limits<double>::infinity()),
+                __lowIncl(true), __highIncl(true), __layer(false) {} /**< empty ctor, lets everything pass */
+
+    RootCut(std::string name, std::vector<double> values); /**< ctor from name and two values (first is low, second is high). value has to be in [low, high) */
+
+    RootCut(std::string name, double value, bool low); /**< ctor from name and one value, as well as a bool to indicate if the value has to be higher (false) or lower (true) to survive the cut */
+
+    /** create a cut on a vxdid branch (raw format) that is passed if the vxdid is on layer @param layer (1 to 6) */
+    static RootCut vxdLayer(std::string name, unsigned layer);
+
+    bool passCut(double value) const; /**< check if a single value passes the cut */
+
+    std::string getName() const { return __name; } /**< get the name of the branch that is used to cut */
+
+    /** evaluate the cut on a column, the returned bitmap has one bit per value in the column */
+    SelectionBitmap evaluate(const SelectionColumn& column) const;
+
+    void print() const; /**< print cut */
+
+  protected:
+    std::string __name; /**< the name of the branch that holds the values that shall be used to cut */
+
+    double __low; /**< lower edge */
+    double __high; /**< upper edge */
+    bool __lowIncl; /**< is the lower edge included */
+    bool __highIncl; /**< is the upper edge included */
+    bool __layer; /**< flag for printing only */
+
+    /** evaluate the cut on n values, writing the results into (n + 63) / 64 words */
+    template<typename T>
+    void evaluateColumn(const T* values, size_t n, uint64_t* words) const;
+
+    /** evaluate the cut on (at most) 64 doubles, returning one word */
+    template<bool LowIncl, bool HighIncl>
+    uint64_t evaluateBlock(const double* values, size_t n) const;
+  };
+
+  /**
+   * combination of RootCuts (with AND and OR) that can be evaluated column-wise.
+   * usage e.g.: RootSelection sel = RootSelection(cutA) & (RootSelection(cutB) | RootSelection(cutC));
+   */
+  class RootSelection {
+  public:
+    /** type of a node in the selection */
+    enum e_nodeTypes {
+      c_all = 0, /**< everything passes (empty selection) */
+      c_cut = 1, /**< a single cut */
+      c_and = 2, /**< all children have to pass */
+      c_or = 3, /**< any of the children has to pass */
+    };
+
+    RootSelection() : __type(c_all) {} /**< empty selection, lets everything pass */
+
+    RootSelection(const RootCut& cut) : __type(c_cut), __cut(cut) {} /**< selection consisting of only one cut */
+
+    RootSelection(e_nodeTypes type, std::vector<RootSelection> children) : __type(type), __children(children) {} /**< ctor for combinations */
+
+    /** get the names of all branches that are needed to evaluate this selection (unique) */
+    std::vector<std::string> getBranchNames() const;
+
+    /** evaluate the selection on the passed columns. All needed columns have to be present and have the same size */
+    SelectionBitmap evaluate(const SelectionColumns& columns, size_t size) const;
+
+    bool empty() const { return __type == c_all; } /**< check if this selection lets everything pass */
+
+    void print(std::string indent = "") const; /**< print selection */
+
+  protected:
+    e_nodeTypes __type; /**< the type of this node */
+    RootCut __cut; /**< the cut if this node is a single cut */
+    std::vector<RootSelection> __children; /**< the children if this node is a combination */
+
+    void collectBranchNames(std::vector<std::string>& names) const; /**< add the names of all branches to names */
+  };
+
+  /** combine two selections with AND */
+  inline RootSelection operator&(const RootSelection& lhs, const RootSelection& rhs)
+  {
+    return RootSelection(RootSelection::c_and, {lhs, rhs});
+  }
+
+  /** combine two selections with OR */
+  inline RootSelection operator|(const RootSelection& lhs, const RootSelection& rhs)
+  {
+    return RootSelection(RootSelection::c_or, {lhs, rhs});
+  }
+
+  // ====================================================== SELECTION BITMAP ======================================================
+  inline size_t SelectionBitmap::count() const
+  {
+    size_t n = 0;
+    for(uint64_t word : __words) n += __builtin_popcountll(word);
+    return n;
+  }
+
+  inline bool SelectionBitmap::any(size_t begin, size_t end) const
+  {
+    for(size_t i = begin; i < end; ) {
+      if(i % 64 == 0 && i + 64 <= end) { // whole words can be checked at once
+        if(__words[i / 64]) return true;
+        i += 64;
+      } else {
+        if(test(i)) return true;
+        ++i;
+      }
+    }
+    return false;
+  }
+
+  inline SelectionBitmap& SelectionBitmap::operator&=(const SelectionBitmap& other)
+  {
+    for(size_t i = 0; i < __words.size(); ++i) __words[i] &= other.__words[i];
+    return *this;
+  }
+
+  inline SelectionBitmap& SelectionBitmap::operator|=(const SelectionBitmap& other)
+  {
+    for(size_t i = 0; i < __words.size(); ++i) __words[i] |= other.__words[i];
+    return *this;
+  }
+
+  // ============================================================ CTORS ===========================================================
+  inline RootCut::RootCut(std::string name, std::vector<double> values) : RootCut()
+  {
+    __name = name;
+    if(values.size() > 2) { std::cout << "in ctor of RootCut, got " << values.size() << " values, will only use the firs two!" << std::endl; }
+    if(values.size() < 2) {
+      std::cout << "in ctor of RootCut, got " << values.size() << " values. Need two!" << std::endl;
+      exit(-4);
+    }
+    __low = values[0]; __high = values[1];
+    __highIncl = false;
+  }
+
+  inline RootCut::RootCut(std::string name, double value, bool low) : RootCut()
+  {
+    __name = name;
+    if(low) { __high = value; } // value <= cut passes
+    else { __low = value; __lowIncl = false; } // value > cut passes
+  }
+
+  inline RootCut RootCut::vxdLayer(std::string name, unsigned layer)
+  {
+    if(layer < 1 || layer > c_nVXDLayers) {
+      std::cout << "in RootCut::vxdLayer, got layer " << layer << ". Has to be in [1," << c_nVXDLayers << "]!" << std::endl;
+      exit(-4);
+    }
+    RootCut cut(name, { double(c_vxdRange[layer - 1][0]), double(c_vxdRange[layer - 1][1]) });
+    cut.__highIncl = true;
+    cut.__layer = true;
+    return cut;
+  }
+
+  // ========================================================= PASS CUT ===========================================================
+  inline bool RootCut::passCut(double value) const
+  {
+    bool passLow = __lowIncl ? value >= __low : value > __low;
+    bool passHigh = __highIncl ? value <= __high : value < __high;
+    return passLow && passHigh;
+  }
+
+  // ========================================================= EVALUATE ===========================================================
+  template<typename T>
+  void RootCut::evaluateColumn(const T* values, size_t n, uint64_t* words) const
+  {
+    double block[64]; // non-double columns are converted blockwise, so that the same (vectorized) kernel can be used
+    for(size_t i = 0; i < n; i += 64) {
+      const size_t nBlock = std::min<size_t>(64, n - i);
+      for(size_t j = 0; j < nBlock; ++j) block[j] = values[i + j];
+
+      if(__lowIncl && __highIncl) words[i / 64] = evaluateBlock<true, true>(block, nBlock);
+      else if(__lowIncl) words[i / 64] = evaluateBlock<true, false>(block, nBlock);
+      else if(__highIncl) words[i / 64] = evaluateBlock<false, true>(block, nBlock);
+      else words[i / 64] = evaluateBlock<false, false>(block, nBlock);
+    }
+  }
+
+  template<>
+  inline void RootCut::evaluateColumn<double>(const double* values, size_t n, uint64_t* words) const
+  {
+    for(size_t i = 0; i < n; i += 64) {
+      const size_t nBlock = std::min<size_t>(64, n - i);
+      if(__lowIncl && __highIncl) words[i / 64] = evaluateBlock<true, true>(values + i, nBlock);
+      else if(__lowIncl) words[i / 64] = evaluateBlock<true, false>(values + i, nBlock);
+      else if(__highIncl) words[i / 64] = evaluateBlock<false, true>(values + i, nBlock);
+      else words[i / 64] = evaluateBlock<false, false>(values + i, nBlock);
+    }
+  }
+
+  template<bool LowIncl, bool HighIncl>
+  uint64_t RootCut::evaluateBlock(const double* values, size_t n) const
+  {
+    uint64_t word = 0;
+    size_t j = 0;
+#if defined(__AVX__)
+    const __m256d low = _mm256_set1_pd(__low);
+    const __m256d high = _mm256_set1_pd(__high);
+    for(; j + 4 <= n; j += 4) {
+      __m256d v = _mm256_loadu_pd(values + j);
+      __m256d passLow = LowIncl ? _mm256_cmp_pd(v, low, _CMP_GE_OQ) : _mm256_cmp_pd(v, low, _CMP_GT_OQ);
+      __m256d passHigh = HighIncl ? _mm256_cmp_pd(v, high, _CMP_LE_OQ) : _mm256_cmp_pd(v, high, _CMP_LT_OQ);
+      word |= uint64_t(_mm256_movemask_pd(_mm256_and_pd(passLow, passHigh))) << j;
+    }
+#elif defined(__SSE2__)
+    const __m128d low = _mm_set1_pd(__low);
+    const __m128d high = _mm_set1_pd(__high);
+    for(; j + 2 <= n; j += 2) {
+      __m128d v = _mm_loadu_pd(values + j);
+      __m128d passLow = LowIncl ? _mm_cmpge_pd(v, low) : _mm_cmpgt_pd(v, low);
+      __m128d passHigh = HighIncl ? _mm_cmple_pd(v, high) : _mm_cmplt_pd(v, high);
+      word |= uint64_t(_mm_movemask_pd(_mm_and_pd(passLow, passHigh))) << j;
+    }
+#endif
+    for(; j < n; ++j) { // remainder (or everything if no SIMD is available)
+      bool passLow = LowIncl ? values[j] >= __low : values[j] > __low;
+      bool passHigh = HighIncl ? values[j] <= __high : values[j] < __high;
+      word |= uint64_t(passLow && passHigh) << j;
+    }
+    return word;
+  }
+
+  inline SelectionBitmap RootCut::evaluate(const SelectionColumn& column) const
+  {
+    SelectionBitmap bitmap(column.size);
+    switch(column.type) {
+    case c_double: evaluateColumn(static_cast<const double*>(column.data), column.size, bitmap.data()); break;
+    case c_int: evaluateColumn(static_cast<const int*>(column.data), column.size, bitmap.data()); break;
+    case c_uint: evaluateColumn(static_cast<const unsigned int*>(column.data), column.size, bitmap.data()); break;
+    case c_usint: evaluateColumn(static_cast<const unsigned short int*>(column.data), column.size, bitmap.data()); break;
+    default:
+      std::cout << "cannot evaluate cut on branch " << __name << " with unknown type! no values pass" << std::endl;
+    }
+    return bitmap;
+  }
+
+  // =========================================================== PRINT ============================================================
+  inline void RootCut::print() const
+  {
+    if(__layer) {
+      std::cout << "cut on branch " << __name << ": vxdid in [" << __low << ", " << __high << "]" << std::endl;
+      return;
+    }
+    std::cout << "cut on branch " << __name << ": value in " << (__lowIncl ? "[" : "(") << __low << ", " << __high << (__highIncl ? "]" : ")") << std::endl;
+  }
+
+  // ====================================================== ROOT SELECTION ========================================================
+  inline std::vector<std::string> RootSelection::getBranchNames() const
+  {
+    std::vector<std::string> names;
+    collectBranchNames(names);
+    return names;
+  }
+
+  inline void RootSelection::collectBranchNames(std::vector<std::string>& names) const
+  {
+    if(__type == c_cut) {
+      if(std::find(names.begin(), names.end(), __cut.getName()) == names.end()) names.push_back(__cut.getName());
+    }
+    for(const RootSelection& child : __children) child.collectBranchNames(names);
+  }
+
+  inline SelectionBitmap RootSelection::evaluate(const SelectionColumns& columns, size_t size) const
+  {
+    switch(__type) {
+    case c_cut: {
+      SelectionColumns::const_iterator it = columns.find(__cut.getName());
+      if(it == columns.end() || it->second.size != size) {
+        std::cout << "found no column (with " << size << " values) for cut on branch " << __cut.getName() << "! no values pass" << std::endl;
+        return SelectionBitmap(size, false);
+      }
+      return __cut.evaluate(it->second);
+    }
+    case c_and: {
+      SelectionBitmap bitmap(size, true);
+      for(const RootSelection& child : __children) bitmap &= child.evaluate(columns, size);
+      return bitmap;
+    }
+    case c_or: {
+      SelectionBitmap bitmap(size, false);
+      for(const RootSelection& child : __children) bitmap |= child.evaluate(columns, size);
+      return bitmap;
+    }
+    default:
+      return SelectionBitmap(size, true);
+    }
+  }
+
+  inline void RootSelection::print(std::string indent) const
+  {
+    switch(__type) {
+    case c_cut: std::cout << indent; __cut.print(); break;
+    case c_and: std::cout << indent << "AND" << std::endl; break;
+    case c_or: std::cout << indent << "OR" << std::endl; break;
+    default: std::cout << indent << "no selection" << std::endl;
+    }
+    for(const RootSelection& child : __children) child.print(indent + "  ");
+  }
+
+}
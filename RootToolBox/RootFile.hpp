@@ -29,7 +29,10 @@ namespace RootToolBox {
       fetchTrees(treenames);
     }
 
-    /** ctor with filename, gets all trees and subsequently all branches for this file */
+    /**
+     * ctor with filename, gets the names of all trees for this file.
+     * NOTE: the trees (and their branches) are only read from the file on first access
+     */
     RootFile(std::string filename);
 
     /** dtor */
@@ -43,11 +46,14 @@ namespace RootToolBox {
 
     std::string getName() const { return __filename; }
 
-    /** get the number of trees (to which the pointer exists in the container) */
-    size_t getNTrees() const { return __trees.size(); }
+    /** get the number of trees in the catalog of this file */
+    size_t getNTrees() const { return __treenames.size(); }
 
-    /** get all trees that are currently attached to this RootFile */
-    std::vector<RootToolBox::RootTree> getTrees() const { return __trees; }
+    /** get the names of all trees in the catalog of this file */
+    const std::vector<std::string>& getTreeNames() const { return __treenames; }
+
+    /** get all trees that are currently attached to this RootFile (resolves all trees that have not yet been accessed) */
+    std::vector<RootToolBox::RootTree> getTrees() const;
 
     /** try to find a tree with the passed name */
     RootToolBox::RootTree getTree(std::string name) const;
@@ -60,9 +66,16 @@ namespace RootToolBox {
   protected:
     TFile* __file; /**< pointer to the file */
     std::string __filename; /**< the fileName */
-    std::vector<RootToolBox::RootTree> __trees; /**< informtion on the trees of the file */
+    std::vector<std::string> __treenames; /**< names of the trees of the file */
+    RootToolBox::NameIndex __treeindex; /**< index of the trees by name */
+    mutable std::vector<RootToolBox::RootTree> __trees; /**< informtion on the trees of the file (only valid if resolved) */
+    mutable std::vector<bool> __resolved; /**< flags indicating which trees have already been read from the file */
 
+    /** put the passed treenames into the catalog (does not read the trees from the file) */
     void fetchTrees(std::vector<std::string> treenames);
+
+    /** read the tree with the passed index from the file if this has not been done yet */
+    void resolveTree(size_t index) const;
   };
 
 
@@ -70,7 +83,7 @@ namespace RootToolBox {
   RootFile::RootFile ( std::string filename ) : __filename(filename)
   {
     setFile(filename);
-    std::vector<std::string> treenames = getTreeNames(__file);
+    std::vector<std::string> treenames = RootToolBox::getTreeNames(__file);
     fetchTrees(treenames);
   }
   // ==============================================================================================================================
@@ -101,14 +114,24 @@ namespace RootToolBox {
   // ====================================================== FETCH TREES ===========================================================
   void RootFile::fetchTrees (std::vector<std::string> treenames)
   {
-    for(std::string name : treenames) { __trees.push_back(RootTree(name, __file)); }
+    __treenames = treenames;
+    __treeindex = buildNameIndex(__treenames);
+    __trees.assign(__treenames.size(), RootTree());
+    __resolved.assign(__treenames.size(), false);
+  }
+
+  void RootFile::resolveTree ( size_t index ) const
+  {
+    if(__resolved[index]) return;
+    __trees[index] = RootTree(__treenames[index], __file);
+    __resolved[index] = true;
   }
   // ==============================================================================================================================
 
   // ================================================= GET TREE ===================================================================
   RootTree RootFile::getTree ( std::string name ) const
   {
-    int pos = RootToolBox::getPositionByName(__trees, name);
+    int pos = RootToolBox::getPositionByName(__treeindex, name);
     if(pos != -1) return getTree(pos);
     else std::cout << "found no tree with name " << name << "! Returning empty RootTree" << std::endl;
 
@@ -117,18 +140,30 @@ namespace RootToolBox {
 
   RootTree RootFile::getTree ( int index ) const
   {
-    if(index >= 0 && (uint) index < __trees.size()) return __trees[index]; // WARNING: c-style cast to suppress compiler warning
+    if(index >= 0 && (uint) index < __treenames.size()) { // WARNING: c-style cast to suppress compiler warning
+      resolveTree(index);
+      return __trees[index];
+    }
     else std::cout << "index is out of range! returning empty RootTree!" << std::endl;
 
     return RootTree();
   }
+
+  std::vector<RootTree> RootFile::getTrees() const
+  {
+    for(size_t i = 0; i < __treenames.size(); ++i) resolveTree(i);
+    return __trees;
+  }
   // ==============================================================================================================================
 
   // ========================================= PRINT ==============================================================================
   void RootFile::print() const
   {
-    std::cout << "contents of file " << __filename << ": " << __trees.size() << " trees" << std::endl;
-    for (const RootTree& tree : __trees) { tree.print(); }
+    std::cout << "contents of file " << __filename << ": " << __treenames.size() << " trees" << std::endl;
+    for (size_t i = 0; i < __treenames.size(); ++i) {
+      resolveTree(i);
+      __trees[i].print();
+    }
   }
   // ==============================================================================================================================
 
@@ -4,11 +4,19 @@
 #include "RootTreeData.hpp"
 #include "toolboxhelper.hpp"
 
+#include <TROOT.h> // ROOT::EnableThreadSafety
+
+#include <memory>
+
 // boost
 // #include <boost/any.hpp>
 
 namespace RootToolBox {
 
+  /**
+   * class holding the data of the trees of a file. As in RootFile, the RootTreeData of a tree (and of its branches) is only built on
+   * first access (getTreeData or fetching the data)
+   */
   class RootFileData : public RootFile {
   public:
 
@@ -17,9 +25,6 @@ namespace RootToolBox {
 
     RootFileData(std::string filename, std::vector<std::string> treenames);
 
-    /** get the vector of RootTreeData */ // TODO: check if return of const reference is good idea!
-    const std::vector<RootTreeData>& getTreesData() const { return __treesdata; }
-
     /** get the data from only one tree */ // TODO: check if return of const reference is good idea!
     const RootTreeData& getTreeData(std::string treename) const;
 
@@ -32,22 +37,53 @@ namespace RootToolBox {
     /** fetch all data from events between iEvent1, and iEvent2 (inclucding iEvent1, excluding iEvent2) */
     void fetchData(int iEvent1, int iEvent2);
 
-    /** fetch the data from all events */
+    /**
+     * fetch the data from all events.
+     * If caching is enabled (default), the decoded data are taken from the on-disk RootColumnCache if they are valid there and stored
+     * in it otherwise (see RootColumnCache for the location of the cache)
+     */
     void fetchData();
 
+    /** enable or disable the usage of the on-disk cache in fetchData() */
+    void setUseCache(bool useCache) { __useCache = useCache; }
+
+    /**
+     * fetch all data from events between iEvent1 and iEvent2 (including iEvent1, excluding iEvent2) in parallel.
+     * Every thread opens its own handle to the file and decompresses different branches and event ranges. The result is the same
+     * as for fetchData(iEvent1, iEvent2). If nThreads is 0, the number of hardware threads is used.
+     */
+    void fetchDataParallel(int iEvent1, int iEvent2, unsigned nThreads = 0);
+
+    /** fetch the data from all events in parallel (see above) */
+    void fetchDataParallel(unsigned nThreads = 0);
+
+    /**
+     * fetch only the data that pass the selection from all events of the tree with name @param treename.
+     * only the branches needed for the selection are read for all events, all other branches only where values pass
+     */
+    void fetchData(std::string treename, const RootToolBox::RootSelection& selection);
+
   protected:
-    std::vector<RootTreeData> __treesdata;
+    mutable std::vector<std::unique_ptr<RootTreeData> > __treesdata; /**< data of the trees (in the order of __treenames, 0 until built) */
+    bool __useCache; /**< use the on-disk cache in fetchData() */
+
+    /** build the RootTreeData of the tree with the passed index if this has not been done yet */
+    RootTreeData& resolveTreeData(size_t index) const;
   };
 
-  RootFileData::RootFileData ( std::string filename ) : RootFile ( filename )
+  RootFileData::RootFileData ( std::string filename ) : RootFile ( filename ), __treesdata(__treenames.size()), __useCache(true)
+  {
+  }
+
+  RootFileData::RootFileData ( std::string filename, std::vector< std::string > treenames ) :
+    RootFile ( filename, treenames ), __treesdata(__treenames.size()), __useCache(true)
   {
-    std::vector<std::string> treenames = getTreeNames(__file);
-    for (std::string name : treenames) __treesdata.push_back(RootTreeData(name, __file));
   }
 
-  RootFileData::RootFileData ( std::string filename, std::vector< std::string > treenames ) : RootFile ( filename, treenames )
+  RootTreeData& RootFileData::resolveTreeData ( size_t index ) const
   {
-    for (std::string name : treenames) __treesdata.push_back(RootTreeData(name, __file));
+    if(!__treesdata[index]) __treesdata[index].reset(new RootTreeData(__treenames[index], __file));
+    return *__treesdata[index];
   }
 
 
@@ -55,7 +91,7 @@ namespace RootToolBox {
   // ========================================================= GET TREE DATA ======================================================
   const RootTreeData& RootFileData::getTreeData ( std::string treename ) const
   {
-    int pos = getPositionByName(__treesdata, treename);
+    int pos = getPositionByName(__treeindex, treename);
     if(pos != -1) return getTreeData(pos);
     else std::cout << "found no tree with name " << treename << "! Returning first treedata!" << std::endl;
 
@@ -64,10 +100,10 @@ namespace RootToolBox {
 
   const RootTreeData& RootFileData::getTreeData ( int index ) const
   {
-    if(index >= 0 && (uint) index < __treesdata.size()) return __treesdata[index]; // WARNING: c-style cast to suppress compiler warning
+    if(index >= 0 && (uint) index < __treesdata.size()) return resolveTreeData(index); // WARNING: c-style cast to suppress compiler warning
     else std::cout << "index is out of range! returning first RootTreeData!" << std::endl;
 
-    return __treesdata[0];
+    return resolveTreeData(0);
   }
 
 
@@ -79,7 +115,8 @@ namespace RootToolBox {
 
   void RootFileData::fetchData ( int iEvent1, int iEvent2 )
   {
-    for(RootTreeData& tree: __treesdata) {
+    for(size_t iTree = 0; iTree < __treesdata.size(); ++iTree) {
+      RootTreeData& tree = resolveTreeData(iTree);
       std::cout << "fetching data from event " << iEvent1 << " to event " << iEvent2 << " from tree " << tree.getName() << std::endl;
       for(int i = iEvent1; i < iEvent2; ++i) fetchData(i,tree);
     }
@@ -88,11 +125,65 @@ namespace RootToolBox {
   // ========================================= FETCH DATA =========================================================================
   void RootFileData::fetchData()
   {
-    for(RootTreeData& tree : __treesdata) {
+    if(__useCache) {
+      RootColumnCache cache(__filename);
+      if(cache.enabled()) {
+        for(size_t iTree = 0; iTree < __treesdata.size(); ++iTree) {
+          RootTreeData& tree = resolveTreeData(iTree);
+          size_t nFailed = 0;
+          size_t nCached = tree.fetchCached(cache, nFailed);
+          std::cout << "fetched " << tree.getTreePtr()->GetEntries() << " events from tree " << tree.getName() << " ("
+                    << nCached << " of " << tree.getNBranches() << " branches from cache " << cache.getCacheDir() << ")" << std::endl;
+          if(nFailed) {
+            std::cout << "ERROR: " << nFailed << " branches of tree " << tree.getName() << " could not be read completely" << std::endl;
+          }
+        }
+        return;
+      }
+    }
+
+    for(size_t iTree = 0; iTree < __treesdata.size(); ++iTree) {
+      RootTreeData& tree = resolveTreeData(iTree);
       int nEntries = tree.getTreePtr()->GetEntries();
       std::cout << "fetching " << nEntries << " events from tree " << tree.getName() << std::endl;
       for (int i = 0; i < nEntries; ++i) fetchData(i, tree);
     }
   }
 
+  // ========================================= FETCH DATA PARALLEL ================================================================
+  void RootFileData::fetchDataParallel ( int iEvent1, int iEvent2, unsigned nThreads )
+  {
+    ROOT::EnableThreadSafety();
+    for(size_t iTree = 0; iTree < __treesdata.size(); ++iTree) {
+      RootTreeData& tree = resolveTreeData(iTree);
+      std::cout << "fetching data from event " << iEvent1 << " to event " << iEvent2 << " from tree " << tree.getName() << " in parallel" << std::endl;
+      tree.fetchParallel(__filename, iEvent1, iEvent2, nThreads);
+    }
+  }
+
+  void RootFileData::fetchDataParallel ( unsigned nThreads )
+  {
+    ROOT::EnableThreadSafety();
+    for(size_t iTree = 0; iTree < __treesdata.size(); ++iTree) {
+      RootTreeData& tree = resolveTreeData(iTree);
+      int nEntries = tree.getTreePtr()->GetEntries();
+      std::cout << "fetching " << nEntries << " events from tree " << tree.getName() << " in parallel" << std::endl;
+      tree.fetchParallel(__filename, 0, nEntries, nThreads);
+    }
+  }
+
+  // ========================================= FETCH SELECTED DATA ================================================================
+  void RootFileData::fetchData ( std::string treename, const RootSelection& selection )
+  {
+    int pos = getPositionByName(__treeindex, treename);
+    if(pos == -1) {
+      std::cout << "found no tree with name " << treename << "! Not fetching any data" << std::endl;
+      return;
+    }
+    RootTreeData& tree = resolveTreeData(pos);
+    int nEntries = tree.getTreePtr()->GetEntries();
+    std::cout << "fetching selected data from " << nEntries << " events from tree " << tree.getName() << std::endl;
+    tree.fetchSelected(selection, 0, nEntries);
+  }
+
 }
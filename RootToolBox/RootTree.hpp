@@ -26,7 +26,7 @@ namespace RootToolBox {
     /** empty ctor, needed for returning empty trees */
     RootTree() : __treename(""), __tree(NULL) {}
 
-    /** ctor from treename and the file where the tree is */
+    /** ctor from treename and the file where the tree is. NOTE: the branches are only resolved on first access */
     RootTree(std::string treename, TFile* file);
 
     /** dtor */
@@ -36,29 +36,37 @@ namespace RootToolBox {
 
     TTree* getTreePtr() const { return __tree; } /**< get the pointer to the tree */
 
-    size_t getNBranches() const { return __branches.size(); } /**< get the number of branches currently attached to tree */
+    size_t getNBranches() const { return __branchnames.size(); } /**< get the number of branches in the tree */
+
+    const std::vector<std::string>& getBranchNames() const { return __branchnames; } /**< get the names of all branches in the tree */
 
     RootToolBox::RootBranch getBranch(std::string name) const; /**< get the branch with the passed name */
 
     RootToolBox::RootBranch getBranch(int index) const; /**< get the branch with the passed index (i.e. index is position in vector) */
 
-    std::vector<RootToolBox::RootBranch> getBranches() const { return __branches; } /**< get all branches currently attached */
+    std::vector<RootToolBox::RootBranch> getBranches() const; /**< get all branches (resolves all branches that have not yet been accessed) */
 
     void print() const; /**< print tree */
   protected:
     std::string __treename; /**< name of tree */
     TTree* __tree; /**< pointer to tree */
-    std::vector<RootToolBox::RootBranch> __branches; /**< branch information for this tree */
+    std::vector<std::string> __branchnames; /**< names of the branches of this tree */
+    RootToolBox::NameIndex __branchindex; /**< index of the branches by name */
+    mutable std::vector<RootToolBox::RootBranch> __branches; /**< branch information for this tree (only valid if resolved) */
+    mutable std::vector<bool> __resolved; /**< flags indicating which branches have already been resolved */
 
-    /** get the passed branches (by name) and add them to the branch vector */
+    /** put the passed branches (by name) into the catalog of this tree (does not resolve them) */
     void fetchBranches(std::vector<std::string> branchnames);
+
+    /** resolve the branch with the passed index if this has not been done yet */
+    void resolveBranch(size_t index) const;
   };
 
   // ======================================= CTOR ===============================================================================
   RootTree::RootTree(std::string treename, TFile* file) : __treename(treename)
   {
     __tree = (TTree*) file->Get(treename.c_str());
-    std::vector<std::string> branchnames = getBranchNames(__tree);
+    std::vector<std::string> branchnames = RootToolBox::getBranchNames(__tree);
     fetchBranches(branchnames);
   }
   // ============================================================================================================================
@@ -75,14 +83,27 @@ namespace RootToolBox {
   // =============================================== FETCH BRANCHES =============================================================
   void RootTree::fetchBranches(std::vector<std::string> branchnames)
   {
-    for(std::string name : branchnames) __branches.push_back(RootBranch(name, __tree));
+    __branchnames = branchnames;
+    __branchindex = buildNameIndex(__branchnames);
+    __branches.assign(__branchnames.size(), RootBranch());
+    __resolved.assign(__branchnames.size(), false);
+  }
+
+  void RootTree::resolveBranch ( size_t index ) const
+  {
+    if(__resolved[index]) return;
+    __branches[index] = RootBranch(__branchnames[index], __tree);
+    __resolved[index] = true;
   }
   // ============================================================================================================================
 
   // ================================================= GET BRANCH ===============================================================
   RootBranch RootTree::getBranch ( int index ) const
   {
-    if(index >= 0 && (uint) index < __branches.size()) return __branches[index]; // WARNING: c-style cast to suppress compiler warning
+    if(index >= 0 && (uint) index < __branchnames.size()) { // WARNING: c-style cast to suppress compiler warning
+      resolveBranch(index);
+      return __branches[index];
+    }
     else std::cout << " index is out of range. returning empty RootBranch! " << std::endl;
 
     return RootBranch();
@@ -90,18 +111,27 @@ namespace RootToolBox {
 
   RootBranch RootTree::getBranch ( std::string name ) const
   {
-    int pos = RootToolBox::getPositionByName(__branches, name);
+    int pos = RootToolBox::getPositionByName(__branchindex, name);
     if(pos != -1) return getBranch(pos);
     else std::cout << "found no Branch with name " << name << " returning empty RootBranch" << std::endl;
 
     return RootBranch();
   }
 
+  std::vector<RootBranch> RootTree::getBranches() const
+  {
+    for(size_t i = 0; i < __branchnames.size(); ++i) resolveBranch(i);
+    return __branches;
+  }
+
   // ========================================================= PRINT ==============================================================
   void RootTree::print() const
   {
-    std::cout << "content of tree " << __treename << ": " << __branches.size() << " branches" << std::endl;
-    for(const RootBranch& branch : __branches) { branch.print(); }
+    std::cout << "content of tree " << __treename << ": " << __branchnames.size() << " branches" << std::endl;
+    for(size_t i = 0; i < __branchnames.size(); ++i) {
+      resolveBranch(i);
+      __branches[i].print();
+    }
   }
 
 }
@@ -3,10 +3,13 @@
 #include "RootTree.hpp"
 #include "RootBranchData.hpp"
 #include "toolboxhelper.hpp"
-// #include "RootCut.hpp"
+#include "RootCut.hpp"
 
 #include <tuple>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 #include <boost/any.hpp>
 
@@ -25,25 +28,74 @@ namespace RootToolBox {
     template<typename T>
     RootBranchData<T>* getBranchData( int index ) const;
 
-//     void applyCut(std::vector<RootToolBox::RootCut> cuts); // TODO when there is more time!
+    /** apply a selection to the already fetched data, i.e. only keep the values that pass the selection (in all branches) */
+    void applyCut(const RootToolBox::RootSelection& selection);
+
+    /**
+     * fetch only the data that pass the selection from events between iEvent1 and iEvent2 (including iEvent1, excluding iEvent2).
+     * First only the branches needed for the selection are read and the selection is evaluated (column-wise).
+     * The remaining branches are then only read for events where at least one value passes the selection.
+     * NOTE: all values in an event have to belong to the same samples in all branches (i.e. vectors of the same size)
+     */
+    void fetchSelected(const RootToolBox::RootSelection& selection, int iEvent1, int iEvent2);
+
+    /**
+     * fetch the data from all events, taking every branch from the cache if there is a valid column for it.
+     * Branches that are not in the cache are read from the file (branch by branch) and stored in the cache (if they could be read
+     * completely).
+     * @param nFailed, set to the number of branches that could not be read completely
+     * @returns the number of branches taken from the cache
+     */
+    size_t fetchCached(const RootToolBox::RootColumnCache& cache, size_t& nFailed);
 
     void addEvent(int iEvent);
 
+    /** get the type of the data stored in the branch with name @param name (c_unknown if there is no such branch) */
+    e_dataTypes getDataType(std::string name) const;
+
+    /**
+     * fetch all data from events between iEvent1 and iEvent2 (including iEvent1, excluding iEvent2) using nThreads threads.
+     * Every thread opens its own handle to the file @param filename, the work is split into tasks of (branch, event range)
+     * and the results are merged in order, such that the data are the same as when fetched via addEvent.
+     * If nThreads is 0, the number of hardware threads is used.
+     * NOTE: ROOT::EnableThreadSafety() has to be called before calling this!
+     */
+    void fetchParallel(std::string filename, int iEvent1, int iEvent2, unsigned nThreads = 0);
+
   protected:
     std::vector<std::tuple<boost::any, std::string, e_dataTypes> > __branchdata;
+    RootToolBox::NameIndex __branchdataindex; /**< index of __branchdata by branch name */
+
+    /** get the RootBranchData with index iBr (no checks on index or type!) */
+    template<typename T>
+    RootBranchData<T>* castBranchData(size_t iBr) const { return boost::any_cast<RootBranchData<T>*>(std::get<0>(__branchdata[iBr])); }
+
+    void prepareChunks(size_t iBr, size_t nChunks); /**< call prepareChunks on RootBranchData with index iBr */
+
+    void fetchChunk(size_t iBr, TTree* tree, size_t iChunk, int iEvent1, int iEvent2); /**< call fetchChunk on RootBranchData with index iBr */
+
+    void mergeChunks(size_t iBr); /**< call mergeChunks on RootBranchData with index iBr */
+
+    SelectionColumn getSelectionColumn(size_t iBr) const; /**< get the (already fetched) data of the branch with index iBr as column */
+
+    /** read the data of the branch with index iBr into values (has to be a std::vector of the right type, is set here) */
+    SelectionColumn readEvents(size_t iBr, int iEvent1, int iEvent2, boost::any& values, std::vector<size_t>& nValues);
+
+    /** call addSelected on the branch with index iBr (values as filled by readEvents) */
+    void addSelected(size_t iBr, const boost::any& values, const SelectionBitmap& bitmap);
   };
 
 
   RootTreeData::RootTreeData ( std::string treename, TFile* file ) : RootTree ( treename, file )
   {
-    std::vector<std::string> branchnames = getBranchNames(__tree);
-    for(std::string name : branchnames) { addBranchDataToTree(__branchdata, __tree, name); }
+    for(std::string name : __branchnames) { addBranchDataToTree(__branchdata, __tree, name); }
+    for(size_t i = 0; i < __branchdata.size(); ++i) __branchdataindex.insert(std::make_pair(std::get<1>(__branchdata[i]), i));
   }
 
   template<typename T>
   RootBranchData<T>* RootTreeData::getBranchData ( std::string name ) const
   {
-    int pos = getPositionByName(__branchdata, name);
+    int pos = getPositionByName(__branchdataindex, name);
 //     std::cout << "trying to get branch " << name << std::endl;
     if(pos != -1) return getBranchData<T>(pos);
     else std::cout << "found no Branch with name " << name << " returning empty RootBranchData" << std::endl;
@@ -92,4 +144,257 @@ namespace RootToolBox {
     }
   }
 
+  // ==================================================== GET DATA TYPE ===========================================================
+  e_dataTypes RootTreeData::getDataType ( std::string name ) const
+  {
+    int pos = getPositionByName(__branchdataindex, name);
+    if(pos != -1) return std::get<2>(__branchdata[pos]);
+    return c_unknown;
+  }
+
+  // ==================================================== FETCH PARALLEL ==========================================================
+  void RootTreeData::fetchParallel ( std::string filename, int iEvent1, int iEvent2, unsigned nThreads )
+  {
+    if(iEvent2 <= iEvent1 || __branchdata.empty()) return;
+    if(nThreads == 0) nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // use more chunks than threads to balance the load between the threads
+    const size_t nChunks = std::min<size_t>(4 * nThreads, iEvent2 - iEvent1);
+    std::vector<int> edges;
+    for(size_t i = 0; i <= nChunks; ++i) edges.push_back(iEvent1 + (long long)(iEvent2 - iEvent1) * i / nChunks);
+
+    const size_t nBranches = __branchdata.size();
+    for(size_t iBr = 0; iBr < nBranches; ++iBr) prepareChunks(iBr, nChunks);
+
+    // every task is one (branch, chunk) pair. tasks are ordered chunk-wise, so that threads work on different branches of the same range
+    const size_t nTasks = nChunks * nBranches;
+    std::atomic<size_t> nextTask(0);
+    auto worker = [&]() {
+      TFile* file = TFile::Open(filename.c_str());
+      if(file == 0) {
+        std::cout << "ERROR: could not open file " << filename << " in worker thread!" << std::endl;
+        return;
+      }
+      TTree* tree = (TTree*) file->Get(__treename.c_str());
+      if(tree != 0) {
+        for(size_t iTask = nextTask++; iTask < nTasks; iTask = nextTask++) {
+          const size_t iChunk = iTask / nBranches;
+          fetchChunk(iTask % nBranches, tree, iChunk, edges[iChunk], edges[iChunk + 1]);
+        }
+      } else {
+        std::cout << "ERROR: could not get tree " << __treename << " in worker thread!" << std::endl;
+      }
+      file->Close();
+      delete file;
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < std::min<size_t>(nThreads, nTasks); ++i) threads.push_back(std::thread(worker));
+    for(std::thread& thread : threads) thread.join();
+
+    for(size_t iBr = 0; iBr < nBranches; ++iBr) mergeChunks(iBr);
+  }
+
+  // ========================================== CHUNK HANDLING (TYPE DISPATCH) ====================================================
+  void RootTreeData::prepareChunks ( size_t iBr, size_t nChunks )
+  {
+    switch(std::get<2>(__branchdata[iBr])) {
+    case c_double: castBranchData<double>(iBr)->prepareChunks(nChunks); break;
+    case c_int: castBranchData<int>(iBr)->prepareChunks(nChunks); break;
+    case c_uint: castBranchData<unsigned int>(iBr)->prepareChunks(nChunks); break;
+    case c_usint: castBranchData<unsigned short int>(iBr)->prepareChunks(nChunks); break;
+    default: break;
+    }
+  }
+
+  void RootTreeData::fetchChunk ( size_t iBr, TTree* tree, size_t iChunk, int iEvent1, int iEvent2 )
+  {
+    switch(std::get<2>(__branchdata[iBr])) {
+    case c_double: castBranchData<double>(iBr)->fetchChunk(tree, iChunk, iEvent1, iEvent2); break;
+    case c_int: castBranchData<int>(iBr)->fetchChunk(tree, iChunk, iEvent1, iEvent2); break;
+    case c_uint: castBranchData<unsigned int>(iBr)->fetchChunk(tree, iChunk, iEvent1, iEvent2); break;
+    case c_usint: castBranchData<unsigned short int>(iBr)->fetchChunk(tree, iChunk, iEvent1, iEvent2); break;
+    default: break;
+    }
+  }
+
+  void RootTreeData::mergeChunks ( size_t iBr )
+  {
+    switch(std::get<2>(__branchdata[iBr])) {
+    case c_double: castBranchData<double>(iBr)->mergeChunks(); break;
+    case c_int: castBranchData<int>(iBr)->mergeChunks(); break;
+    case c_uint: castBranchData<unsigned int>(iBr)->mergeChunks(); break;
+    case c_usint: castBranchData<unsigned short int>(iBr)->mergeChunks(); break;
+    default: break;
+    }
+  }
+
+  // ====================================================== APPLY CUT =============================================================
+  void RootTreeData::applyCut ( const RootSelection& selection )
+  {
+    if(__branchdata.empty() || selection.empty()) return;
+
+    SelectionColumns columns;
+    for(std::string name : selection.getBranchNames()) {
+      int pos = getPositionByName(__branchdataindex, name);
+      if(pos == -1) {
+        std::cout << "found no branch " << name << " needed for selection in tree " << __treename << ". Not applying cut!" << std::endl;
+        return;
+      }
+      columns[name] = getSelectionColumn(pos);
+    }
+
+    const size_t nValues = columns.begin()->second.size;
+    SelectionBitmap bitmap = selection.evaluate(columns, nValues);
+    std::cout << bitmap.count() << " of " << nValues << " values in tree " << __treename << " pass the selection" << std::endl;
+
+    for(size_t iBr = 0; iBr < __branchdata.size(); ++iBr) {
+      switch(std::get<2>(__branchdata[iBr])) {
+      case c_double: castBranchData<double>(iBr)->applySelection(bitmap); break;
+      case c_int: castBranchData<int>(iBr)->applySelection(bitmap); break;
+      case c_uint: castBranchData<unsigned int>(iBr)->applySelection(bitmap); break;
+      case c_usint: castBranchData<unsigned short int>(iBr)->applySelection(bitmap); break;
+      default: break;
+      }
+    }
+  }
+
+  // ==================================================== FETCH SELECTED ==========================================================
+  void RootTreeData::fetchSelected ( const RootSelection& selection, int iEvent1, int iEvent2 )
+  {
+    if(iEvent2 <= iEvent1 || __branchdata.empty()) return;
+
+    // first read only the branches that are needed to evaluate the selection
+    std::vector<std::string> cutnames = selection.getBranchNames();
+    std::vector<int> cutpositions;
+    std::vector<boost::any> cutvalues(cutnames.size());
+    std::vector<size_t> nValues; // number of values per event
+    SelectionColumns columns;
+    for(size_t iCut = 0; iCut < cutnames.size(); ++iCut) {
+      int pos = getPositionByName(__branchdataindex, cutnames[iCut]);
+      if(pos == -1) {
+        std::cout << "found no branch " << cutnames[iCut] << " needed for selection in tree " << __treename << ". Not fetching data!" << std::endl;
+        return;
+      }
+      std::vector<size_t> nBranchValues;
+      columns[cutnames[iCut]] = readEvents(pos, iEvent1, iEvent2, cutvalues[iCut], nBranchValues);
+      if(iCut == 0) nValues = nBranchValues;
+      else if(nValues != nBranchValues) {
+        std::cout << "ERROR: branch " << cutnames[iCut] << " has a different number of values per event than branch " << cutnames[0] << ". Not fetching data!" << std::endl;
+        return;
+      }
+      cutpositions.push_back(pos);
+    }
+
+    // if there are no cut branches, everything passes and the number of values per event is not yet known
+    if(cutpositions.empty()) {
+      for(int i = iEvent1; i < iEvent2; ++i) addEvent(i);
+      return;
+    }
+
+    std::vector<size_t> offsets(1, 0); // position of the first value of every event in the bitmap
+    for(size_t n : nValues) offsets.push_back(offsets.back() + n);
+    SelectionBitmap bitmap = selection.evaluate(columns, offsets.back());
+    std::cout << bitmap.count() << " of " << offsets.back() << " values in tree " << __treename << " pass the selection" << std::endl;
+
+    for(size_t iBr = 0; iBr < __branchdata.size(); ++iBr) {
+      int iCut = getPositionInVector(cutpositions, (int) iBr);
+      if(iCut != -1) { // the values of the cut branches are already in memory
+        addSelected(iBr, cutvalues[iCut], bitmap);
+        continue;
+      }
+
+      // all other branches are only read for events in which at least one value passes
+      for(int i = iEvent1; i < iEvent2; ++i) {
+        const size_t iEv = i - iEvent1;
+        if(!bitmap.any(offsets[iEv], offsets[iEv + 1])) continue;
+        switch(std::get<2>(__branchdata[iBr])) {
+        case c_double: castBranchData<double>(iBr)->addEventSelected(i, bitmap, offsets[iEv]); break;
+        case c_int: castBranchData<int>(iBr)->addEventSelected(i, bitmap, offsets[iEv]); break;
+        case c_uint: castBranchData<unsigned int>(iBr)->addEventSelected(i, bitmap, offsets[iEv]); break;
+        case c_usint: castBranchData<unsigned short int>(iBr)->addEventSelected(i, bitmap, offsets[iEv]); break;
+        default: break;
+        }
+      }
+    }
+  }
+
+  // ========================================== SELECTION HELPERS (TYPE DISPATCH) =================================================
+  SelectionColumn RootTreeData::getSelectionColumn ( size_t iBr ) const
+  {
+    e_dataTypes type = std::get<2>(__branchdata[iBr]);
+    switch(type) {
+    case c_double: { const std::vector<double>& d = castBranchData<double>(iBr)->getData(); return SelectionColumn(d.data(), type, d.size()); }
+    case c_int: { const std::vector<int>& d = castBranchData<int>(iBr)->getData(); return SelectionColumn(d.data(), type, d.size()); }
+    case c_uint: { const std::vector<unsigned int>& d = castBranchData<unsigned int>(iBr)->getData(); return SelectionColumn(d.data(), type, d.size()); }
+    case c_usint: { const std::vector<unsigned short int>& d = castBranchData<unsigned short int>(iBr)->getData(); return SelectionColumn(d.data(), type, d.size()); }
+    default: return SelectionColumn();
+    }
+  }
+
+  SelectionColumn RootTreeData::readEvents ( size_t iBr, int iEvent1, int iEvent2, boost::any& values, std::vector<size_t>& nValues )
+  {
+    e_dataTypes type = std::get<2>(__branchdata[iBr]);
+    switch(type) {
+    case c_double: {
+      values = std::vector<double>();
+      std::vector<double>& v = *boost::any_cast<std::vector<double> >(&values);
+      castBranchData<double>(iBr)->readEvents(iEvent1, iEvent2, v, nValues);
+      return SelectionColumn(v.data(), type, v.size());
+    }
+    case c_int: {
+      values = std::vector<int>();
+      std::vector<int>& v = *boost::any_cast<std::vector<int> >(&values);
+      castBranchData<int>(iBr)->readEvents(iEvent1, iEvent2, v, nValues);
+      return SelectionColumn(v.data(), type, v.size());
+    }
+    case c_uint: {
+      values = std::vector<unsigned int>();
+      std::vector<unsigned int>& v = *boost::any_cast<std::vector<unsigned int> >(&values);
+      castBranchData<unsigned int>(iBr)->readEvents(iEvent1, iEvent2, v, nValues);
+      return SelectionColumn(v.data(), type, v.size());
+    }
+    case c_usint: {
+      values = std::vector<unsigned short int>();
+      std::vector<unsigned short int>& v = *boost::any_cast<std::vector<unsigned short int> >(&values);
+      castBranchData<unsigned short int>(iBr)->readEvents(iEvent1, iEvent2, v, nValues);
+      return SelectionColumn(v.data(), type, v.size());
+    }
+    default:
+      nValues.assign(iEvent2 - iEvent1, 0);
+      return SelectionColumn();
+    }
+  }
+
+  void RootTreeData::addSelected ( size_t iBr, const boost::any& values, const SelectionBitmap& bitmap )
+  {
+    switch(std::get<2>(__branchdata[iBr])) {
+    case c_double: castBranchData<double>(iBr)->addSelected(boost::any_cast<const std::vector<double>&>(values), bitmap); break;
+    case c_int: castBranchData<int>(iBr)->addSelected(boost::any_cast<const std::vector<int>&>(values), bitmap); break;
+    case c_uint: castBranchData<unsigned int>(iBr)->addSelected(boost::any_cast<const std::vector<unsigned int>&>(values), bitmap); break;
+    case c_usint: castBranchData<unsigned short int>(iBr)->addSelected(boost::any_cast<const std::vector<unsigned short int>&>(values), bitmap); break;
+    default: break;
+    }
+  }
+
+  // ==================================================== FETCH CACHED ============================================================
+  size_t RootTreeData::fetchCached ( const RootColumnCache& cache, size_t& nFailed )
+  {
+    size_t nCached = 0;
+    nFailed = 0;
+    for(size_t iBr = 0; iBr < __branchdata.size(); ++iBr) {
+      bool cached = false, ok = true;
+      switch(std::get<2>(__branchdata[iBr])) {
+      case c_double: ok = castBranchData<double>(iBr)->fetchAllCached(cache, __treename, cached); break;
+      case c_int: ok = castBranchData<int>(iBr)->fetchAllCached(cache, __treename, cached); break;
+      case c_uint: ok = castBranchData<unsigned int>(iBr)->fetchAllCached(cache, __treename, cached); break;
+      case c_usint: ok = castBranchData<unsigned short int>(iBr)->fetchAllCached(cache, __treename, cached); break;
+      default: break;
+      }
+      nCached += cached;
+      nFailed += !ok;
+    }
+    return nCached;
+  }
+
 }
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 
 #include <TObjArray.h>
 #include <TList.h>
@@ -13,27 +14,21 @@
 #include <TFile.h>
 #include <TTree.h>
 #include <TClass.h>
+#include <TLeaf.h>
 
+#include "toolboxtypes.hpp"
 #include "RootBranchData.hpp"
 
 
 namespace RootToolBox {
 
-   /**
-   * enum to classify the datatype that is stored in a branch as vector<type>
-   */
-  enum e_dataTypes{
-    c_double = 1, /**< branch holds vector<double> */
-    c_int = 2, /**<branch holds vector<int> */
-    c_uint = 3, /**< branch holds vector<unsigned int> */
-    c_usint = 4, /**< branch holds vector <unsigned short int> */
-    c_bool = 5, /**< branch holds vector <bool> */
-    c_unknown = -1, /**< branch holds other type */
-  };
+  /** map from the name of a RootObject (RootTree, RootBranch, ...) to its position in a container */
+  typedef std::unordered_map<std::string, size_t> NameIndex;
 
   /** get the names from all trees in the TFile
    * NOTE: source: https://root.cern.ch/phpBB3/viewtopic.php?f=3&t=10421
-    * CAUTION: If TTree::AutoSave "kicks in" there are duplicate trees, which will all get found in this way!
+    * Only the metadata of the keys (class name) are used, i.e. no TTree is read from the file in this function.
+    * CAUTION: If TTree::AutoSave "kicks in" there are duplicate trees (with different cycles), which will all get found in this way!
     * Although ROOT manages to get the "right" TTree via TFile::Get("treename"), this function returns the same name multiple times.
     * This results in the same TTree being added to the RootFile multiple times. As long as there is no reading in of data happening there is no problem with this, however if data reading in is involved the data gets read in multiple times.
     * To avoid that: unique is used to filter out duplicate Tree names!
@@ -43,12 +38,11 @@ namespace RootToolBox {
     std::vector<std::string> names;
 
     TIter nextkey( file->GetListOfKeys() );
-    TKey * key; // , * oldkey = 0;
+    TKey * key;
     while ( (key = (TKey*) nextkey())) {
-      TObject* obj = key->ReadObj();
-      if(obj->IsA()->InheritsFrom( TTree::Class()) ) {
-	TTree* tree = (TTree*) obj;
-	names.push_back(std::string(tree->GetName()));
+      TClass* keyClass = TClass::GetClass(key->GetClassName());
+      if(keyClass != 0 && keyClass->InheritsFrom( TTree::Class()) ) {
+	names.push_back(std::string(key->GetName()));
       }
     }
 
@@ -60,6 +54,25 @@ namespace RootToolBox {
     return names;
   }
 
+  /** build a NameIndex from a vector of names */
+  NameIndex buildNameIndex(const std::vector<std::string>& names)
+  {
+    NameIndex index;
+    index.reserve(names.size());
+    for(size_t i = 0; i < names.size(); ++i) index.insert(std::make_pair(names[i], i)); // first occurence wins (same as a linear search)
+    return index;
+  }
+
+  /** find the position of @param name in @param index
+   * @returns the position if the name can be found, -1 else
+   */
+  const int getPositionByName(const NameIndex& index, const std::string& name)
+  {
+    NameIndex::const_iterator it = index.find(name);
+    if(it != index.end()) return it->second;
+    else return -1;
+  }
+
   /** get the names from all branches in the TTree */
   std::vector<std::string> getBranchNames(TTree* tree)
   {
@@ -77,14 +90,14 @@ namespace RootToolBox {
    * @returns the index in the vector of the object if it can be found, -1 else
    */
   template<typename RootObject>
-  const int getPositionByName(std::vector<RootObject> rootObjects, std::string name)
+  const int getPositionByName(const std::vector<RootObject>& rootObjects, const std::string& name)
   {
     int pos = std::find_if(rootObjects.begin(), rootObjects.end(), [&name](const RootObject& object) { return object.getName() == name; } ) - rootObjects.begin();
     if((uint) pos < rootObjects.size()) return pos; // WARNING: c-style cast to unsigned to suppress warning, but should be no problem, since expecting a positive number from above!
     else return -1;
   }
 
-  const int getPositionByName(std::vector<std::tuple<boost::any, std::string, e_dataTypes> > branchdata, std::string name)
+  const int getPositionByName(const std::vector<std::tuple<boost::any, std::string, e_dataTypes> >& branchdata, const std::string& name)
   {
     int pos = std::find_if(branchdata.begin(), branchdata.end(),
 			   [&name](const std::tuple<boost::any, std::string, e_dataTypes>& tup) { return std::get<1>(tup) == name; } ) - branchdata.begin();
@@ -97,14 +110,30 @@ namespace RootToolBox {
    * @returns the index where t can be found (if t is contained), -1 if t is not contained in vec
    */
   template<typename T>
-  const int getPositionInVector(std::vector<T> vec, T t)
+  const int getPositionInVector(const std::vector<T>& vec, const T& t)
   {
     int pos = std::find(vec.begin(), vec.end(), t) - vec.begin();
-    if(pos < vec.size()) return pos;
+    if((uint) pos < vec.size()) return pos; // WARNING: c-style cast to unsigned to suppress warning
     else return -1;
   }
 
+  /** get the type of a scalar branch (i.e. a branch holding a single value per entry) from the type of its leaf */
+  e_dataTypes getScalarBranchDataType(TBranch* branch, std::string branchname) {
+    TLeaf* leaf = branch->GetLeaf(branchname.c_str());
+    if(leaf == 0 || leaf->GetLen() != 1) return c_unknown; // arrays are not supported
+    std::string type = leaf->GetTypeName();
+    if(type == "Double_t") return c_double;
+    if(type == "Int_t") return c_int;
+    if(type == "UShort_t") return c_usint;
+    if(type == "UInt_t") return c_uint;
+    return c_unknown;
+  }
+
   e_dataTypes getBranchDataType(TTree* tree, std::string branchname) {
+    // scalar branches have to be checked first, since SetBranchAddress complains loudly about the type mismatch else
+    TBranch* branch = tree->GetBranch(branchname.c_str());
+    if(isScalarBranch(branch)) return getScalarBranchDataType(branch, branchname);
+
     // FIXME: cant handle bools at the moment!
     // std::vector<bool>* tmpb = nullptr;
     // if(tree->SetBranchAddress(branchname.c_str(), &tmpb) == 0) return c_bool;
@@ -0,0 +1,19 @@
+// tmadlener: type definitions for the RootToolBox that are needed in several places (without any dependencies)
+
+#pragma once
+
+namespace RootToolBox {
+
+  /**
+   * enum to classify the datatype that is stored in a branch as vector<type>
+   */
+  enum e_dataTypes{
+    c_double = 1, /**< branch holds vector<double> */
+    c_int = 2, /**<branch holds vector<int> */
+    c_uint = 3, /**< branch holds vector<unsigned int> */
+    c_usint = 4, /**< branch holds vector <unsigned short int> */
+    c_bool = 5, /**< branch holds vector <bool> */
+    c_unknown = -1, /**< branch holds other type */
+  };
+
+}
@@ -0,0 +1,171 @@
+// tmadlener: helper functions for handling VxdIDs (in raw format, i.e. as stored in the ThreeHitSamplesTree)
+// NOTE: does not depend on ROOT, can also be used by the tools that do not link against ROOT
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+namespace RootToolBox {
+
+  /** number of layers in the VXD (2 PXD + 4 SVD) */
+  const unsigned c_nVXDLayers = 6;
+
+  /** vxdid layer edges in raw format (same as VXDRANGE in filter_vxdid.m), first is lower, second is upper edge (both inclusive) */
+  const unsigned c_vxdRange[c_nVXDLayers][2] = { {8480, 10304}, {16672, 19520}, {24864, 26432},
+                                                  {33056, 35424}, {41248, 44160}, {49440, 53408} };
+
+  /**
+   * get the layer number [1,6] of a vxdid (raw format)
+   * @returns 0 if the vxdid is in none of the layer ranges
+   */
+  inline unsigned getVXDLayer(unsigned vxdid)
+  {
+    unsigned layer = 0;
+    for(unsigned i = 0; i < c_nVXDLayers; ++i) { // branch free, so that it can be used in vectorized loops
+      layer += (i + 1) * (vxdid >= c_vxdRange[i][0] && vxdid <= c_vxdRange[i][1]);
+    }
+    return layer;
+  }
+
+  // ===================================================== TOPOLOGY CODE ==========================================================
+  /**
+   * flags of the topology code of a sample (see getTopologyCode). The layers of the three hits are stored in the lowest 9 bits
+   * (3 bits each, hit1 first)
+   */
+  enum e_topologyFlags {
+    c_topoConsecutive = 1 << 9, /**< the hits are on consecutive layers (product of the layer differences is 1) */
+    c_topoDuplicate = 1 << 10, /**< at least two (subsequent) hits are on the same layer (product of the layer differences is 0) */
+    c_topoGap = 1 << 11, /**< there is a gap in the layer numbers (product of the layer differences is > 1) */
+  };
+
+  /**
+   * get the topology code of a sample from the vxdids (raw format) of its three hits: the layer of every hit and the flags in
+   * e_topologyFlags, decoded the same way as in filter_vxdid.m (i.e. from the differences of the layers in the order of the hits)
+   */
+  inline unsigned getTopologyCode(unsigned vxdid1, unsigned vxdid2, unsigned vxdid3)
+  {
+    const int layer1 = getVXDLayer(vxdid1), layer2 = getVXDLayer(vxdid2), layer3 = getVXDLayer(vxdid3);
+    const int product = (layer2 - layer1) * (layer3 - layer2);
+    return layer1 | (layer2 << 3) | (layer3 << 6) | (product == 1 ? c_topoConsecutive : 0) | (product == 0 ? c_topoDuplicate : 0)
+      | (product > 1 ? c_topoGap : 0);
+  }
+
+  /** get the layer of hit iHit (0 to 2) from a topology code */
+  inline unsigned getTopologyLayer(unsigned code, unsigned iHit) { return (code >> (3 * iHit)) & 7; }
+
+  /** number of different filters (OPTION in filter_vxdid.m) */
+  const unsigned c_nVXDFilters = 10;
+
+  /**
+   * check if a sample with topology code @param code passes the filter @param filter (same as OPTION in filter_vxdid.m):
+   * 0: consecutive layers, 1-6: the (first) innermost hit is on that layer, 7: not on consecutive layers,
+   * 8: at least two hits on the same layer, 9: gap in the layer numbers
+   */
+  inline bool passVXDFilter(unsigned code, unsigned filter)
+  {
+    switch(filter) {
+    case 0: return code & c_topoConsecutive;
+    case 7: return !(code & c_topoConsecutive);
+    case 8: return code & c_topoDuplicate;
+    case 9: return code & c_topoGap;
+    default: return filter < 7 && getTopologyLayer(code, 0) == filter;
+    }
+  }
+
+  // ==================================================== VXD FILTER INDEX ========================================================
+  /**
+   * bitmap index over the samples of a file: one bitmap per filter of filter_vxdid.m, where bit i is set if sample i passes it.
+   * It is built once from the topology codes (e.g. by root2dat -t or datindex -t) and stored in a sidecar file (<file>.vxd), such
+   * that the tools can select the samples of any filter without decoding the vxdids again.
+   */
+  class VXDFilterIndex {
+  public:
+    VXDFilterIndex() : m_nRows(0), m_datSize(-1), m_datMTime(-1) {}
+
+    /** append a sample with topology code @param code */
+    void add(unsigned code)
+    {
+      if(m_nRows % 64 == 0) for(unsigned f = 0; f < c_nVXDFilters; ++f) m_words[f].push_back(0);
+      for(unsigned f = 0; f < c_nVXDFilters; ++f) m_words[f].back() |= uint64_t(passVXDFilter(code, f)) << (m_nRows % 64);
+      m_nRows++;
+    }
+
+    uint64_t getNRows() const { return m_nRows; } /**< number of samples */
+
+    /** check if sample iRow passes filter */
+    bool test(unsigned filter, uint64_t iRow) const { return (m_words[filter][iRow / 64] >> (iRow % 64)) & 1; }
+
+    /** get the number of samples that pass filter */
+    uint64_t count(unsigned filter) const
+    {
+      uint64_t n = 0;
+      for(uint64_t word : m_words[filter]) n += __builtin_popcountll(word);
+      return n;
+    }
+
+    const std::vector<uint64_t>& getWords(unsigned filter) const { return m_words[filter]; } /**< bitmap of filter (64 samples per word) */
+
+    /** set the size and modification time (in ns) of the file the index belongs to (stored in the index file) */
+    void setSource(int64_t datSize, int64_t datMTime) { m_datSize = datSize; m_datMTime = datMTime; }
+
+    int64_t getSourceSize() const { return m_datSize; } /**< size of the file the index belongs to */
+
+    int64_t getSourceMTime() const { return m_datMTime; } /**< modification time (in ns) of the file the index belongs to */
+
+    /** write the index to a file */
+    bool write(std::string filename) const;
+
+    /** read the index from a file. @returns false if it cannot be read */
+    bool load(std::string filename);
+
+    static std::string getSidecarName(std::string datfile) { return datfile + ".vxd"; } /**< get the name of the sidecar file */
+
+  private:
+    uint64_t m_nRows; /**< number of samples */
+    int64_t m_datSize; /**< size of the file the index belongs to */
+    int64_t m_datMTime; /**< modification time of the file the index belongs to in ns */
+    std::vector<uint64_t> m_words[c_nVXDFilters]; /**< bitmaps of all filters */
+  };
+
+  /** magic bytes at the beginning of a VXDFilterIndex file */
+  const char c_vxdFilterMagic[8] = {'V', 'X', 'D', 'F', 'I', 'L', '0', '2'};
+
+  inline bool VXDFilterIndex::write(std::string filename) const
+  {
+    std::ofstream outfile(filename.c_str(), std::ofstream::binary);
+    uint32_t nFilters = c_nVXDFilters;
+    outfile.write(c_vxdFilterMagic, sizeof(c_vxdFilterMagic));
+    outfile.write((const char*) &m_datSize, sizeof(m_datSize));
+    outfile.write((const char*) &m_datMTime, sizeof(m_datMTime));
+    outfile.write((const char*) &m_nRows, sizeof(m_nRows));
+    outfile.write((const char*) &nFilters, sizeof(nFilters));
+    for(unsigned f = 0; f < c_nVXDFilters; ++f) outfile.write((const char*) m_words[f].data(), m_words[f].size() * sizeof(uint64_t));
+    return outfile.good();
+  }
+
+  inline bool VXDFilterIndex::load(std::string filename)
+  {
+    std::ifstream infile(filename.c_str(), std::ifstream::binary);
+    char magic[sizeof(c_vxdFilterMagic)];
+    uint32_t nFilters = 0;
+    infile.read(magic, sizeof(magic));
+    infile.read((char*) &m_datSize, sizeof(m_datSize));
+    infile.read((char*) &m_datMTime, sizeof(m_datMTime));
+    infile.read((char*) &m_nRows, sizeof(m_nRows));
+    infile.read((char*) &nFilters, sizeof(nFilters));
+    if(!infile || memcmp(magic, c_vxdFilterMagic, sizeof(magic)) != 0 || nFilters != c_nVXDFilters) {
+      m_nRows = 0;
+      return false;
+    }
+    for(unsigned f = 0; f < c_nVXDFilters; ++f) {
+      m_words[f].resize((m_nRows + 63) / 64);
+      infile.read((char*) m_words[f].data(), m_words[f].size() * sizeof(uint64_t));
+    }
+    return bool(infile);
+  }
+
+}
@@ -0,0 +1,241 @@
+// angular analysis of the performance of a classifier: efficiency and SNR gain in bins of phi and theta of the first hit
+// (replaces analyze_class_angular.m, which calls analyze_class_bins.m for every angle and rescans all outputs for every bin)
+//
+// The angles are computed from the (not decorrelated) x, y, z of the first hit (first three columns of the data file) as in
+// cart2sph_basf2. Then all samples are histogrammed in a single parallel pass (thread-local counts, merged at the end).
+// As in analyze_class_bins.m signal means target == 1 and samples with output >= cut pass.
+//
+// by Thomas Madlener, 2015
+
+#include "classanalysis.h"
+#include "datreader.h"
+#include "vxdfilter.h"
+#include "datformat.h"
+#include "parallel_helper.h"
+#include "tt_timer.h"
+#include "tt_profiler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <limits>
+
+// getopt
+#include <unistd.h>
+
+using namespace classanalysis;
+using namespace timing;
+
+/** parse a range of the form lower:upper. @returns false if it is malformed */
+bool parseRange(std::string range, double& lower, double& upper)
+{
+  size_t colon = range.find(':');
+  if(colon == std::string::npos) return false;
+  lower = atof(range.substr(0, colon).c_str());
+  upper = atof(range.substr(colon + 1).c_str());
+  return upper > lower;
+}
+
+/** print the per bin performance and write it to a .dat file (if @param filename is not empty) */
+bool writeBins(std::string name, std::string filename, const BinnedEfficiency& bins)
+{
+  std::cout << std::endl << std::setw(12) << name << std::setw(12) << "nSignal" << std::setw(12) << "nBackground"
+            << std::setw(12) << "efficiency" << std::setw(12) << "SNR gain" << std::endl;
+  std::ios::fmtflags flags = std::cout.flags();
+  std::cout << std::fixed;
+  for(size_t i = 0; i < bins.getNBins(); ++i) {
+    std::cout << std::setprecision(2) << std::setw(12) << 0.5 * (bins.getLowEdge(i) + bins.getLowEdge(i + 1))
+              << std::setw(12) << bins.getNSignal(i) << std::setw(12) << bins.getNBackground(i)
+              << std::setprecision(4) << std::setw(12) << bins.getEfficiency(i) << std::setw(12) << bins.getSNRGain(i) << std::endl;
+  }
+  std::cout.flags(flags);
+
+  if(filename.empty()) return true;
+  std::ofstream outfile(filename.c_str());
+  if(!outfile) {
+    std::cerr << "ERROR: could not open " << filename << std::endl;
+    return false;
+  }
+  outfile << "# low_edge high_edge center nSignal nBackground nSignalPass nBackgroundPass efficiency snr_gain" << std::endl;
+  std::string line;
+  for(size_t i = 0; i < bins.getNBins(); ++i) {
+    line.clear();
+    datformat::appendValue(line, bins.getLowEdge(i)); line.push_back(' ');
+    datformat::appendValue(line, bins.getLowEdge(i + 1)); line.push_back(' ');
+    datformat::appendValue(line, 0.5 * (bins.getLowEdge(i) + bins.getLowEdge(i + 1))); line.push_back(' ');
+    datformat::appendValue(line, (unsigned long long) bins.getNSignal(i)); line.push_back(' ');
+    datformat::appendValue(line, (unsigned long long) bins.getNBackground(i)); line.push_back(' ');
+    datformat::appendValue(line, (unsigned long long) bins.getNSignalPass(i)); line.push_back(' ');
+    datformat::appendValue(line, (unsigned long long) bins.getNBackgroundPass(i)); line.push_back(' ');
+    datformat::appendValue(line, bins.getEfficiency(i)); line.push_back(' ');
+    datformat::appendValue(line, bins.getSNRGain(i)); line.push_back('\n');
+    outfile << line;
+  }
+  std::cout << "wrote " << name << " bins to " << filename << std::endl;
+  return true;
+}
+
+#ifndef __CINT__
+/**
+ * usage: angularanalysis [-j nThreads] [-c cut] [-e efficiency] [-p nPhiBins] [-t nThetaBins] [-P lower:upper] [-T lower:upper]
+ *                        [-V filter] [-o prefix] datafile scorefile
+ * datafile: .dat file with the (not decorrelated) inputs, starting with x, y, z of the first hit, and the truth in the last column
+ * scorefile: outputs of the classifier for the samples of the data file (first column is used)
+ * -c: cut value (default: the cut for efficiency -e (0.99) over all samples, as calculate_cut.m)
+ * -p, -t: number of phi and theta bins (default 72 and 28). The bins span the range of the angles in the data (as histcounts),
+ *         unless it is fixed with -P and -T (in degrees)
+ * -V: use only the samples that pass filter (0-9, see RootToolBox::passVXDFilter), needs the VXD filter index (datafile.vxd)
+ * -o: write the bins to prefix_phi.dat and prefix_theta.dat
+ */
+int main(int argc, char* argv[])
+{
+  unsigned nThreads = 0;
+  double cut = std::numeric_limits<double>::quiet_NaN();
+  double efficiency = 0.99;
+  size_t nPhiBins = 72, nThetaBins = 28; // 5 deg per bin in phi, approx. 5 deg per bin in theta
+  double phiLower = 0, phiUpper = 0, thetaLower = 0, thetaUpper = 0;
+  bool fixedPhi = false, fixedTheta = false;
+  int vxdFilter = -1;
+  std::string prefix;
+  int opt;
+  while((opt = getopt(argc, argv, "j:c:e:p:t:P:T:V:o:")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = atoi(optarg); break;
+    case 'c': cut = atof(optarg); break;
+    case 'e': efficiency = atof(optarg); break;
+    case 'p': nPhiBins = std::max(1L, atol(optarg)); break;
+    case 't': nThetaBins = std::max(1L, atol(optarg)); break;
+    case 'P': fixedPhi = parseRange(optarg, phiLower, phiUpper); if(!fixedPhi) { std::cerr << "invalid range " << optarg << std::endl; return 1; } break;
+    case 'T': fixedTheta = parseRange(optarg, thetaLower, thetaUpper); if(!fixedTheta) { std::cerr << "invalid range " << optarg << std::endl; return 1; } break;
+    case 'V': vxdFilter = atoi(optarg); break;
+    case 'o': prefix = optarg; break;
+    default:
+      std::cerr << "usage: " << argv[0] << " [-j nThreads] [-c cut] [-e efficiency] [-p nPhiBins] [-t nThetaBins] [-P lower:upper]"
+                << " [-T lower:upper] [-V filter] [-o prefix] datafile scorefile" << std::endl;
+      return 1;
+    }
+  }
+  if(argc - optind < 2) {
+    std::cerr << "need a data file and a score file" << std::endl;
+    return 1;
+  }
+  if(vxdFilter >= int(RootToolBox::c_nVXDFilters)) {
+    std::cerr << "invalid VXD filter " << vxdFilter << " (expected 0 to " << RootToolBox::c_nVXDFilters - 1 << ")" << std::endl;
+    return 1;
+  }
+  nThreads = parallel::getNThreads(nThreads);
+
+  TT_PROFILE_SCOPE("angularanalysis");
+  TicTocTimer timer(1000000); // want ms
+  std::cout << "reading data ... " << std::flush;
+  ScopedTimer readScope("read");
+  datfile::DatReader datareader(argv[optind]);
+  datfile::DatReader scorereader(argv[optind + 1]);
+  if(!datareader.good() || !scorereader.good()) return 1;
+  const size_t nColumns = datareader.getNColumns();
+  const size_t nScoreColumns = scorereader.getNColumns();
+  const size_t nSamples = datareader.getNRows();
+  if(nColumns < 4) {
+    std::cerr << "the data file needs at least x, y, z of the first hit and the truth" << std::endl;
+    return 1;
+  }
+  if(scorereader.getNRows() != nSamples) {
+    std::cerr << "ERROR: score file has " << scorereader.getNRows() << " rows, but the data file has " << nSamples << std::endl;
+    return 1;
+  }
+  RootToolBox::VXDFilterIndex vxdIndex;
+  if(vxdFilter >= 0 && !datfile::loadVXDFilterIndex(argv[optind], nSamples, vxdIndex)) return 1;
+  // samples that are not selected by the VXD filter are ignored everywhere below (also for the ranges of the angles and the cut)
+  auto selected = [&](size_t i) { return vxdFilter < 0 || vxdIndex.test(vxdFilter, i); };
+  std::vector<double> data, scores;
+  datareader.readRowsParallel(0, nSamples, data, nThreads);
+  scorereader.readRowsParallel(0, nSamples, scores, nThreads);
+  readScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+
+  // angles (columns of the first hit copied into separate arrays, such that the conversion can be vectorized)
+  timer.tic();
+  std::cout << "calculating angles ... " << std::flush;
+  ScopedTimer anglesScope("angles");
+  std::vector<double> x(nSamples), y(nSamples), z(nSamples), theta(nSamples), phi(nSamples);
+  const double maxValue = std::numeric_limits<double>::max();
+  std::vector<double> threadLimits; // per thread: phi min, phi max, theta min, theta max
+  for(unsigned t = 0; t < nThreads; ++t) threadLimits.insert(threadLimits.end(), {maxValue, -maxValue, maxValue, -maxValue});
+  parallel::parallelFor(nSamples, nThreads, [&](size_t first, size_t last, unsigned iThread) {
+      for(size_t i = first; i < last; ++i) {
+        x[i] = data[i * nColumns];
+        y[i] = data[i * nColumns + 1];
+        z[i] = data[i * nColumns + 2];
+      }
+      cart2sphBasf2(&x[first], &y[first], &z[first], last - first, &theta[first], &phi[first]);
+      double* limits = &threadLimits[4 * iThread];
+      for(size_t i = first; i < last; ++i) {
+        if(!selected(i)) continue;
+        if(phi[i] == phi[i]) { limits[0] = std::min(limits[0], phi[i]); limits[1] = std::max(limits[1], phi[i]); }
+        if(theta[i] == theta[i]) { limits[2] = std::min(limits[2], theta[i]); limits[3] = std::max(limits[3], theta[i]); }
+      }
+    });
+  if(!fixedPhi || !fixedTheta) {
+    double limits[4] = {maxValue, -maxValue, maxValue, -maxValue};
+    for(unsigned t = 0; t < nThreads; ++t) {
+      limits[0] = std::min(limits[0], threadLimits[4 * t]); limits[1] = std::max(limits[1], threadLimits[4 * t + 1]);
+      limits[2] = std::min(limits[2], threadLimits[4 * t + 2]); limits[3] = std::max(limits[3], threadLimits[4 * t + 3]);
+    }
+    if(!fixedPhi) { phiLower = limits[0]; phiUpper = limits[1] > limits[0] ? limits[1] : limits[0] + 1; }
+    if(!fixedTheta) { thetaLower = limits[2]; thetaUpper = limits[3] > limits[2] ? limits[3] : limits[2] + 1; }
+  }
+  anglesScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+
+  // cut for the desired efficiency over all samples (exact, via selection of the ceil(nSignal * efficiency)-th highest signal output)
+  if(cut != cut) {
+    std::vector<double> signalScores;
+    for(size_t i = 0; i < nSamples; ++i) {
+      if(selected(i) && data[i * nColumns + nColumns - 1] == 1 && scores[i * nScoreColumns] == scores[i * nScoreColumns]) {
+        signalScores.push_back(scores[i * nScoreColumns]);
+      }
+    }
+    if(signalScores.empty()) {
+      std::cerr << "there are no signal samples to determine the cut from. Pass it with -c" << std::endl;
+      return 1;
+    }
+    size_t k = std::max<size_t>(1, std::ceil(signalScores.size() * efficiency)) - 1;
+    k = std::min(k, signalScores.size() - 1);
+    std::nth_element(signalScores.begin(), signalScores.begin() + k, signalScores.end(), std::greater<double>());
+    cut = signalScores[k];
+    std::cout << "cut for efficiency " << efficiency << ": " << cut << std::endl;
+  }
+
+  // single pass over all samples, filling phi and theta bins
+  timer.tic();
+  std::cout << "histogramming ... " << std::flush;
+  ScopedTimer histScope("histogram");
+  std::vector<BinnedEfficiency> threadPhi(nThreads, BinnedEfficiency(nPhiBins, phiLower, phiUpper));
+  std::vector<BinnedEfficiency> threadTheta(nThreads, BinnedEfficiency(nThetaBins, thetaLower, thetaUpper));
+  parallel::parallelFor(nSamples, nThreads, [&](size_t first, size_t last, unsigned iThread) {
+      BinnedEfficiency& phiBins = threadPhi[iThread];
+      BinnedEfficiency& thetaBins = threadTheta[iThread];
+      for(size_t i = first; i < last; ++i) {
+        const double score = scores[i * nScoreColumns];
+        if(score != score || !selected(i)) continue;
+        const bool signal = data[i * nColumns + nColumns - 1] == 1;
+        const bool pass = score >= cut;
+        phiBins.fill(phi[i], signal, pass);
+        thetaBins.fill(theta[i], signal, pass);
+      }
+    });
+  for(unsigned t = 1; t < threadPhi.size(); ++t) {
+    threadPhi[0].add(threadPhi[t]);
+    threadTheta[0].add(threadTheta[t]);
+  }
+  histScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+
+  if(!writeBins("phi [deg]", prefix.empty() ? "" : prefix + "_phi.dat", threadPhi[0])) return 1;
+  if(!writeBins("theta [deg]", prefix.empty() ? "" : prefix + "_theta.dat", threadTheta[0])) return 1;
+
+  return 0;
+}
+#endif
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+// getopt
+#include <unistd.h>
+
+#include "../tt_timer.h"
+
+namespace bench {
+
+  /** keep the compiler from optimizing away the computation of value */
+  template<typename T>
+  inline void doNotOptimize(const T& value) { asm volatile("" : : "g"(&value) : "memory"); }
+
+  /** options of a benchmark run (common to all benchmark programs, see parseOptions) */
+  struct BenchOptions {
+    unsigned nWarmup; /**< number of (not measured) warmup runs of every benchmark */
+    unsigned minReps; /**< minimal number of measured repetitions */
+    unsigned maxReps; /**< maximal number of measured repetitions */
+    double minTime; /**< repeat (at least minReps times) until this time (ms) has been spent in the measurements */
+    std::string output; /**< JSON file the results are written to (none if empty) */
+    std::string baseline; /**< JSON file of an earlier run to compare with (none if empty) */
+    double threshold; /**< relative change of the median that is reported as regression / improvement */
+    std::string filter; /**< only run the benchmarks whose name contains this */
+    size_t nSamples; /**< number of (synthetic) samples the kernels work on */
+
+    BenchOptions() : nWarmup(2), minReps(5), maxReps(1000), minTime(500), threshold(0.05), nSamples(100000) {}
+  };
+
+  /** print the usage of the common options */
+  inline void printUsage(const char* program, std::string positional = "")
+  {
+    std::cerr << "usage: " << program << " [-w nWarmup] [-r minReps] [-R maxReps] [-t minTime(ms)] [-n nSamples] [-f filter]"
+              << " [-o results.json] [-b baseline.json [-T threshold]]" << (positional.empty() ? "" : " ") << positional << std::endl;
+  }
+
+  /**
+   * parse the common options of the benchmark programs (see printUsage). Additional options of a program can be passed in extraOpts
+   * (getopt syntax), they are handed to extraFunc (option, argument), which returns false if the argument is invalid.
+   * @returns the index of the first positional argument or -1 if an option is invalid
+   */
+  inline int parseOptions(int argc, char* argv[], BenchOptions& options, std::string extraOpts = "",
+                          std::function<bool(int, const char*)> extraFunc = std::function<bool(int, const char*)>())
+  {
+    const std::string optstring = "w:r:R:t:n:f:o:b:T:h" + extraOpts;
+    int opt;
+    while((opt = getopt(argc, argv, optstring.c_str())) != -1) {
+      if(extraFunc && opt != '?' && extraOpts.find(char(opt)) != std::string::npos) {
+        if(!extraFunc(opt, optarg)) return -1;
+        continue;
+      }
+      switch(opt) {
+      case 'w': options.nWarmup = atoi(optarg); break;
+      case 'r': options.minReps = std::max(1, atoi(optarg)); break;
+      case 'R': options.maxReps = std::max(1, atoi(optarg)); break;
+      case 't': options.minTime = atof(optarg); break;
+      case 'n': options.nSamples = std::max(1L, atol(optarg)); break;
+      case 'f': options.filter = optarg; break;
+      case 'o': options.output = optarg; break;
+      case 'b': options.baseline = optarg; break;
+      case 'T': options.threshold = atof(optarg); break;
+      default: return -1;
+      }
+    }
+    options.maxReps = std::max(options.maxReps, options.minReps);
+    return optind;
+  }
+
+  /** result of one benchmark (all times in ns per repetition) */
+  struct BenchResult {
+    std::string name; /**< name of the benchmark */
+    uint64_t nItems; /**< number of items processed per repetition */
+    std::string itemName; /**< name of one item */
+    std::vector<double> times; /**< the single measurements */
+    double mean; /**< mean */
+    double stddev; /**< standard deviation */
+    double median; /**< median */
+    double min; /**< fastest repetition */
+    double max; /**< slowest repetition */
+
+    BenchResult() : nItems(0), mean(0), stddev(0), median(0), min(0), max(0) {}
+
+    void summarize(); /**< compute the statistics from times */
+
+    double getPerItem() const { return nItems ? median / nItems : median; } /**< median time per item */
+  };
+
+  inline void BenchResult::summarize()
+  {
+    if(times.empty()) return;
+    std::vector<double> sorted(times);
+    std::sort(sorted.begin(), sorted.end());
+    const size_t n = sorted.size();
+    min = sorted.front();
+    max = sorted.back();
+    median = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    double sum = 0;
+    for(double t : sorted) sum += t;
+    mean = sum / n;
+    double sum2 = 0;
+    for(double t : sorted) sum2 += (t - mean) * (t - mean);
+    stddev = n > 1 ? std::sqrt(sum2 / (n - 1)) : 0;
+  }
+
+  /**
+   * runs the benchmarks, prints a summary line for each and collects the results.
+   * Every benchmark is run nWarmup times without measurement and then repeated (at least minReps and at most maxReps times) until
+   * minTime has been spent. A setup function (not measured) can be run before every repetition, e.g. to reset the output.
+   * usage:
+   *   BenchRunner runner(options);
+   *   runner.run("parse", nLines, "line", [&]() { ... });
+   *   runner.finish(); // writes the JSON file and compares with the baseline
+   */
+  class BenchRunner {
+  public:
+    BenchRunner(const BenchOptions& options);
+
+    /** check if the benchmark @param name passes the filter */
+    bool selected(const std::string& name) const { return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos; }
+
+    /** run the benchmark @param name processing nItems items of type itemName in each call of func */
+    void run(std::string name, uint64_t nItems, std::string itemName, std::function<void()> func,
+             std::function<void()> setup = std::function<void()>());
+
+    const std::vector<BenchResult>& getResults() const { return m_results; } /**< the results of all benchmarks run so far */
+
+    void writeJSON(std::ostream& os) const; /**< write the results as JSON */
+
+    /** compare with the results from the JSON file @param filename. @returns false if a benchmark got slower than the threshold */
+    bool compare(std::string filename, std::ostream& os) const;
+
+    /** write the output file and compare with the baseline (if requested). @returns false if there are regressions */
+    bool finish();
+
+  private:
+    BenchOptions m_options; /**< the options */
+    std::vector<BenchResult> m_results; /**< the results */
+  };
+
+  /** read the medians of all benchmarks from a JSON file written by BenchRunner::writeJSON (one benchmark per line) */
+  inline bool readBaseline(std::string filename, std::map<std::string, double>& medians)
+  {
+    std::ifstream infile(filename.c_str());
+    if(!infile) return false;
+    std::string line;
+    while(std::getline(infile, line)) {
+      size_t namePos = line.find("\"name\": \"");
+      size_t medianPos = line.find("\"median\": ");
+      if(namePos == std::string::npos || medianPos == std::string::npos) continue;
+      namePos += 9;
+      size_t nameEnd = line.find('"', namePos);
+      if(nameEnd == std::string::npos) continue;
+      medians[line.substr(namePos, nameEnd - namePos)] = atof(line.c_str() + medianPos + 10);
+    }
+    return true;
+  }
+
+  // ========================================================== RUNNER ============================================================
+  inline BenchRunner::BenchRunner(const BenchOptions& options) : m_options(options)
+  {
+    std::cout << std::left << std::setw(52) << "benchmark" << std::right << std::setw(8) << "reps" << std::setw(14) << "median [ms]"
+              << std::setw(12) << "+- [%]" << std::setw(14) << "min [ms]" << std::setw(22) << "per item [ns]" << std::endl;
+  }
+
+  inline void BenchRunner::run(std::string name, uint64_t nItems, std::string itemName, std::function<void()> func,
+                               std::function<void()> setup)
+  {
+    if(!selected(name)) return;
+    for(unsigned i = 0; i < m_options.nWarmup; ++i) {
+      if(setup) setup();
+      func();
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.nItems = nItems;
+    result.itemName = itemName;
+    timing::TicTocTimer timer(1); // ns
+    double total = 0;
+    while(result.times.size() < m_options.minReps || (total < m_options.minTime * 1e6 && result.times.size() < m_options.maxReps)) {
+      if(setup) setup();
+      timer.tic();
+      func();
+      timer.toc();
+      result.times.push_back(timer.time());
+      total += result.times.back();
+    }
+    result.summarize();
+
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::left << std::setw(52) << name << std::right << std::fixed << std::setw(8) << result.times.size()
+              << std::setprecision(3) << std::setw(14) << result.median / 1e6
+              << std::setprecision(1) << std::setw(12) << (result.mean > 0 ? 100 * result.stddev / result.mean : 0)
+              << std::setprecision(3) << std::setw(14) << result.min / 1e6
+              << std::setw(14) << result.getPerItem() << " / " << std::left << itemName << std::endl;
+    std::cout.flags(flags);
+    m_results.push_back(result);
+  }
+
+  inline void BenchRunner::writeJSON(std::ostream& os) const
+  {
+    time_t now = time(0);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    os << "{\n  \"date\": \"" << date << "\",\n  \"compiler\": \"" << __VERSION__ << "\",\n  \"samples\": " << m_options.nSamples
+       << ",\n  \"unit\": \"ns\",\n  \"benchmarks\": [";
+    bool first = true;
+    for(const BenchResult& result : m_results) {
+      os << (first ? "\n" : ",\n") << "    {\"name\": \"" << result.name << "\", \"items\": " << result.nItems << ", \"item\": \""
+         << result.itemName << "\", \"repetitions\": " << result.times.size() << std::fixed << std::setprecision(0)
+         << ", \"median\": " << result.median << ", \"mean\": " << result.mean << ", \"stddev\": " << result.stddev
+         << ", \"min\": " << result.min << ", \"max\": " << result.max << std::setprecision(3)
+         << ", \"per_item\": " << result.getPerItem() << "}" << std::defaultfloat;
+      first = false;
+    }
+    os << "\n  ]\n}\n";
+  }
+
+  inline bool BenchRunner::compare(std::string filename, std::ostream& os) const
+  {
+    std::map<std::string, double> baseline;
+    if(!readBaseline(filename, baseline)) {
+      std::cerr << "ERROR: could not read baseline " << filename << std::endl;
+      return false;
+    }
+
+    os << std::endl << "comparison with " << filename << " (median, threshold " << 100 * m_options.threshold << " %)" << std::endl;
+    os << std::left << std::setw(52) << "benchmark" << std::right << std::setw(16) << "baseline [ms]" << std::setw(14) << "now [ms]"
+       << std::setw(12) << "change [%]" << std::endl;
+    std::ios::fmtflags flags = os.flags();
+    bool good = true;
+    for(const BenchResult& result : m_results) {
+      auto it = baseline.find(result.name);
+      if(it == baseline.end() || it->second <= 0) {
+        os << std::left << std::setw(52) << result.name << std::right << std::setw(16) << "-" << std::fixed << std::setprecision(3)
+           << std::setw(14) << result.median / 1e6 << std::setw(12) << "-" << "  (new)" << std::endl;
+        continue;
+      }
+      const double change = result.median / it->second - 1;
+      os << std::left << std::setw(52) << result.name << std::right << std::fixed << std::setprecision(3) << std::setw(16) << it->second / 1e6
+         << std::setw(14) << result.median / 1e6 << std::setprecision(1) << std::setw(12) << 100 * change;
+      if(change > m_options.threshold) {
+        os << "  REGRESSION";
+        good = false;
+      } else if(change < -m_options.threshold) {
+        os << "  improved";
+      }
+      os << std::endl;
+      os.flags(flags);
+    }
+    os.flags(flags);
+    return good;
+  }
+
+  inline bool BenchRunner::finish()
+  {
+    if(!m_options.output.empty()) {
+      std::ofstream outfile(m_options.output.c_str());
+      if(!outfile) std::cerr << "ERROR: could not write results to " << m_options.output << std::endl;
+      else writeJSON(outfile);
+    }
+    if(m_options.baseline.empty()) return true;
+    return compare(m_options.baseline, std::cout);
+  }
+}
@@ -0,0 +1,301 @@
+// benchmark of the engines that can evaluate a FastBDT: natively (as fbdt-eval does) and via the TMVA plugin (as evaltmva does, only
+// if compiled with -DWITH_TMVA, see makefile). All engines get identical inputs in memory (the first rows of a data file, decorrelated
+// with the transform next to the FastBDT if there is one and rounded to float once, since the TMVA::Reader can only handle floats).
+// For every engine the following is reported:
+//   - latency: distribution of the time to evaluate a single sample (every sample timed on its own, corrected for the overhead of
+//     the clock)
+//   - throughput: time to evaluate all samples at once (with the BenchRunner, i.e. it can be saved and compared with a baseline)
+//   - agreement: largest difference of the scores to the first (native) engine (and between single and batch evaluation)
+// Exits with 1 if an engine disagrees by more than the tolerance (or there are regressions with respect to the baseline).
+// See bench.h for the common options (e.g. -o results.json to save the results and -b baseline.json to compare with them)
+
+#include "FBDT.h"
+#include "FBDT_Reader.h"
+
+#include "bench.h"
+#include "../datreader.h"
+#include "../decorrelation.h"
+
+#ifdef WITH_TMVA
+#include "../tmva_reader.h"
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+using namespace FastBDT;
+using namespace bench;
+
+/** an engine that evaluates a FastBDT */
+class Engine {
+public:
+  virtual ~Engine() {}
+
+  virtual std::string getName() const = 0; /**< name of the engine */
+
+  /** evaluate a single sample (nInputs values) */
+  virtual double evaluate(const float* sample) = 0;
+
+  /** evaluate nSamples samples (row-major, nInputs values per sample). Default: one sample after the other */
+  virtual void evaluateBatch(const float* samples, size_t nSamples, size_t nInputs, double* scores)
+  {
+    for(size_t i = 0; i < nSamples; ++i) scores[i] = evaluate(samples + i * nInputs);
+  }
+};
+
+/** native evaluation: FeatureBinning::ValueToBin and Forest::Analyse */
+class NativeEngine : public Engine {
+public:
+  NativeEngine(Forest forest, std::vector<FeatureBinning<double> > featBins) :
+    m_forest(forest), m_featBins(featBins), m_event(featBins.size()) {}
+
+  std::string getName() const override { return "native"; }
+
+  double evaluate(const float* sample) override
+  {
+    for(size_t i = 0; i < m_featBins.size(); ++i) m_event[i] = m_featBins[i].ValueToBin(sample[i]);
+    return m_forest.Analyse(m_event);
+  }
+
+  /** same as fbdt-eval: bin all samples first, then evaluate them */
+  void evaluateBatch(const float* samples, size_t nSamples, size_t nInputs, double* scores) override
+  {
+    m_bins.resize(nSamples * nInputs);
+    for(size_t iE = 0; iE < nSamples; ++iE) {
+      for(size_t i = 0; i < nInputs; ++i) m_bins[iE * nInputs + i] = m_featBins[i].ValueToBin(samples[iE * nInputs + i]);
+    }
+    for(size_t iE = 0; iE < nSamples; ++iE) {
+      std::copy(&m_bins[iE * nInputs], &m_bins[(iE + 1) * nInputs], m_event.begin());
+      scores[iE] = m_forest.Analyse(m_event);
+    }
+  }
+
+private:
+  Forest m_forest; /**< the forest */
+  std::vector<FeatureBinning<double> > m_featBins; /**< its binning */
+  std::vector<unsigned> m_event; /**< binned sample */
+  std::vector<unsigned> m_bins; /**< binned samples of a batch */
+};
+
+#ifdef WITH_TMVA
+/** evaluation via the FastBDT plugin of TMVA (same as evaltmva) */
+class TMVAEngine : public Engine {
+public:
+  TMVAEngine(std::string weightfile, size_t nInputs) : m_reader("FastBDT", weightfile), m_input(nInputs)
+  {
+    loadPlugins("FastBDT");
+    const std::vector<std::string> names = getInputNames();
+    for(size_t i = 0; i < nInputs; ++i) m_reader.addVariable(names[i], m_input[i]);
+    m_reader.bookMethod();
+  }
+
+  std::string getName() const override { return "tmva"; }
+
+  double evaluate(const float* sample) override
+  {
+    std::copy(sample, sample + m_input.size(), m_input.begin());
+    return m_reader.evaluate();
+  }
+
+private:
+  TMVAReader m_reader; /**< the reader (bound to m_input) */
+  std::vector<float> m_input; /**< input buffer */
+};
+#endif
+
+/** latency distribution of an engine (in ns) */
+struct Latency {
+  double mean; /**< mean */
+  std::vector<double> percentiles; /**< at c_percentiles */
+};
+
+/** percentiles of the latency that are reported */
+const std::vector<double> c_percentiles = { 50, 90, 99, 99.9, 100 };
+
+/** get the overhead of a (empty) time measurement with steady_clock (median in ns) */
+double getClockOverhead()
+{
+  std::vector<double> times(10000);
+  for(double& t : times) {
+    auto start = std::chrono::steady_clock::now();
+    t = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+/** time every sample on its own and get the distribution (corrected by overhead) */
+Latency measureLatency(Engine& engine, const std::vector<float>& samples, size_t nSamples, size_t nInputs, unsigned nWarmup,
+                       double overhead)
+{
+  for(unsigned w = 0; w < nWarmup; ++w) {
+    for(size_t i = 0; i < std::min(nSamples, size_t(1000)); ++i) doNotOptimize(engine.evaluate(&samples[i * nInputs]));
+  }
+  std::vector<double> times(nSamples);
+  for(size_t i = 0; i < nSamples; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    double score = engine.evaluate(&samples[i * nInputs]);
+    times[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    doNotOptimize(score);
+    times[i] = std::max(0., times[i] - overhead);
+  }
+  std::sort(times.begin(), times.end());
+  Latency latency;
+  latency.mean = 0;
+  for(double t : times) latency.mean += t;
+  latency.mean /= std::max(nSamples, size_t(1));
+  for(double p : c_percentiles) {
+    latency.percentiles.push_back(nSamples ? times[std::min(nSamples - 1, size_t(std::ceil(p / 100 * nSamples)) - (p > 0))] : 0);
+  }
+  return latency;
+}
+
+/** largest absolute difference of two score vectors and the number of scores that differ by more than tolerance */
+std::pair<double, size_t> compareScores(const std::vector<double>& a, const std::vector<double>& b, double tolerance)
+{
+  std::pair<double, size_t> result(0, 0);
+  for(size_t i = 0; i < a.size(); ++i) {
+    const double diff = std::abs(a[i] - b[i]);
+    if(!(diff <= tolerance)) ++result.second; // NaN in only one of them counts as disagreement
+    if(diff > result.first) result.first = diff;
+  }
+  return result;
+}
+
+#ifndef __CINT__
+/**
+ * main routine: enginebench [options] [-m tmvaweightfile] [-e tolerance] fbdtweightfile datafile
+ * -n: number of samples (the first rows of the data file), -m: TMVA weight file of the same FastBDT (needs -DWITH_TMVA),
+ * -e: largest allowed difference of the scores (default 1e-9)
+ */
+int main(int argc, char* argv[])
+{
+  BenchOptions options;
+  std::string tmvaWeightfile;
+  double tolerance = 1e-9;
+  int iArg = parseOptions(argc, argv, options, "m:e:", [&](int opt, const char* arg) {
+      if(opt == 'm') tmvaWeightfile = arg;
+      else tolerance = atof(arg);
+      return tolerance >= 0;
+    });
+  if(iArg < 0 || argc - iArg != 2) {
+    printUsage(argv[0], "[-m tmvaweightfile] [-e tolerance] fbdtweightfile datafile");
+    return 1;
+  }
+#ifndef WITH_TMVA
+  if(!tmvaWeightfile.empty()) {
+    std::cerr << "ERROR: TMVA support is not compiled in (-DWITH_TMVA)" << std::endl;
+    return 1;
+  }
+#endif
+
+  std::ifstream weights(argv[iArg]);
+  if(!weights) {
+    std::cerr << "ERROR: could not read " << argv[iArg] << std::endl;
+    return 1;
+  }
+  FBDT_Reader reader(weights);
+  std::vector<FeatureBinning<double> > featBins = reader.getFeatureBinnings();
+  const size_t nInputs = featBins.size();
+
+  // identical inputs for all engines
+  datfile::DatReader datreader(argv[iArg + 1]);
+  if(!datreader.good()) return 1;
+  const size_t nColumns = datreader.getNColumns();
+  if(nColumns < nInputs) {
+    std::cerr << "data file has only " << nColumns << " columns, but the FastBDT needs " << nInputs << std::endl;
+    return 1;
+  }
+  std::vector<double> values;
+  datreader.readRowsParallel(0, options.nSamples, values, 1);
+  const size_t nSamples = values.size() / nColumns;
+  const std::string transformfile = decorrelation::DecorrelationTransform::getSidecarName(argv[iArg]);
+  if(std::ifstream(transformfile.c_str())) {
+    decorrelation::DecorrelationTransform transform;
+    if(!transform.load(transformfile) || transform.getNDims() > nColumns) {
+      std::cerr << "ERROR: could not apply the decorrelation transform " << transformfile << std::endl;
+      return 1;
+    }
+    transform.apply(values.data(), nSamples, nColumns);
+  }
+  std::vector<float> samples(nSamples * nInputs);
+  for(size_t i = 0; i < nSamples; ++i) {
+    for(size_t j = 0; j < nInputs; ++j) samples[i * nInputs + j] = values[i * nColumns + j];
+  }
+  values.clear();
+  values.shrink_to_fit();
+  std::cout << nSamples << " samples with " << nInputs << " inputs from " << argv[iArg + 1] << std::endl;
+
+  std::vector<std::unique_ptr<Engine> > engines;
+  engines.push_back(std::unique_ptr<Engine>(new NativeEngine(reader.getFastBDT(), featBins)));
+#ifdef WITH_TMVA
+  if(!tmvaWeightfile.empty()) engines.push_back(std::unique_ptr<Engine>(new TMVAEngine(tmvaWeightfile, nInputs)));
+#endif
+
+  // throughput (and the scores for the agreement)
+  BenchRunner runner(options);
+  std::vector<std::vector<double> > scores(engines.size(), std::vector<double>(nSamples));
+  for(size_t e = 0; e < engines.size(); ++e) {
+    Engine& engine = *engines[e];
+    runner.run("engine/" + engine.getName() + "/batch", nSamples, "sample",
+               [&]() { engine.evaluateBatch(samples.data(), nSamples, nInputs, scores[e].data()); });
+    if(!runner.selected("engine/" + engine.getName() + "/batch")) {
+      engine.evaluateBatch(samples.data(), nSamples, nInputs, scores[e].data());
+    }
+  }
+
+  // latency
+  const double overhead = getClockOverhead();
+  std::cout << std::endl << "latency per sample [ns] (clock overhead of " << std::fixed << std::setprecision(1) << overhead
+            << " ns subtracted)" << std::endl << std::left << std::setw(12) << "engine" << std::right << std::setw(10) << "mean";
+  for(double p : c_percentiles) {
+    std::ostringstream label;
+    label << std::defaultfloat << "p" << p;
+    std::cout << std::setw(10) << (p < 100 ? label.str() : "max");
+  }
+  std::cout << std::endl;
+  for(const std::unique_ptr<Engine>& engine : engines) {
+    if(!runner.selected("engine/" + engine->getName() + "/latency")) continue;
+    Latency latency = measureLatency(*engine, samples, nSamples, nInputs, options.nWarmup, overhead);
+    std::cout << std::left << std::setw(12) << engine->getName() << std::right << std::setw(10) << latency.mean;
+    for(double t : latency.percentiles) std::cout << std::setw(10) << t;
+    std::cout << std::endl;
+  }
+
+  // agreement: with the first engine and between single and batch evaluation of every engine
+  bool agree = true;
+  std::cout << std::endl << "agreement (tolerance " << std::scientific << std::setprecision(1) << tolerance << ")" << std::endl
+            << std::left << std::setw(24) << "comparison" << std::right << std::setw(14) << "max |diff|" << std::setw(12) << "differ"
+            << std::endl;
+  for(size_t e = 0; e < engines.size(); ++e) {
+    std::vector<double> single(nSamples);
+    for(size_t i = 0; i < nSamples; ++i) single[i] = engines[e]->evaluate(&samples[i * nInputs]);
+    std::vector<std::pair<std::string, std::pair<double, size_t> > > comparisons;
+    comparisons.push_back(std::make_pair(engines[e]->getName() + " single/batch", compareScores(single, scores[e], tolerance)));
+    if(e > 0) {
+      comparisons.push_back(std::make_pair(engines[e]->getName() + "/" + engines[0]->getName(),
+                                           compareScores(scores[e], scores[0], tolerance)));
+    }
+    for(const auto& comparison : comparisons) {
+      std::cout << std::left << std::setw(24) << comparison.first << std::right << std::setw(14) << comparison.second.first
+                << std::setw(12) << comparison.second.second;
+      if(comparison.second.second) {
+        std::cout << "  DISAGREE";
+        agree = false;
+      }
+      std::cout << std::endl;
+    }
+  }
+  std::cout << std::defaultfloat;
+
+  const bool good = runner.finish();
+  return agree && good ? 0 : 1;
+}
+#endif
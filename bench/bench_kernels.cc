@@ -0,0 +1,292 @@
+// microbenchmarks of the hot kernels of the .dat / FastBDT tools (no ROOT needed):
+//   - parsing of .dat files (datfile::parseLine, DatIndex::build, DatReader)
+//   - formatting of the output values (datformat vs. std::ostream)
+//   - FastBDT: FeatureBinning::ValueToBin, EventSample construction, Forest::Analyse for several depths and numbers of trees
+// All kernels work on synthetic samples (9 inputs + truth, see generateSamples), such that the results are reproducible.
+// See bench.h for the common options (e.g. -o results.json to save the results and -b baseline.json to compare with them)
+
+#include "FBDT.h"
+#include "FBDT_Reader.h"
+#include "FBDT_Writer.h"
+
+#include "bench.h"
+#include "../datformat.h"
+#include "../datreader.h"
+#include "../parallel_helper.h"
+#include "../nn_inference.h"
+#include "../decorrelation.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+
+// mkstemp
+#include <unistd.h>
+#include <stdlib.h>
+
+using namespace FastBDT;
+using namespace bench;
+
+/** number of inputs of the samples (same as in the ThreeHitSamples) */
+const size_t nInputs = 9;
+
+/** number of levels of the FeatureBinnings (same as in fbdt-train) */
+const unsigned nLevels = 8;
+
+/**
+ * generate nSamples synthetic samples (row-major, nInputs values + truth per row).
+ * The inputs are normal distributed, the truth depends on some of them (with noise), such that the trained forests are not trivial
+ */
+std::vector<double> generateSamples(size_t nSamples)
+{
+  uint64_t state = 88172645463325252ULL;
+  auto uniform = [&state]() {
+    state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+    return (state >> 11) * (1.0 / 9007199254740992.0);
+  };
+  auto normal = [&uniform]() { return std::sqrt(-2 * std::log(1 - uniform())) * std::cos(2 * M_PI * uniform()); };
+
+  std::vector<double> samples(nSamples * (nInputs + 1));
+  for(size_t iS = 0; iS < nSamples; ++iS) {
+    double* row = &samples[iS * (nInputs + 1)];
+    for(size_t i = 0; i < nInputs; ++i) row[i] = normal();
+    row[nInputs] = row[0] + 0.5 * row[1] - 0.3 * row[2] * row[3] + 0.5 * normal() > 0;
+  }
+  return samples;
+}
+
+/** format the samples as .dat file contents (same format as root2dat) */
+std::string formatSamples(const std::vector<double>& samples)
+{
+  std::string text;
+  for(size_t i = 0; i < samples.size(); ++i) {
+    datformat::appendValue(text, samples[i]);
+    text.push_back((i + 1) % (nInputs + 1) ? ' ' : '\n');
+  }
+  return text;
+}
+
+/** write text to a temporary file. @returns its name (empty if it could not be written) */
+std::string writeTemporaryFile(const std::string& text)
+{
+  const char* tmpdir = getenv("TMPDIR");
+  std::string name = std::string(tmpdir ? tmpdir : "/tmp") + "/kernelbench_XXXXXX";
+  std::vector<char> buffer(name.begin(), name.end());
+  buffer.push_back(0);
+  int fd = mkstemp(buffer.data());
+  if(fd < 0) return "";
+  bool good = write(fd, text.data(), text.size()) == ssize_t(text.size());
+  close(fd);
+  if(!good) {
+    unlink(buffer.data());
+    return "";
+  }
+  return std::string(buffer.data());
+}
+
+/**
+ * train a forest on the first nTrain samples (bins and truth) and convert it to a Forest (via the xml format, as fbdt-train and
+ * fbdt-eval do). A new EventSample is used for every forest, since the training changes its weights
+ */
+Forest trainForest(const std::vector<std::vector<unsigned> >& bins, const std::vector<double>& samples, size_t nTrain,
+                   const std::vector<FeatureBinning<double> >& featBins, unsigned nTrees, unsigned depth)
+{
+  EventSample eventSample(nTrain, nInputs, nLevels);
+  for(size_t iS = 0; iS < nTrain; ++iS) eventSample.AddEvent(bins[iS], 1.0, samples[iS * (nInputs + 1) + nInputs] > 0.5);
+  ForestBuilder builder(eventSample, nTrees, 0.15, 0.5, depth);
+  std::stringstream xml;
+  FBDT_Writer writer(xml);
+  writer.writeToFile(builder, featBins);
+  FBDT_Reader reader(xml);
+  return reader.getFastBDT();
+}
+
+/**
+ * generate the text of a net (format of export_net.m) with nInputs inputs, one hidden layer with nHidden tansig neurons and one
+ * logsig output (random weights, identity input and output processing)
+ */
+std::string generateNet(size_t nHidden)
+{
+  uint64_t state = 2463534242ULL;
+  auto weight = [&state]() {
+    state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+    return (state >> 11) * (2.0 / 9007199254740992.0) - 1;
+  };
+  std::ostringstream net;
+  net << "# nn-net 2\n# inputs " << nInputs << " " << nInputs << "\n";
+  for(size_t i = 0; i < nInputs; ++i) net << i << (i + 1 < nInputs ? " " : "\n");
+  for(size_t i = 0; i < nInputs; ++i) net << 0 << (i + 1 < nInputs ? " " : "\n");
+  for(size_t i = 0; i < nInputs; ++i) net << 1 << (i + 1 < nInputs ? " " : "\n");
+  net << "0\n# layer " << nHidden << " " << nInputs << " tansig\n";
+  for(size_t o = 0; o < nHidden; ++o) {
+    for(size_t i = 0; i < nInputs; ++i) net << weight() << (i + 1 < nInputs ? " " : "\n");
+  }
+  for(size_t o = 0; o < nHidden; ++o) net << weight() << (o + 1 < nHidden ? " " : "\n");
+  net << "# layer 1 " << nHidden << " logsig\n";
+  for(size_t i = 0; i < nHidden; ++i) net << weight() << (i + 1 < nHidden ? " " : "\n");
+  net << weight() << "\n# outputs 1\n0\n1\n0\n";
+  return net.str();
+}
+
+#ifndef __CINT__
+/**
+ * main routine: see bench.h for the options
+ */
+int main(int argc, char* argv[])
+{
+  BenchOptions options;
+  if(parseOptions(argc, argv, options) < 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  const size_t nSamples = options.nSamples;
+  const size_t nColumns = nInputs + 1;
+  std::cout << "generating " << nSamples << " samples ... " << std::flush;
+  const std::vector<double> samples = generateSamples(nSamples);
+  const std::string text = formatSamples(samples);
+  std::cout << "DONE. (" << text.size() / 1e6 << " MB as .dat)" << std::endl << std::endl;
+
+  BenchRunner runner(options);
+
+  // ===================================================== .DAT PARSING ==========================================================
+  std::vector<double> values(samples.size());
+  runner.run("dat/parseLine", nSamples, "row", [&]() {
+      const char* begin = text.data();
+      const char* textEnd = begin + text.size();
+      double* row = values.data();
+      while(begin < textEnd) {
+        const char* end = std::find(begin, textEnd, '\n');
+        row += datfile::parseLine(begin, end, row, nColumns);
+        begin = end + 1;
+      }
+      doNotOptimize(values);
+    });
+
+  const std::string datname = writeTemporaryFile(text);
+  if(datname.empty()) {
+    std::cerr << "ERROR: could not write temporary .dat file, skipping the file based benchmarks" << std::endl;
+  } else {
+    runner.run("dat/DatIndex::build", nSamples, "row", [&]() {
+        datfile::DatIndex index;
+        index.build(datname);
+        doNotOptimize(index);
+      });
+
+    datfile::DatReader reader(datname);
+    if(reader.good()) {
+      runner.run("dat/DatReader::readRows", nSamples, "row", [&]() {
+          reader.readRows(0, reader.getNRows(), values.data());
+          doNotOptimize(values);
+        });
+      const unsigned nThreads = parallel::getNThreads();
+      runner.run("dat/DatReader::readRowsParallel (" + std::to_string(nThreads) + " threads)", nSamples, "row", [&]() {
+          std::vector<double> parallelValues;
+          reader.readRowsParallel(0, reader.getNRows(), parallelValues, nThreads);
+          doNotOptimize(parallelValues);
+        });
+    }
+    unlink(datname.c_str());
+    unlink(datfile::DatIndex::getSidecarName(datname).c_str());
+  }
+
+  // ====================================================== FORMATTING ===========================================================
+  std::string formatted;
+  formatted.reserve(2 * text.size());
+  runner.run("format/datformat::appendValue", samples.size(), "value", [&]() {
+      for(double value : samples) {
+        datformat::appendValue(formatted, value);
+        formatted.push_back(' ');
+      }
+      doNotOptimize(formatted);
+    }, [&]() { formatted.clear(); });
+
+  runner.run("format/datformat::appendRoundtrip", samples.size(), "value", [&]() {
+      for(double value : samples) {
+        datformat::appendRoundtrip(formatted, value);
+        formatted.push_back(' ');
+      }
+      doNotOptimize(formatted);
+    }, [&]() { formatted.clear(); });
+
+  runner.run("format/std::ostream", samples.size(), "value", [&]() {
+      std::ostringstream os;
+      for(double value : samples) os << value << ' ';
+      doNotOptimize(os);
+    });
+
+  // ======================================================= FASTBDT =============================================================
+  std::vector<FeatureBinning<double> > featBins;
+  for(size_t i = 0; i < nInputs; ++i) {
+    std::vector<double> feature(nSamples);
+    for(size_t iS = 0; iS < nSamples; ++iS) feature[iS] = samples[iS * nColumns + i];
+    featBins.push_back(FeatureBinning<double>(nLevels, feature.begin(), feature.end()));
+  }
+
+  std::vector<std::vector<unsigned> > bins(nSamples, std::vector<unsigned>(nInputs));
+  runner.run("fbdt/FeatureBinning::ValueToBin", nSamples * nInputs, "value", [&]() {
+      for(size_t iS = 0; iS < nSamples; ++iS) {
+        for(size_t i = 0; i < nInputs; ++i) bins[iS][i] = featBins[i].ValueToBin(samples[iS * nColumns + i]);
+      }
+      doNotOptimize(bins);
+    });
+
+  runner.run("fbdt/EventSample", nSamples, "sample", [&]() {
+      EventSample eventSample(nSamples, nInputs, nLevels);
+      for(size_t iS = 0; iS < nSamples; ++iS) eventSample.AddEvent(bins[iS], 1.0, samples[iS * nColumns + nInputs] > 0.5);
+      doNotOptimize(eventSample);
+    });
+
+  // the forests are trained on (at most) 20000 samples, the training itself is not benchmarked here (see fbdt-train with TT_PERF)
+  const size_t nTrain = std::min<size_t>(nSamples, 20000);
+
+  const unsigned depths[] = {2, 3, 5};
+  const unsigned nTreess[] = {10, 100, 500};
+  std::vector<double> outputs(nSamples);
+  for(unsigned depth : depths) {
+    for(unsigned nTrees : nTreess) {
+      std::string name = "fbdt/Forest::Analyse (depth " + std::to_string(depth) + ", " + std::to_string(nTrees) + " trees)";
+      if(!runner.selected(name)) continue;
+      Forest forest = trainForest(bins, samples, nTrain, featBins, nTrees, depth);
+      runner.run(name, nSamples, "sample", [&]() {
+          for(size_t iS = 0; iS < nSamples; ++iS) outputs[iS] = forest.Analyse(bins[iS]);
+          doNotOptimize(outputs);
+        });
+    }
+  }
+
+  // ============================================== NETS AND DECORRELATION ======================================================
+  const size_t nHiddens[] = {10, 50, 200};
+  for(size_t nHidden : nHiddens) {
+    std::string name = "nn/Net::evaluate (" + std::to_string(nHidden) + " hidden)";
+    if(!runner.selected(name)) continue;
+    const std::string netfile = writeTemporaryFile(generateNet(nHidden));
+    nn::Net net;
+    const bool loaded = !netfile.empty() && net.load(netfile);
+    if(!netfile.empty()) unlink(netfile.c_str());
+    if(!loaded) continue;
+    runner.run(name, nSamples, "sample", [&]() {
+        nn::Workspace workspace;
+        for(size_t begin = 0; begin < nSamples; begin += 256) {
+          net.evaluate(&samples[begin * nColumns], std::min<size_t>(256, nSamples - begin), nColumns, &outputs[begin], workspace);
+        }
+        doNotOptimize(outputs);
+      });
+  }
+
+  decorrelation::DecorrelationTransform transform;
+  transform.compute(decorrelation::computeCovariance(samples.data(), nSamples, nColumns, nInputs, 1));
+  runner.run("decorrelation/computeCovariance", nSamples, "sample", [&]() {
+      decorrelation::CovarianceAccumulator accumulator = decorrelation::computeCovariance(samples.data(), nSamples, nColumns, nInputs, 1);
+      doNotOptimize(accumulator);
+    });
+  runner.run("decorrelation/DecorrelationTransform::apply", nSamples, "sample", [&]() {
+      transform.apply(values.data(), nSamples, nColumns);
+      doNotOptimize(values);
+    }, [&]() { std::copy(samples.begin(), samples.end(), values.begin()); }); // in place -> fresh input for every repetition
+
+  return runner.finish() ? 0 : 1;
+}
+#endif
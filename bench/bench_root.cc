@@ -0,0 +1,92 @@
+// microbenchmarks of reading ROOT files with the RootToolBox: RootBranchData::addEvent (event by event), readEvents (chunk-wise,
+// as RootChunkReader does) and fetchChunk (all events at once, as RootFileData::fetchData does) for every branch of the passed files.
+// The files are not generated here, use e.g. dat2root on the output of root2dat (and its -s / -c options to compare layouts).
+// See bench.h for the common options (e.g. -o results.json to save the results and -b baseline.json to compare with them)
+
+// stl
+#include <iostream>
+#include <string>
+#include <vector>
+
+// ROOT toolbox
+#include "../RootToolBox/RootFile.hpp"
+#include "../RootToolBox/RootTree.hpp"
+#include "../RootToolBox/RootBranchData.hpp"
+#include "../RootToolBox/toolboxhelper.hpp"
+
+#include "bench.h"
+
+using namespace RootToolBox;
+using namespace bench;
+
+/** number of events that are read at once by readEvents (same as in tmva_evaluation) */
+const int chunkSize = 1000;
+
+/** run the benchmarks for the branch @param name of the tree with the data type T */
+template<typename T>
+void benchBranch(BenchRunner& runner, TTree* tree, std::string prefix, std::string name)
+{
+  const int nEvents = tree->GetEntries();
+  runner.run(prefix + name + "/addEvent", nEvents, "event", [&]() {
+      RootBranchData<T> branchdata(name, tree);
+      for(int i = 0; i < nEvents; ++i) branchdata.addEvent(i);
+      doNotOptimize(branchdata.getData());
+    });
+
+  runner.run(prefix + name + "/readEvents", nEvents, "event", [&]() {
+      RootBranchData<T> branchdata(name, tree);
+      std::vector<T> values;
+      std::vector<size_t> nValues;
+      for(int i = 0; i < nEvents; i += chunkSize) {
+        values.clear();
+        nValues.clear();
+        branchdata.readEvents(i, std::min(i + chunkSize, nEvents), values, nValues);
+        doNotOptimize(values);
+      }
+    });
+
+  runner.run(prefix + name + "/fetchChunk", nEvents, "event", [&]() {
+      RootBranchData<T> branchdata(name, tree);
+      branchdata.prepareChunks(1);
+      branchdata.fetchChunk(tree, 0, 0, nEvents);
+      branchdata.mergeChunks();
+      doNotOptimize(branchdata.getData());
+    });
+}
+
+#ifndef __CINT__
+/**
+ * main routine: arguments are the root files (see bench.h for the options)
+ */
+int main(int argc, char* argv[])
+{
+  BenchOptions options;
+  int iArg = parseOptions(argc, argv, options);
+  if(iArg < 0 || iArg >= argc) {
+    printUsage(argv[0], "rootfile [rootfile ...]");
+    return 1;
+  }
+
+  BenchRunner runner(options);
+  for(; iArg < argc; ++iArg) {
+    RootFile file(argv[iArg]);
+    if(file.getFilePtr() == 0) return 1;
+    for(size_t iTree = 0; iTree < file.getNTrees(); ++iTree) {
+      TTree* tree = file.getTree((int) iTree).getTreePtr();
+      if(tree == 0) continue;
+      const std::string prefix = std::string("root/") + argv[iArg] + "/" + tree->GetName() + "/";
+      for(const std::string& name : getBranchNames(tree)) {
+        switch(getBranchDataType(tree, name)) {
+        case c_double: benchBranch<double>(runner, tree, prefix, name); break;
+        case c_int: benchBranch<int>(runner, tree, prefix, name); break;
+        case c_uint: benchBranch<unsigned int>(runner, tree, prefix, name); break;
+        case c_usint: benchBranch<unsigned short int>(runner, tree, prefix, name); break;
+        default: std::cout << "skipping branch " << name << " (unsupported data type)" << std::endl; break;
+        }
+      }
+    }
+  }
+
+  return runner.finish() ? 0 : 1;
+}
+#endif
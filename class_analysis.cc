@@ -0,0 +1,267 @@
+// one-pass analysis of the outputs of (any number of) classifiers: efficiency, signal to noise ratio (SNR) and ROC
+// (replaces calculate_cut.m, calc_snr.m, calculate_snr_at_eff.m and the calculations of analyze_class_out.m)
+//
+// The truth and the scores are streamed once (chunk-wise, reading and histogramming in parallel) into fine grained histograms,
+// from which all figures of merit are derived. Cuts are therefore only as fine as the binning (see -b, -l, -u).
+// All samples with score >= cut are classified as signal, samples with truth > 0 are signal (i.e. 0 and -1 are both background).
+//
+// by Thomas Madlener, 2015
+
+#include "classanalysis.h"
+#include "datreader.h"
+#include "vxdfilter.h"
+#include "datformat.h"
+#include "parallel_helper.h"
+#include "tt_timer.h"
+#include "tt_profiler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// getopt
+#include <unistd.h>
+
+using namespace classanalysis;
+using namespace timing;
+
+/** number of rows that are read (and histogrammed) at once */
+const uint64_t chunkRows = 1 << 20;
+
+/** maximum memory for the copies of the histograms that are filled in parallel (there is always at least one copy) */
+const size_t maxHistBytes = size_t(1) << 30;
+
+/** get the name of a score file (basename without extension) */
+std::string getFileName(std::string filename)
+{
+  size_t slash = filename.rfind('/');
+  if(slash != std::string::npos) filename = filename.substr(slash + 1);
+  size_t dot = filename.rfind('.');
+  if(dot != std::string::npos && dot > 0) filename = filename.substr(0, dot);
+  return filename;
+}
+
+/**
+ * get the names of the classifiers in the score files @param filenames (with nColumns[i] columns each): the name of the file and
+ * the column (if there is more than one). Files with the same name (e.g. from different directories) get their argument index
+ * appended (e.g. fbdt_2, fbdt_3), such that the names (and the curve files) are unique
+ */
+std::vector<std::string> getClassifierNames(const std::vector<std::string>& filenames, const std::vector<size_t>& nColumns,
+                                            size_t firstArg)
+{
+  std::vector<std::string> fileNames;
+  for(const std::string& filename : filenames) fileNames.push_back(getFileName(filename));
+
+  std::vector<std::string> names;
+  for(size_t f = 0; f < filenames.size(); ++f) {
+    std::string name = fileNames[f];
+    if(std::count(fileNames.begin(), fileNames.end(), name) > 1) name += "_" + std::to_string(firstArg + f);
+    for(size_t c = 0; c < nColumns[f]; ++c) names.push_back(nColumns[f] > 1 ? name + "_" + std::to_string(c) : name);
+  }
+  return names;
+}
+
+/**
+ * write the curves of one classifier (nPoints equally spaced cuts from the lower to the upper edge of the histogram) to a .dat file.
+ * Columns: cut, efficiency, false positive rate (-> ROC), SNR, SNR gain (SNR / input SNR)
+ */
+bool writeCurves(std::string filename, const ScoreHistogram& hist, size_t nPoints)
+{
+  std::ofstream outfile(filename.c_str());
+  if(!outfile) {
+    std::cerr << "ERROR: could not open " << filename << std::endl;
+    return false;
+  }
+  outfile << "# cut efficiency fpr snr snr_gain" << std::endl;
+  std::string line;
+  for(size_t i = 0; i < nPoints; ++i) {
+    const size_t iBin = nPoints > 1 ? 1 + i * hist.getNBins() / (nPoints - 1) : 1;
+    CutPoint point = hist.getPoint(iBin);
+    line.clear();
+    datformat::appendValue(line, point.cut); line.push_back(' ');
+    datformat::appendValue(line, point.efficiency); line.push_back(' ');
+    datformat::appendValue(line, point.fpr); line.push_back(' ');
+    datformat::appendValue(line, point.snr); line.push_back(' ');
+    datformat::appendValue(line, point.snr / hist.getInputSNR()); line.push_back('\n');
+    outfile << line;
+  }
+  return true;
+}
+
+#ifndef __CINT__
+/**
+ * usage: classanalysis [-j nThreads] [-b nBins] [-l lower] [-u upper] [-e efficiency] [-p nPoints] [-t column] [-V filter]
+ *                      [-o prefix] truthfile scorefile [scorefile ...]
+ * truthfile: .dat file with the truth in the last column (e.g. the data file that was evaluated) or in column -t
+ * scorefile: output of a classifier (e.g. from fbdt-eval or evaltmva), one row per sample. Every column is a classifier
+ * -b: number of bins of the histograms between -l and -u (defaults: 200000, -1, 1)
+ * -e: efficiency for which the cut is determined (can be given several times, default 0.99)
+ * -V: use only the samples that pass filter (0-9, see RootToolBox::passVXDFilter), needs the VXD filter index (truthfile.vxd)
+ * -o: write the curves of every classifier to prefix_name.dat (-p points, default 300). Score files with the same name (from different
+ *     directories) are told apart by their argument index (e.g. prefix_fbdt_2.dat, prefix_fbdt_3.dat)
+ */
+int main(int argc, char* argv[])
+{
+  unsigned nThreads = 0;
+  size_t nBins = 200000;
+  double lower = -1, upper = 1;
+  std::vector<double> efficiencies;
+  size_t nPoints = 300;
+  int truthColumn = -1;
+  int vxdFilter = -1;
+  std::string prefix;
+  int opt;
+  while((opt = getopt(argc, argv, "j:b:l:u:e:p:t:V:o:")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = atoi(optarg); break;
+    case 'b': nBins = std::max(1L, atol(optarg)); break;
+    case 'l': lower = atof(optarg); break;
+    case 'u': upper = atof(optarg); break;
+    case 'e': efficiencies.push_back(atof(optarg)); break;
+    case 'p': nPoints = std::max(2L, atol(optarg)); break;
+    case 't': truthColumn = atoi(optarg); break;
+    case 'V': vxdFilter = atoi(optarg); break;
+    case 'o': prefix = optarg; break;
+    default:
+      std::cerr << "usage: " << argv[0] << " [-j nThreads] [-b nBins] [-l lower] [-u upper] [-e efficiency] [-p nPoints] [-t column]"
+                << " [-V filter] [-o prefix] truthfile scorefile [scorefile ...]" << std::endl;
+      return 1;
+    }
+  }
+  if(argc - optind < 2) {
+    std::cerr << "need a truth file and at least one score file" << std::endl;
+    return 1;
+  }
+  if(!(upper > lower)) {
+    std::cerr << "the upper edge of the histograms has to be above the lower edge" << std::endl;
+    return 1;
+  }
+  if(vxdFilter >= int(RootToolBox::c_nVXDFilters)) {
+    std::cerr << "invalid VXD filter " << vxdFilter << " (expected 0 to " << RootToolBox::c_nVXDFilters - 1 << ")" << std::endl;
+    return 1;
+  }
+  if(efficiencies.empty()) efficiencies.push_back(0.99);
+  nThreads = parallel::getNThreads(nThreads);
+
+  TT_PROFILE_SCOPE("classanalysis");
+  datfile::DatReader truthReader(argv[optind]);
+  if(!truthReader.good()) return 1;
+  const size_t nTruthColumns = truthReader.getNColumns();
+  if(truthColumn < 0) truthColumn = nTruthColumns - 1;
+  if(size_t(truthColumn) >= nTruthColumns) {
+    std::cerr << "truth file has only " << nTruthColumns << " columns" << std::endl;
+    return 1;
+  }
+  const uint64_t nRows = truthReader.getNRows();
+  RootToolBox::VXDFilterIndex vxdIndex;
+  if(vxdFilter >= 0 && !datfile::loadVXDFilterIndex(argv[optind], nRows, vxdIndex)) return 1;
+
+  std::vector<std::unique_ptr<datfile::DatReader> > scoreReaders;
+  std::vector<size_t> scoreColumns; // number of columns of every score file
+  std::vector<std::pair<size_t, size_t> > classifierColumns; // file and column of every classifier
+  for(int i = optind + 1; i < argc; ++i) {
+    scoreReaders.push_back(std::unique_ptr<datfile::DatReader>(new datfile::DatReader(argv[i])));
+    const datfile::DatReader& reader = *scoreReaders.back();
+    if(!reader.good()) return 1;
+    if(reader.getNRows() != nRows) {
+      std::cerr << "ERROR: " << argv[i] << " has " << reader.getNRows() << " rows, but the truth file has " << nRows << std::endl;
+      return 1;
+    }
+    scoreColumns.push_back(reader.getNColumns());
+    for(size_t c = 0; c < reader.getNColumns(); ++c) classifierColumns.push_back(std::make_pair(scoreReaders.size() - 1, c));
+  }
+  const std::vector<std::string> names = getClassifierNames(std::vector<std::string>(argv + optind + 1, argv + argc), scoreColumns,
+                                                            optind + 1);
+  const size_t nClassifiers = names.size();
+
+  // the threads are split into nGroups groups of classifiers (every group is filled by one thread), and into nCopies ranges of rows
+  // (every range has its own copy of the histograms, merged at the end). Only as many copies as needed to keep all threads busy
+  // (and fitting into maxHistBytes) are made, such that the memory does not grow with nThreads * nClassifiers
+  const size_t histBytes = nClassifiers * (nBins + 2) * 2 * sizeof(uint64_t);
+  const size_t nCopies = std::max<size_t>(1, std::min<size_t>((nThreads + nClassifiers - 1) / nClassifiers, maxHistBytes / histBytes));
+  const size_t nGroups = std::max<size_t>(1, std::min<size_t>(nClassifiers, nThreads / nCopies));
+  std::vector<std::vector<ScoreHistogram> > copyHists(nCopies, std::vector<ScoreHistogram>(nClassifiers, ScoreHistogram(nBins, lower, upper)));
+  std::vector<uint64_t> taskNaNs(nCopies * nGroups, 0);
+
+  TicTocTimer timer(1000000); // want ms
+  std::cout << "reading and histogramming " << nRows << " samples of " << nClassifiers << " classifiers ... " << std::flush;
+  ScopedTimer histScope("histogram");
+  std::vector<double> truth;
+  std::vector<std::vector<double> > scores(scoreReaders.size());
+  for(uint64_t rowBegin = 0; rowBegin < nRows; rowBegin += chunkRows) {
+    const uint64_t rowEnd = std::min(nRows, rowBegin + chunkRows);
+    truthReader.readRowsParallel(rowBegin, rowEnd, truth, nThreads);
+    for(size_t f = 0; f < scoreReaders.size(); ++f) scoreReaders[f]->readRowsParallel(rowBegin, rowEnd, scores[f], nThreads);
+
+    const size_t nChunkRows = rowEnd - rowBegin;
+    parallel::parallelForEach(nCopies * nGroups, nCopies * nGroups, [&](size_t iTask, unsigned) {
+        const size_t iCopy = iTask / nGroups, iGroup = iTask % nGroups;
+        const size_t firstRow = nChunkRows * iCopy / nCopies, lastRow = nChunkRows * (iCopy + 1) / nCopies;
+        const size_t firstClass = nClassifiers * iGroup / nGroups, lastClass = nClassifiers * (iGroup + 1) / nGroups;
+        std::vector<ScoreHistogram>& hists = copyHists[iCopy];
+        uint64_t nNaN = 0;
+        for(size_t iRow = firstRow; iRow < lastRow; ++iRow) {
+          if(vxdFilter >= 0 && !vxdIndex.test(vxdFilter, rowBegin + iRow)) continue;
+          const double target = truth[iRow * nTruthColumns + truthColumn];
+          if(target != target) { nNaN += iGroup == 0; continue; } // count the rows without truth only once
+          const bool signal = target > 0;
+          for(size_t iClass = firstClass; iClass < lastClass; ++iClass) {
+            const size_t f = classifierColumns[iClass].first;
+            const double score = scores[f][iRow * scoreColumns[f] + classifierColumns[iClass].second];
+            if(score != score) nNaN++;
+            else hists[iClass].fill(score, signal);
+          }
+        }
+        taskNaNs[iTask] += nNaN;
+      });
+  }
+
+  std::vector<ScoreHistogram> hists(copyHists[0]);
+  for(size_t t = 1; t < nCopies; ++t) {
+    for(size_t i = 0; i < nClassifiers; ++i) hists[i].add(copyHists[t][i]);
+  }
+  for(ScoreHistogram& hist : hists) hist.finalize();
+  uint64_t nNaN = 0;
+  for(uint64_t n : taskNaNs) nNaN += n;
+  histScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+  if(nNaN) std::cerr << "WARNING: skipped " << nNaN << " values that could not be read (NaN)" << std::endl;
+
+  // summary
+  std::cout << std::endl << std::left << std::setw(24) << "classifier" << std::right << std::setw(12) << "nSignal"
+            << std::setw(12) << "nBackground" << std::setw(12) << "SNR_in" << std::setw(10) << "AUC" << std::setw(10) << "eff"
+            << std::setw(14) << "cut" << std::setw(12) << "SNR_out" << std::setw(12) << "SNR gain" << std::setw(12) << "bg eff" << std::endl;
+  std::ios::fmtflags flags = std::cout.flags();
+  for(size_t i = 0; i < nClassifiers; ++i) {
+    const ScoreHistogram& hist = hists[i];
+    for(size_t e = 0; e < efficiencies.size(); ++e) {
+      CutPoint point = hist.getCutForEfficiency(efficiencies[e]);
+      if(e == 0) {
+        std::cout << std::left << std::setw(24) << names[i] << std::right << std::setw(12) << hist.getNSignal()
+                  << std::setw(12) << hist.getNBackground() << std::setprecision(4) << std::setw(12) << hist.getInputSNR()
+                  << std::fixed << std::setw(10) << hist.getAUC();
+      } else {
+        std::cout << std::setw(70) << "";
+      }
+      std::cout << std::fixed << std::setprecision(4) << std::setw(10) << point.efficiency << std::setprecision(6) << std::setw(14)
+                << point.cut << std::setprecision(4) << std::setw(12) << point.snr << std::setw(12) << point.snr / hist.getInputSNR()
+                << std::setprecision(6) << std::setw(12) << point.fpr << std::endl;
+      std::cout.flags(flags);
+    }
+  }
+
+  if(!prefix.empty()) {
+    for(size_t i = 0; i < nClassifiers; ++i) {
+      std::string filename = prefix + "_" + names[i] + ".dat";
+      if(!writeCurves(filename, hists[i], nPoints)) return 1;
+      std::cout << "wrote curves of " << names[i] << " to " << filename << std::endl;
+    }
+  }
+
+  return 0;
+}
+#endif
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+namespace classanalysis {
+
+  /**
+   * figures of merit of a classifier for one cut (all samples with score >= cut are classified as signal).
+   * Same definitions as in analyze_class_out.m: efficiency = passing signal / all signal, snr = passing signal / passing background
+   */
+  struct CutPoint {
+    double cut; /**< the cut value */
+    uint64_t nSignal; /**< number of signal samples passing the cut */
+    uint64_t nBackground; /**< number of background samples passing the cut */
+    double efficiency; /**< signal efficiency (true positive rate) */
+    double fpr; /**< background efficiency (false positive rate) */
+    double snr; /**< signal to noise ratio after the cut (inf if no background passes) */
+
+    CutPoint() : cut(0), nSignal(0), nBackground(0), efficiency(0), fpr(0), snr(0) {}
+  };
+
+  /**
+   * fine grained histogram of the scores of one classifier, separately for signal and background.
+   * There is one underflow bin (0) and one overflow bin (nBins + 1), such that all samples are counted and the figures of merit at
+   * every bin edge are exact (the cut is only as fine as the binning). Histograms filled by different threads can be merged with add.
+   * usage:
+   *   ScoreHistogram hist(200000, -1, 1);
+   *   hist.fill(score, target > 0); // for every sample
+   *   hist.finalize();
+   *   CutPoint point = hist.getCutForEfficiency(0.99);
+   */
+  class ScoreHistogram {
+  public:
+    ScoreHistogram(size_t nBins = 0, double lower = -1, double upper = 1) :
+      m_nBins(nBins), m_lower(lower), m_upper(upper), m_scale(upper > lower ? nBins / (upper - lower) : 0),
+      m_signal(nBins + 2, 0), m_background(nBins + 2, 0) {}
+
+    /** get the bin of a score (not NaN) */
+    size_t getBin(double score) const
+    {
+      if(score < m_lower) return 0;
+      if(score >= m_upper) return m_nBins + 1;
+      return std::min(m_nBins, size_t((score - m_lower) * m_scale) + 1);
+    }
+
+    /** add one sample */
+    void fill(double score, bool signal) { (signal ? m_signal : m_background)[getBin(score)]++; }
+
+    /** add the contents of another histogram (with the same binning) */
+    void add(const ScoreHistogram& other);
+
+    /** compute the numbers of samples above the bin edges (has to be called after filling and before any of the getters below) */
+    void finalize();
+
+    uint64_t getNSignal() const { return m_signalAbove.empty() ? 0 : m_signalAbove[0]; } /**< total number of signal samples */
+
+    uint64_t getNBackground() const { return m_backgroundAbove.empty() ? 0 : m_backgroundAbove[0]; } /**< total number of background samples */
+
+    /** signal to noise ratio without cut (1 if there is no background, as in calc_snr.m) */
+    double getInputSNR() const { return getNBackground() ? double(getNSignal()) / getNBackground() : 1; }
+
+    size_t getNBins() const { return m_nBins; } /**< number of bins (without under- and overflow) */
+
+    /** get the lower edge of bin iBin (-inf for the underflow bin) */
+    double getLowEdge(size_t iBin) const
+    {
+      if(iBin == 0) return -std::numeric_limits<double>::infinity();
+      return m_lower + (iBin - 1) / m_scale;
+    }
+
+    /** get the figures of merit for the cut at the lower edge of bin iBin */
+    CutPoint getPoint(size_t iBin) const;
+
+    /**
+     * get the (highest) cut at a bin edge with an efficiency of at least @param efficiency, i.e. the histogram quantile equivalent of
+     * calculate_cut.m (which takes the ceil(nSignal * efficiency)-th highest signal score as cut)
+     */
+    CutPoint getCutForEfficiency(double efficiency) const;
+
+    /** get the area under the ROC curve (trapezoidal rule over all bin edges) */
+    double getAUC() const;
+
+  private:
+    size_t m_nBins; /**< number of bins */
+    double m_lower; /**< lower edge of the first bin */
+    double m_upper; /**< upper edge of the last bin */
+    double m_scale; /**< bins per unit of the score */
+    std::vector<uint64_t> m_signal; /**< signal counts per bin */
+    std::vector<uint64_t> m_background; /**< background counts per bin */
+    std::vector<uint64_t> m_signalAbove; /**< number of signal samples in this and all higher bins */
+    std::vector<uint64_t> m_backgroundAbove; /**< number of background samples in this and all higher bins */
+  };
+
+  inline void ScoreHistogram::add(const ScoreHistogram& other)
+  {
+    for(size_t i = 0; i < m_signal.size() && i < other.m_signal.size(); ++i) {
+      m_signal[i] += other.m_signal[i];
+      m_background[i] += other.m_background[i];
+    }
+  }
+
+  inline void ScoreHistogram::finalize()
+  {
+    m_signalAbove.assign(m_signal.size() + 1, 0);
+    m_backgroundAbove.assign(m_background.size() + 1, 0);
+    for(size_t i = m_signal.size(); i-- > 0; ) {
+      m_signalAbove[i] = m_signalAbove[i + 1] + m_signal[i];
+      m_backgroundAbove[i] = m_backgroundAbove[i + 1] + m_background[i];
+    }
+  }
+
+  inline CutPoint ScoreHistogram::getPoint(size_t iBin) const
+  {
+    CutPoint point;
+    iBin = std::min(iBin, m_nBins + 1);
+    point.cut = getLowEdge(iBin);
+    point.nSignal = m_signalAbove[iBin];
+    point.nBackground = m_backgroundAbove[iBin];
+    point.efficiency = getNSignal() ? double(point.nSignal) / getNSignal() : 0;
+    point.fpr = getNBackground() ? double(point.nBackground) / getNBackground() : 0;
+    point.snr = point.nBackground ? double(point.nSignal) / point.nBackground : std::numeric_limits<double>::infinity();
+    return point;
+  }
+
+  inline CutPoint ScoreHistogram::getCutForEfficiency(double efficiency) const
+  {
+    const uint64_t nRequired = std::ceil(getNSignal() * efficiency);
+    // m_signalAbove is decreasing -> find the last bin that still has enough signal above its lower edge
+    size_t iBin = 0;
+    for(size_t step = size_t(1) << 62; step > 0; step >>= 1) {
+      if(iBin + step <= m_nBins + 1 && m_signalAbove[iBin + step] >= nRequired) iBin += step;
+    }
+    return getPoint(iBin);
+  }
+
+  inline double ScoreHistogram::getAUC() const
+  {
+    // walk from the highest cut (nothing passes) to the lowest (everything passes)
+    double auc = 0;
+    double lastTPR = 0, lastFPR = 0;
+    for(size_t i = m_nBins + 2; i-- > 0; ) {
+      CutPoint point = getPoint(i);
+      auc += 0.5 * (point.efficiency + lastTPR) * (point.fpr - lastFPR);
+      lastTPR = point.efficiency;
+      lastFPR = point.fpr;
+    }
+    return auc;
+  }
+
+  /**
+   * counts of signal and background samples (all and passing the cut) in equally sized bins of a feature, i.e. the per bin
+   * performance of a classifier as in analyze_class_bins.m (where signal means target == 1, background everything else).
+   * Like histcounts the last bin includes its upper edge, values outside [lower, upper] are not counted.
+   * Accumulators filled by different threads can be merged with add.
+   */
+  class BinnedEfficiency {
+  public:
+    BinnedEfficiency(size_t nBins = 0, double lower = 0, double upper = 1) :
+      m_nBins(nBins), m_lower(lower), m_upper(upper), m_scale(upper > lower ? nBins / (upper - lower) : 0),
+      m_counts(4 * nBins, 0) {}
+
+    /** add one sample with feature value @param value */
+    void fill(double value, bool signal, bool pass)
+    {
+      if(!(value >= m_lower && value <= m_upper) || m_nBins == 0) return;
+      const size_t iBin = std::min(m_nBins - 1, size_t((value - m_lower) * m_scale));
+      m_counts[4 * iBin + (signal ? 0 : 2) + (pass ? 1 : 0)]++;
+    }
+
+    /** add the counts of another accumulator (with the same binning) */
+    void add(const BinnedEfficiency& other)
+    {
+      for(size_t i = 0; i < m_counts.size() && i < other.m_counts.size(); ++i) m_counts[i] += other.m_counts[i];
+    }
+
+    size_t getNBins() const { return m_nBins; } /**< number of bins */
+
+    double getLowEdge(size_t iBin) const { return m_lower + iBin / m_scale; } /**< lower edge of bin iBin */
+
+    uint64_t getNSignal(size_t iBin) const { return m_counts[4 * iBin] + m_counts[4 * iBin + 1]; } /**< signal samples in bin iBin */
+
+    uint64_t getNBackground(size_t iBin) const { return m_counts[4 * iBin + 2] + m_counts[4 * iBin + 3]; } /**< background samples in bin iBin */
+
+    uint64_t getNSignalPass(size_t iBin) const { return m_counts[4 * iBin + 1]; } /**< signal samples passing the cut in bin iBin */
+
+    uint64_t getNBackgroundPass(size_t iBin) const { return m_counts[4 * iBin + 3]; } /**< background samples passing the cut in bin iBin */
+
+    /** signal efficiency in bin iBin (NaN if there is no signal) */
+    double getEfficiency(size_t iBin) const
+    {
+      return getNSignal(iBin) ? double(getNSignalPass(iBin)) / getNSignal(iBin) : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    /** SNR gain (SNR after the cut / SNR before) in bin iBin (0 if there is no background, as in analyze_class_bins.m) */
+    double getSNRGain(size_t iBin) const
+    {
+      if(getNBackground(iBin) == 0) return 0;
+      const double snrIn = double(getNSignal(iBin)) / getNBackground(iBin);
+      const double snrOut = getNBackgroundPass(iBin) ? double(getNSignalPass(iBin)) / getNBackgroundPass(iBin) :
+                            std::numeric_limits<double>::infinity();
+      return snrIn > 0 ? snrOut / snrIn : std::numeric_limits<double>::quiet_NaN();
+    }
+
+  private:
+    size_t m_nBins; /**< number of bins */
+    double m_lower; /**< lower edge of the first bin */
+    double m_upper; /**< upper edge of the last bin */
+    double m_scale; /**< bins per unit of the feature */
+    std::vector<uint64_t> m_counts; /**< per bin: signal failing, signal passing, background failing, background passing */
+  };
+
+  /**
+   * atan2(y, x) without branches and calls (reduction to |t| <= tan(pi/8) + the rational approximation of atan from cephes), such
+   * that loops calling it can be vectorized. Deviation from std::atan2 below 1e-15, atan2(0, 0) = 0. Signed zeros are not treated
+   * (atan2(+-0, -x) = pi). gcc vectorizes the selects only with -fno-trapping-math (see makefile)
+   */
+  inline double vatan2(double y, double x)
+  {
+    const double ax = std::fabs(x);
+    const double ay = std::fabs(y);
+    const double hi = ax > ay ? ax : ay;
+    const double lo = ax > ay ? ay : ax;
+    const double a = lo / (hi != 0 ? hi : 1.0); // in [0, 1]
+    // atan(a) = pi/4 + atan((a - 1) / (a + 1)) for a > tan(pi/8)
+    const bool reduce = a > 0.41421356237309504880;
+    const double t = reduce ? (a - 1) / (a + 1) : a;
+    const double z = t * t;
+    double p = -8.750608600031904122785e-1;
+    p = p * z - 1.615753718733365076637e1;
+    p = p * z - 7.500855792314704667340e1;
+    p = p * z - 1.228866684490136173410e2;
+    p = p * z - 6.485021904942025371773e1;
+    double q = z + 2.485846490142306297962e1;
+    q = q * z + 1.650270098316988542046e2;
+    q = q * z + 4.328810604912902668951e2;
+    q = q * z + 4.853903996359136964868e2;
+    q = q * z + 1.945506571482613964425e2;
+    double r = t + t * z * p / q + (reduce ? M_PI_4 : 0.0);
+    r = ay > ax ? M_PI_2 - r : r;
+    r = x < 0 ? M_PI - r : r;
+    return y < 0 ? -r : r;
+  }
+
+  /**
+   * convert cartesian coordinates to the spherical angles (in degrees) as defined in BASF2 (i.e. by ROOT), same as cart2sph_basf2 in
+   * analyze_class_angular.m: phi in [-180, 180] (0 for x = y = 0), theta in [0, 180] (0 for x = y = 0 or z = 0).
+   * The coordinates are passed as separate arrays and the loop has no branches and uses vatan2, such that gcc vectorizes it (with
+   * -fno-math-errno for std::sqrt and -fno-trapping-math for the selects, see makefile)
+   */
+  inline void cart2sphBasf2(const double* x, const double* y, const double* z, size_t n, double* theta, double* phi)
+  {
+    const double toDeg = 180 / M_PI;
+    for(size_t i = 0; i < n; ++i) {
+      const double perp = std::sqrt(x[i] * x[i] + y[i] * y[i]);
+      const double xyNonZero = perp != 0;
+      const double zNonZero = z[i] != 0;
+      phi[i] = vatan2(y[i], x[i]) * xyNonZero * toDeg;
+      theta[i] = vatan2(perp, z[i]) * xyNonZero * zNonZero * toDeg;
+    }
+  }
+}
@@ -0,0 +1,569 @@
+// evaluation of several classifiers on the same sample (C++ counterpart of the evaluation part of analyze_nets.m)
+//
+// The data file is read (and decorrelated) once and all models are evaluated on it, concurrently over models and chunks of samples.
+// FastBDTs with the same FeatureBinning (e.g. forests with different numbers of trees trained on the same sample) share the binned
+// data, which is computed only once per binning. The outputs of all models are written to one score table (one column per output,
+// that can be passed to classanalysis) and the evaluation time of every model is reported.
+//
+// Supported models (detected from the contents of the file):
+// - FastBDT weight files (fbdt-train) and model bundles (fbdt-train -p)
+// - nets exported from MATLAB (export_net.m)
+// - TMVA weight files (if compiled with -DWITH_TMVA, see makefile)
+// A decorrelation transform next to a model (modelfile.decor) is applied to its inputs (models with the same transform share the
+// decorrelated data)
+//
+// by Thomas Madlener, 2015
+
+#include "FBDT.h"
+#include "FBDT_Reader.h"
+#include "fbdt_bundle.h"
+#include "nn_inference.h"
+#include "decorrelation.h"
+#include "datreader.h"
+#include "datformat.h"
+#include "vxdfilter.h"
+#include "parallel_helper.h"
+#include "tt_timer.h"
+#include "tt_profiler.h"
+#include "tt_memory.h"
+
+#ifdef WITH_TMVA
+#include "TROOT.h"
+#include "tmva_reader.h"
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+// getopt
+#include <unistd.h>
+
+using namespace FastBDT;
+using namespace timing;
+
+/** number of samples per work item (a model evaluates one chunk at a time) */
+size_t chunkRows = 1 << 16;
+
+/**
+ * the inputs of a model: the data as read from the file or decorrelated with one transform
+ */
+struct InputVariant {
+  std::string transformfile; /**< file with the decorrelation transform (empty for the data as read) */
+  std::string key; /**< contents of the transform file (models with the same contents share the decorrelated data) */
+  std::vector<double> values; /**< decorrelated data (row-major, all columns, empty for the data as read) */
+};
+
+/**
+ * the binned inputs of all FastBDTs with the same FeatureBinning (on the same input variant)
+ */
+struct BinningGroup {
+  size_t input; /**< index of the input variant */
+  std::vector<FeatureBinning<double> > featBins; /**< the binning */
+  std::vector<unsigned> bins; /**< binned data (row-major, one value per feature) */
+};
+
+/** one classifier (one or more columns in the score table) */
+class Model {
+public:
+  Model(std::string filename) : m_filename(filename), m_input(0) {}
+  virtual ~Model() {}
+
+  virtual std::string getType() const = 0; /**< type of the model (for the report) */
+
+  virtual size_t getNInputs() const = 0; /**< number of columns of the data that are used */
+
+  virtual size_t getNOutputs() const { return 1; } /**< number of outputs (columns in the score table) */
+
+  /**
+   * evaluate the rows [first, last) (values: row-major with nColumns values per row) on thread iThread and write the outputs
+   * to scores (row-major with scoreStride values per row, starting at the first column of this model)
+   */
+  virtual void evaluate(const double* values, size_t nColumns, size_t first, size_t last, double* scores, size_t scoreStride,
+                        unsigned iThread) = 0;
+
+  std::string getFilename() const { return m_filename; } /**< file of the model */
+
+  size_t getInput() const { return m_input; } /**< index of the input variant */
+
+  void setInput(size_t input) { m_input = input; } /**< set the index of the input variant */
+
+protected:
+  std::string m_filename; /**< file of the model */
+  size_t m_input; /**< index of the input variant */
+};
+
+/** a single FastBDT, that uses the binned data of its BinningGroup */
+class FBDTModel : public Model {
+public:
+  FBDTModel(std::string filename, Forest forest, std::vector<FeatureBinning<double> > featBins) :
+    Model(filename), m_forest(forest), m_featBins(featBins), m_group(0), m_groups(nullptr) {}
+
+  std::string getType() const override { return "FastBDT"; }
+
+  size_t getNInputs() const override { return m_featBins.size(); }
+
+  const std::vector<FeatureBinning<double> >& getFeatureBinnings() const { return m_featBins; } /**< the binning */
+
+  /** set the BinningGroup that holds the binned data */
+  void setGroup(const std::vector<BinningGroup>* groups, size_t group) { m_groups = groups; m_group = group; }
+
+  void evaluate(const double*, size_t, size_t first, size_t last, double* scores, size_t scoreStride, unsigned) override
+  {
+    const size_t nInputs = m_featBins.size();
+    const std::vector<unsigned>& bins = (*m_groups)[m_group].bins;
+    std::vector<unsigned> event(nInputs);
+    for(size_t i = first; i < last; ++i) {
+      std::copy(&bins[i * nInputs], &bins[(i + 1) * nInputs], event.begin());
+      scores[i * scoreStride] = m_forest.Analyse(event);
+    }
+  }
+
+private:
+  Forest m_forest; /**< the forest */
+  std::vector<FeatureBinning<double> > m_featBins; /**< its binning */
+  size_t m_group; /**< index of the BinningGroup */
+  const std::vector<BinningGroup>* m_groups; /**< all BinningGroups */
+};
+
+/** a model bundle of fbdt-train -p (every forest has its own binning, the samples are binned on the fly) */
+class BundleModel : public Model {
+public:
+  BundleModel(std::string filename) : Model(filename), m_fallback(0), m_nInputs(0) {}
+
+  /** read the bundle. @returns false if it cannot be read */
+  bool load()
+  {
+    std::vector<fbdtbundle::BundleModel> models;
+    std::ifstream bundle(m_filename.c_str(), std::ifstream::binary);
+    if(!fbdtbundle::readBundle(bundle, models)) return false;
+    m_fallback = models.size();
+    for(const fbdtbundle::BundleModel& model : models) {
+      std::istringstream weights(model.weights);
+      FBDT_Reader reader(weights);
+      if(model.fallback) m_fallback = m_forests.size();
+      else m_modelIndex[model.combination] = m_forests.size();
+      m_forests.push_back(reader.getFastBDT());
+      m_featBins.push_back(reader.getFeatureBinnings());
+      m_nInputs = std::max(m_nInputs, m_featBins.back().size());
+    }
+    return m_fallback < models.size();
+  }
+
+  std::string getType() const override { return "FastBDT bundle (" + std::to_string(m_forests.size()) + ")"; }
+
+  size_t getNInputs() const override { return std::max(m_nInputs, fbdtbundle::c_vxdidColumn + 3); }
+
+  void evaluate(const double* values, size_t nColumns, size_t first, size_t last, double* scores, size_t scoreStride,
+                unsigned) override
+  {
+    std::vector<unsigned> event;
+    for(size_t i = first; i < last; ++i) {
+      const double* row = values + i * nColumns;
+      auto it = m_modelIndex.find(fbdtbundle::getSensorCombination(row));
+      const size_t iModel = it == m_modelIndex.end() ? m_fallback : it->second;
+      const std::vector<FeatureBinning<double> >& featBins = m_featBins[iModel];
+      event.resize(featBins.size());
+      for(size_t iF = 0; iF < featBins.size(); ++iF) event[iF] = featBins[iF].ValueToBin(row[iF]);
+      scores[i * scoreStride] = m_forests[iModel].Analyse(event);
+    }
+  }
+
+private:
+  std::vector<Forest> m_forests; /**< all forests */
+  std::vector<std::vector<FeatureBinning<double> > > m_featBins; /**< their binnings */
+  std::unordered_map<uint64_t, size_t> m_modelIndex; /**< index of the forest of every sensor combination */
+  size_t m_fallback; /**< index of the fallback forest */
+  size_t m_nInputs; /**< maximum number of inputs of the forests */
+};
+
+/** a net exported from MATLAB */
+class NetModel : public Model {
+public:
+  NetModel(std::string filename, unsigned nThreads) : Model(filename), m_workspaces(nThreads), m_outputs(nThreads) {}
+
+  bool load() { return m_net.load(m_filename); } /**< read the net. @returns false if it cannot be read */
+
+  std::string getType() const override { return "net (" + std::to_string(m_net.getLayers().size()) + " layers)"; }
+
+  size_t getNInputs() const override { return m_net.getNInputs(); }
+
+  size_t getNOutputs() const override { return m_net.getNOutputs(); }
+
+  void evaluate(const double* values, size_t nColumns, size_t first, size_t last, double* scores, size_t scoreStride,
+                unsigned iThread) override
+  {
+    const size_t batchSize = 256, nOutputs = m_net.getNOutputs();
+    std::vector<double>& outputs = m_outputs[iThread];
+    outputs.resize(batchSize * nOutputs);
+    for(size_t begin = first; begin < last; begin += batchSize) {
+      const size_t n = std::min(batchSize, last - begin);
+      m_net.evaluate(values + begin * nColumns, n, nColumns, outputs.data(), m_workspaces[iThread]);
+      for(size_t i = 0; i < n; ++i) {
+        std::copy(&outputs[i * nOutputs], &outputs[(i + 1) * nOutputs], scores + (begin + i) * scoreStride);
+      }
+    }
+  }
+
+private:
+  nn::Net m_net; /**< the net */
+  std::vector<nn::Workspace> m_workspaces; /**< workspace of every thread */
+  std::vector<std::vector<double> > m_outputs; /**< output buffer of every thread */
+};
+
+#ifdef WITH_TMVA
+/**
+ * a TMVA method. The TMVA::Reader binds its variables by address, so every thread gets its own reader (and input buffer), that is
+ * created when the thread first evaluates this model (serialized, since the construction of the readers is not thread safe)
+ */
+class TMVAModel : public Model {
+public:
+  TMVAModel(std::string filename, std::string method, unsigned nThreads) :
+    Model(filename), m_method(method), m_readers(nThreads), m_inputs(nThreads)
+  {
+    ROOT::EnableThreadSafety(); // the readers are created and evaluated by the worker threads
+  }
+
+  std::string getType() const override { return "TMVA " + m_method; }
+
+  size_t getNInputs() const override { return nTMVAInputs; }
+
+  void evaluate(const double* values, size_t nColumns, size_t first, size_t last, double* scores, size_t scoreStride,
+                unsigned iThread) override
+  {
+    std::unique_ptr<TMVAReader>& reader = m_readers[iThread];
+    std::vector<float>& input = m_inputs[iThread];
+    if(!reader) {
+      std::lock_guard<std::mutex> lock(getTMVAMutex());
+      input.resize(nTMVAInputs);
+      reader.reset(new TMVAReader(m_method, m_filename));
+      const std::vector<std::string> names = getInputNames();
+      for(size_t j = 0; j < nTMVAInputs; ++j) reader->addVariable(names[j], input[j]);
+      reader->bookMethod();
+    }
+    for(size_t i = first; i < last; ++i) {
+      for(size_t j = 0; j < nTMVAInputs; ++j) input[j] = values[i * nColumns + j];
+      scores[i * scoreStride] = reader->evaluate();
+    }
+  }
+
+  /** mutex for the construction of the readers (shared by all TMVA models) */
+  static std::mutex& getTMVAMutex()
+  {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+private:
+  std::string m_method; /**< name of the method */
+  std::vector<std::unique_ptr<TMVAReader> > m_readers; /**< reader of every thread */
+  std::vector<std::vector<float> > m_inputs; /**< input buffer of every thread (NOTE: the reader can only handle floats) */
+};
+#endif
+
+/** get the beginning (at most the first 4096 bytes) of a file */
+std::string getFileHead(std::string filename)
+{
+  std::ifstream infile(filename.c_str(), std::ifstream::binary);
+  std::string head(4096, '\0');
+  infile.read(&head[0], head.size());
+  head.resize(infile.gcount());
+  return head;
+}
+
+/** get the contents of a file (empty if it cannot be read) */
+std::string getFileContents(std::string filename)
+{
+  std::ifstream infile(filename.c_str(), std::ifstream::binary);
+  std::ostringstream contents;
+  contents << infile.rdbuf();
+  return contents.str();
+}
+
+/**
+ * create the model from a file (the type is determined from its contents).
+ * @returns nullptr (and prints the reason) if it cannot be read
+ */
+std::unique_ptr<Model> createModel(std::string filename, unsigned nThreads)
+{
+  const std::string head = getFileHead(filename);
+  if(head.empty()) {
+    std::cerr << "ERROR: could not read " << filename << std::endl;
+    return nullptr;
+  }
+  if(head.compare(0, fbdtbundle::c_bundleTag.size(), fbdtbundle::c_bundleTag) == 0) {
+    std::unique_ptr<BundleModel> model(new BundleModel(filename));
+    if(!model->load()) return nullptr;
+    return std::move(model);
+  }
+  if(head.compare(0, 8, "# nn-net") == 0) {
+    std::unique_ptr<NetModel> model(new NetModel(filename, nThreads));
+    if(!model->load()) return nullptr;
+    return std::move(model);
+  }
+  size_t methodPos = head.find("<MethodSetup Method=\"");
+  if(methodPos != std::string::npos) {
+#ifdef WITH_TMVA
+    // Method="FastBDT::FastBDT" -> method name is the part after the ::
+    methodPos += 21;
+    std::string method = head.substr(methodPos, head.find('"', methodPos) - methodPos);
+    if(method.find("::") != std::string::npos) method = method.substr(method.find("::") + 2);
+    return std::unique_ptr<Model>(new TMVAModel(filename, method, nThreads));
+#else
+    std::cerr << "ERROR: " << filename << " is a TMVA weight file, but TMVA support is not compiled in (-DWITH_TMVA)" << std::endl;
+    return nullptr;
+#endif
+  }
+  std::ifstream weights(filename.c_str());
+  FBDT_Reader reader(weights);
+  return std::unique_ptr<Model>(new FBDTModel(filename, reader.getFastBDT(), reader.getFeatureBinnings()));
+}
+
+/** check if two binnings are the same */
+bool sameBinning(const std::vector<FeatureBinning<double> >& a, const std::vector<FeatureBinning<double> >& b)
+{
+  if(a.size() != b.size()) return false;
+  for(size_t i = 0; i < a.size(); ++i) {
+    if(a[i].GetNLevels() != b[i].GetNLevels() || a[i].GetBinning() != b[i].GetBinning()) return false;
+  }
+  return true;
+}
+
+/** get the name of a model file (basename without extension, as in classanalysis) */
+std::string getModelName(std::string filename)
+{
+  size_t slash = filename.rfind('/');
+  if(slash != std::string::npos) filename = filename.substr(slash + 1);
+  size_t dot = filename.rfind('.');
+  if(dot != std::string::npos && dot > 0) filename = filename.substr(0, dot);
+  return filename;
+}
+
+/**
+ * get the names of the models. Models with the same file name (e.g. from different directories) get their argument index appended
+ * (starting at firstArg for the first model, e.g. fbdt_2, fbdt_3), such that the names in the score table are unique
+ */
+std::vector<std::string> getModelNames(const std::vector<std::unique_ptr<Model> >& models, size_t firstArg)
+{
+  std::vector<std::string> names;
+  for(const std::unique_ptr<Model>& model : models) names.push_back(getModelName(model->getFilename()));
+  std::vector<std::string> unique(names);
+  for(size_t m = 0; m < names.size(); ++m) {
+    if(std::count(names.begin(), names.end(), names[m]) > 1) unique[m] += "_" + std::to_string(firstArg + m);
+  }
+  return unique;
+}
+
+#ifndef __CINT__
+/**
+ * usage: compareclassifiers [-j nThreads] [-r first:last] [-V filter] [-c chunkRows] [-o scorefile] datafile model [model ...]
+ * -j: number of threads, -r: evaluate only the rows [first, last) of the data file, -c: samples per work item (default 65536)
+ * -V: use only the rows that pass filter (0-9, see RootToolBox::passVXDFilter), needs the VXD filter index (datafile.vxd)
+ * -o: score table (default scores.dat): one row per sample, one column per model output (names in the first line, models with the
+ *     same file name are told apart by their argument index)
+ */
+int main(int argc, char* argv[])
+{
+  unsigned nThreads = 0;
+  uint64_t rowBegin = 0, rowEnd = std::numeric_limits<uint64_t>::max();
+  int vxdFilter = -1;
+  std::string scorefile = "scores.dat";
+  int opt;
+  while((opt = getopt(argc, argv, "j:r:V:c:o:")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = atoi(optarg); break;
+    case 'r':
+      if(!datfile::parseRowRange(optarg, rowBegin, rowEnd)) {
+        std::cerr << "invalid row range " << optarg << " (expected first:last)" << std::endl;
+        return 1;
+      }
+      break;
+    case 'V':
+      vxdFilter = atoi(optarg);
+      if(vxdFilter < 0 || unsigned(vxdFilter) >= RootToolBox::c_nVXDFilters) {
+        std::cerr << "invalid VXD filter " << optarg << " (expected 0 to " << RootToolBox::c_nVXDFilters - 1 << ")" << std::endl;
+        return 1;
+      }
+      break;
+    case 'c': chunkRows = std::max(1L, atol(optarg)); break;
+    case 'o': scorefile = optarg; break;
+    default:
+      std::cerr << "usage: " << argv[0] << " [-j nThreads] [-r first:last] [-V filter] [-c chunkRows] [-o scorefile] datafile"
+                << " model [model ...]" << std::endl;
+      return 1;
+    }
+  }
+  if(argc - optind < 2) {
+    std::cerr << "need a data file and at least one model" << std::endl;
+    return 1;
+  }
+  nThreads = parallel::getNThreads(nThreads);
+
+  TT_PROFILE_SCOPE("compareclassifiers");
+  TicTocTimer timer(1000000); // want ms
+  std::cout << "reading in models ... " << std::flush;
+  ScopedTimer readModelsScope("read_models");
+  std::vector<std::unique_ptr<Model> > models;
+  for(int i = optind + 1; i < argc; ++i) {
+    models.push_back(createModel(argv[i], nThreads));
+    if(!models.back()) return 1;
+  }
+  readModelsScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+
+  std::cout << "reading in data ... " << std::flush;
+  timer.tic();
+  ScopedTimer readDataScope("read_data");
+  MemoryStage readDataMemory;
+  datfile::DatReader datreader(argv[optind]);
+  if(!datreader.good()) return 1;
+  const size_t nColumns = datreader.getNColumns();
+  for(const std::unique_ptr<Model>& model : models) {
+    if(nColumns < model->getNInputs()) {
+      std::cerr << "data file has only " << nColumns << " columns, but " << model->getFilename() << " needs " << model->getNInputs()
+                << std::endl;
+      return 1;
+    }
+  }
+  std::vector<double> values; // row-major
+  datreader.readRowsParallel(rowBegin, rowEnd, values, nThreads);
+  if(vxdFilter >= 0) {
+    RootToolBox::VXDFilterIndex vxdIndex;
+    if(!datfile::loadVXDFilterIndex(argv[optind], datreader.getNRows(), vxdIndex)) return 1;
+    datfile::applyVXDFilter(vxdIndex, vxdFilter, rowBegin, nColumns, values);
+  }
+  const size_t nSamples = values.size() / nColumns;
+  readDataScope.stop();
+  std::cout << "DONE. " << nSamples << " samples. " << timer << " " << readDataMemory << std::endl;
+
+  // input variants: the data as read and one decorrelated copy per distinct transform
+  std::cout << "preparing inputs ... " << std::flush;
+  timer.tic();
+  ScopedTimer prepareScope("prepare_inputs");
+  MemoryStage prepareMemory;
+  std::vector<InputVariant> inputs(1);
+  for(std::unique_ptr<Model>& model : models) {
+    const std::string transformfile = decorrelation::DecorrelationTransform::getSidecarName(model->getFilename());
+    const std::string key = getFileContents(transformfile);
+    if(key.empty()) continue;
+    size_t input = 1;
+    while(input < inputs.size() && inputs[input].key != key) ++input;
+    if(input == inputs.size()) {
+      decorrelation::DecorrelationTransform transform;
+      if(!transform.load(transformfile) || transform.getNDims() > nColumns) {
+        std::cerr << "ERROR: could not apply the decorrelation transform " << transformfile << std::endl;
+        return 1;
+      }
+      inputs.push_back(InputVariant());
+      inputs.back().transformfile = transformfile;
+      inputs.back().key = key;
+      inputs.back().values = values;
+      transform.applyParallel(inputs.back().values.data(), nSamples, nColumns, nThreads);
+    }
+    model->setInput(input);
+  }
+  auto getValues = [&](size_t input) { return input == 0 ? values.data() : inputs[input].values.data(); };
+
+  // binning groups: FastBDTs with the same binning on the same input variant share the binned data
+  std::vector<BinningGroup> groups;
+  size_t nFBDTs = 0;
+  for(std::unique_ptr<Model>& model : models) {
+    FBDTModel* fbdt = dynamic_cast<FBDTModel*>(model.get());
+    if(!fbdt) continue;
+    ++nFBDTs;
+    size_t group = 0;
+    while(group < groups.size() && !(groups[group].input == fbdt->getInput() &&
+                                     sameBinning(groups[group].featBins, fbdt->getFeatureBinnings()))) ++group;
+    if(group == groups.size()) {
+      groups.push_back(BinningGroup());
+      groups.back().input = fbdt->getInput();
+      groups.back().featBins = fbdt->getFeatureBinnings();
+      groups.back().bins.resize(nSamples * fbdt->getFeatureBinnings().size());
+    }
+    fbdt->setGroup(&groups, group);
+  }
+  const size_t nChunks = (nSamples + chunkRows - 1) / chunkRows;
+  parallel::parallelForEach(groups.size() * nChunks, nThreads, [&](size_t item, unsigned) {
+      BinningGroup& group = groups[item / nChunks];
+      const size_t first = (item % nChunks) * chunkRows, last = std::min(nSamples, first + chunkRows);
+      const double* data = getValues(group.input);
+      const size_t nInputs = group.featBins.size();
+      for(size_t i = first; i < last; ++i) {
+        for(size_t iF = 0; iF < nInputs; ++iF) group.bins[i * nInputs + iF] = group.featBins[iF].ValueToBin(data[i * nColumns + iF]);
+      }
+    });
+  prepareScope.stop();
+  std::cout << "DONE. " << inputs.size() - 1 << " decorrelated input(s), " << groups.size() << " binning(s) for " << nFBDTs
+            << " FastBDT(s). " << timer << " " << prepareMemory << std::endl;
+
+  // evaluation: one work item per model and chunk, the time of every item is added to its model
+  std::cout << "evaluating " << models.size() << " models ... " << std::flush;
+  timer.tic();
+  ScopedTimer evaluateScope("evaluate");
+  MemoryStage evaluateMemory;
+  std::vector<size_t> firstColumn(models.size() + 1, 0);
+  for(size_t m = 0; m < models.size(); ++m) firstColumn[m + 1] = firstColumn[m] + models[m]->getNOutputs();
+  const size_t nScores = firstColumn.back();
+  std::vector<double> scores(nSamples * nScores);
+  std::vector<std::vector<double> > threadTimes(nThreads, std::vector<double>(models.size(), 0)); // in ms
+  parallel::parallelForEach(models.size() * nChunks, nThreads, [&](size_t item, unsigned iThread) {
+      const size_t m = item / nChunks;
+      const size_t first = (item % nChunks) * chunkRows, last = std::min(nSamples, first + chunkRows);
+      auto start = std::chrono::steady_clock::now();
+      models[m]->evaluate(getValues(models[m]->getInput()), nColumns, first, last, scores.data() + firstColumn[m], nScores, iThread);
+      threadTimes[iThread][m] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    });
+  evaluateScope.stop();
+  std::cout << "DONE. " << timer << " " << evaluateMemory << std::endl;
+
+  std::cout << "writing score table ... " << std::flush;
+  timer.tic();
+  ScopedTimer writeScope("write");
+  std::ofstream outfile(scorefile.c_str());
+  const std::vector<std::string> names = getModelNames(models, optind + 1);
+  std::string line = "#";
+  for(size_t m = 0; m < models.size(); ++m) {
+    const size_t nOutputs = models[m]->getNOutputs();
+    for(size_t o = 0; o < nOutputs; ++o) line += " " + (nOutputs > 1 ? names[m] + "_" + std::to_string(o) : names[m]);
+  }
+  outfile << line << "\n";
+  for(size_t i = 0; i < nSamples; ++i) {
+    line.clear();
+    for(size_t c = 0; c < nScores; ++c) {
+      datformat::appendValue(line, scores[i * nScores + c]);
+      line.push_back(c + 1 < nScores ? ' ' : '\n');
+    }
+    outfile << line;
+  }
+  outfile.close();
+  writeScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+  if(outfile.fail()) {
+    std::cerr << "ERROR: could not write " << scorefile << std::endl;
+    return 1;
+  }
+
+  // report: cpu time of every model (summed over all work items)
+  std::cout << std::endl << std::left << std::setw(40) << "model" << std::setw(24) << "type" << std::right << std::setw(10) << "input"
+            << std::setw(14) << "time [ms]" << std::setw(16) << "per sample [ns]" << std::endl;
+  for(size_t m = 0; m < models.size(); ++m) {
+    double time = 0;
+    for(unsigned t = 0; t < nThreads; ++t) time += threadTimes[t][m];
+    std::cout << std::left << std::setw(40) << names[m] << std::setw(24) << models[m]->getType()
+              << std::right << std::setw(10) << (models[m]->getInput() ? "decor." + std::to_string(models[m]->getInput()) : "raw")
+              << std::fixed << std::setprecision(2) << std::setw(14) << time << std::setw(16)
+              << (nSamples ? time * 1e6 / nSamples : 0) << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+  }
+
+  return 0;
+}
+#endif
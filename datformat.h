@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+namespace datformat {
+
+  /**
+   * append an unsigned integer to the buffer (same output as std::ostream::operator<<)
+   */
+  inline void appendValue(std::string& buffer, unsigned long long value)
+  {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* begin = end;
+    do {
+      *--begin = '0' + value % 10;
+      value /= 10;
+    } while(value);
+    buffer.append(begin, end);
+  }
+
+  /** append an unsigned integer to the buffer (same output as std::ostream::operator<<) */
+  inline void appendValue(std::string& buffer, unsigned value) { appendValue(buffer, (unsigned long long) value); }
+
+  /** append an unsigned short to the buffer (same output as std::ostream::operator<<) */
+  inline void appendValue(std::string& buffer, unsigned short value) { appendValue(buffer, (unsigned long long) value); }
+
+  /** append a signed integer to the buffer (same output as std::ostream::operator<<) */
+  inline void appendValue(std::string& buffer, long long value)
+  {
+    if(value < 0) {
+      buffer.push_back('-');
+      appendValue(buffer, 0ULL - (unsigned long long) value);
+    } else {
+      appendValue(buffer, (unsigned long long) value);
+    }
+  }
+
+  /** append a signed integer to the buffer (same output as std::ostream::operator<<) */
+  inline void appendValue(std::string& buffer, int value) { appendValue(buffer, (long long) value); }
+
+  /** append a bool to the buffer (same output as std::ostream::operator<< without boolalpha, i.e. 0 or 1) */
+  inline void appendValue(std::string& buffer, bool value) { buffer.push_back(value ? '1' : '0'); }
+
+  /**
+   * append a double to the buffer.
+   * The output is the same as std::ostream::operator<< with the default settings (i.e. %g with precision 6), which is the format
+   * of all .dat files written so far
+   */
+  inline void appendValue(std::string& buffer, double value)
+  {
+    // values that are exactly representable small integers are very common (e.g. charge, pdg stored as double) -> fast path
+    if(value > -1e6 && value < 1e6 && value == (long long) value && (value != 0 || !std::signbit(value))) {
+      appendValue(buffer, (long long) value);
+      return;
+    }
+    char digits[32];
+    int n = snprintf(digits, sizeof(digits), "%g", value);
+    buffer.append(digits, n);
+  }
+
+  /**
+   * append a double to the buffer, using the shortest representation that reads back to exactly the same double.
+   * Every decimal with up to 15 (DBL_DIG) significant digits is read back exactly and printed unchanged with %.15g (trailing zeros
+   * are dropped), so only 15, 16 and 17 digits have to be tried (17 always reads back). This is still up to 3 snprintf + strtod per
+   * value, i.e. much slower than appendValue.
+   * NOTE: this does not give the same output as std::ostream::operator<< (which loses precision)!
+   */
+  inline void appendRoundtrip(std::string& buffer, double value)
+  {
+    char digits[32];
+    int n = 0;
+    for(int precision = 15; precision <= 17; ++precision) {
+      n = snprintf(digits, sizeof(digits), "%.*g", precision, value);
+      if(strtod(digits, 0) == value || value != value) break; // NaN never compares equal
+    }
+    buffer.append(digits, n);
+  }
+}
@@ -0,0 +1,80 @@
+// small program that creates the index files (sidecar files, <datfile>.idx) of .dat files
+// the index holds the byte offset of every Kth row as well as the number of rows and columns of the .dat file, so that the tools
+// reading .dat files (fbdt-train, fbdt-eval, dat2root) can split them into independent ranges and seek to arbitrary rows.
+// (the tools create the index themselves if it is missing, but this can be used to create it beforehand or with another stride)
+// With -t it also creates the VXD filter index (<datfile>.vxd) from the column holding the topology codes (see root2dat -t).
+//
+// by Thomas Madlener, 2015
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+// getopt
+#include <unistd.h>
+
+#include "datreader.h"
+#include "vxdfilter.h"
+#include "tt_timer.h"
+
+using namespace timing;
+
+/**
+ * usage: datindex [-k stride] [-f] [-t column] datfile(s)
+ * -k: store the offset of every stride-th row (default 4096), -f: rebuild the index even if there is a valid one
+ * -t: (re)build the VXD filter index from the topology codes in column (negative: counted from the end, root2dat -t writes -2)
+ */
+int main(int argc, char* argv[])
+{
+  uint64_t stride = datfile::defaultIndexStride;
+  bool force = false;
+  bool topology = false;
+  int topologyColumn = -2;
+  int opt;
+  while((opt = getopt(argc, argv, "k:ft:")) != -1) {
+    switch(opt) {
+    case 'k': stride = std::max(1LL, atoll(optarg)); break;
+    case 'f': force = true; break;
+    case 't': topology = true; topologyColumn = atoi(optarg); break;
+    default:
+      std::cerr << "usage: " << argv[0] << " [-k stride] [-f] [-t column] datfile(s)" << std::endl;
+      return 1;
+    }
+  }
+  if(optind >= argc) {
+    std::cerr << "need at least one .dat file" << std::endl;
+    return 1;
+  }
+
+  int ret = 0;
+  TicTocTimer timer(1000000); // want ms
+  for(int i = optind; i < argc; ++i) {
+    timer.tic();
+    datfile::DatIndex index;
+    bool loaded = !force && index.load(argv[i]) && index.getStride() == stride;
+    if(!loaded) {
+      if(!index.build(argv[i], stride) || !index.write(argv[i])) {
+        std::cerr << "ERROR: could not create index of file " << argv[i] << std::endl;
+        ret = 1;
+        continue;
+      }
+    }
+    std::cout << argv[i] << ": " << index.getNRows() << " rows, " << index.getNColumns() << " columns"
+              << (loaded ? " (index is up to date). " : ". ") << timer << std::endl;
+
+    if(topology) {
+      timer.tic();
+      RootToolBox::VXDFilterIndex vxdIndex;
+      const std::string sidecar = RootToolBox::VXDFilterIndex::getSidecarName(argv[i]);
+      if(!datfile::buildVXDFilterIndex(argv[i], topologyColumn, vxdIndex) || !datfile::writeVXDFilterIndex(argv[i], vxdIndex)) {
+        std::cerr << "ERROR: could not create VXD filter index of file " << argv[i] << std::endl;
+        ret = 1;
+        continue;
+      }
+      std::cout << sidecar << ":";
+      for(unsigned f = 0; f < RootToolBox::c_nVXDFilters; ++f) std::cout << " " << vxdIndex.count(f);
+      std::cout << " rows per filter. " << timer << std::endl;
+    }
+  }
+  return ret;
+}
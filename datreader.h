@@ -0,0 +1,407 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+
+// POSIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "parallel_helper.h"
+
+namespace datfile {
+
+  /**
+   * check if a line of a .dat file holds data (i.e. it is neither empty nor a comment starting with '#').
+   * NOTE: every data line is a row, regardless of the number of values in it
+   */
+  inline bool isDataLine(const char* begin, const char* end)
+  {
+    while(begin < end && isspace((unsigned char) *begin)) ++begin;
+    return begin < end && *begin != '#';
+  }
+
+  /**
+   * parse the values of a line into values (at most nMax).
+   * @returns the number of values or -1 if the line contains something that is not a number or more than nMax values
+   */
+  inline int parseLine(const char* begin, const char* end, double* values, size_t nMax)
+  {
+    size_t nValues = 0;
+    for(;;) {
+      while(begin < end && isspace((unsigned char) *begin)) ++begin; // strtod would skip the newline as well
+      if(begin == end) break;
+      char* valueEnd;
+      double value = strtod(begin, &valueEnd);
+      if(valueEnd == begin || valueEnd > end || nValues == nMax) return -1;
+      values[nValues++] = value;
+      begin = valueEnd;
+    }
+    return nValues;
+  }
+
+  /**
+   * helper class that reads the lines of (a part of) a file via pread, i.e. several LineScanners can work on the same file
+   * descriptor concurrently
+   */
+  class LineScanner {
+  public:
+    LineScanner(int fd, uint64_t offset) : m_fd(fd), m_offset(offset), m_buffer(1 << 20), m_pos(0), m_valid(0), m_eof(false) {}
+
+    /**
+     * get the next line (without the newline). @param lineOffset is the offset of the line in the file
+     * @returns false if there are no more lines
+     */
+    bool next(const char*& begin, const char*& end, uint64_t& lineOffset);
+
+  private:
+    int m_fd; /**< the file */
+    uint64_t m_offset; /**< offset in the file of the first byte in the buffer */
+    std::vector<char> m_buffer; /**< read buffer */
+    size_t m_pos; /**< start of the next line in the buffer */
+    size_t m_valid; /**< number of valid bytes in the buffer */
+    bool m_eof; /**< end of the file has been reached */
+  };
+
+  inline bool LineScanner::next(const char*& begin, const char*& end, uint64_t& lineOffset)
+  {
+    for(;;) {
+      const char* newline = static_cast<const char*>(memchr(m_buffer.data() + m_pos, '\n', m_valid - m_pos));
+      if(newline != 0) {
+        begin = m_buffer.data() + m_pos;
+        end = newline;
+        lineOffset = m_offset + m_pos;
+        m_pos = end - m_buffer.data() + 1;
+        return true;
+      }
+      if(m_eof) return false;
+
+      // move the incomplete line to the front and read more (grow the buffer if a line does not fit)
+      memmove(m_buffer.data(), m_buffer.data() + m_pos, m_valid - m_pos);
+      m_offset += m_pos;
+      m_valid -= m_pos;
+      m_pos = 0;
+      if(m_valid == m_buffer.size()) m_buffer.resize(2 * m_buffer.size());
+      ssize_t nRead = pread(m_fd, m_buffer.data() + m_valid, m_buffer.size() - m_valid, m_offset + m_valid);
+      if(nRead > 0) {
+        m_valid += nRead;
+        continue;
+      }
+      m_eof = true;
+      if(m_valid > 0) { // terminate the last line, so that strtod cannot run past its end
+        if(m_valid == m_buffer.size()) m_buffer.resize(m_buffer.size() + 1);
+        m_buffer[m_valid++] = '\n';
+      }
+    }
+  }
+
+  /** header of a .dat index file */
+  struct DatIndexHeader {
+    char magic[8]; /**< always "DATIDX01" */
+    int64_t datSize; /**< size of the .dat file in bytes */
+    int64_t datMTime; /**< modification time of the .dat file in ns */
+    uint64_t stride; /**< an offset is stored for every stride-th row */
+    uint64_t nRows; /**< number of rows (data lines) */
+    uint64_t nColumns; /**< number of values in the first row */
+    uint64_t dataStart; /**< offset of the first line after the header line (0 if there is none) */
+    uint64_t nOffsets; /**< number of stored offsets (following the header) */
+  };
+
+  /** default number of rows between two stored offsets */
+  const uint64_t defaultIndexStride = 4096;
+
+  /**
+   * sidecar index of a .dat file (stored in <datfile>.idx), holding the byte offset of every stride-th row and the number of rows and
+   * columns, so that the file can be split into independent ranges (e.g. for parallel parsing) and arbitrary rows can be reached
+   * without reading the file from the start.
+   * Rows are all lines that are neither empty nor comments ('#'). A first line with non-numeric values (column names) is skipped.
+   * The index is only valid as long as the size and modification time of the .dat file do not change.
+   */
+  class DatIndex {
+  public:
+    DatIndex() : m_stride(defaultIndexStride), m_nRows(0), m_nColumns(0), m_dataStart(0), m_datSize(0), m_datMTime(0) {}
+
+    /** build the index by scanning the file. @returns false if the file cannot be read */
+    bool build(std::string datfile, uint64_t stride = defaultIndexStride);
+
+    /** load the index from the sidecar file. @returns false if there is none or it does not match the .dat file (anymore) */
+    bool load(std::string datfile);
+
+    /** write the index to the sidecar file */
+    bool write(std::string datfile) const;
+
+    /** load the index from the sidecar file or build it (and try to write the sidecar file) if this is not possible */
+    bool loadOrBuild(std::string datfile, bool writeSidecar = true);
+
+    uint64_t getNRows() const { return m_nRows; } /**< number of rows */
+
+    uint64_t getNColumns() const { return m_nColumns; } /**< number of values in the first row */
+
+    uint64_t getStride() const { return m_stride; } /**< number of rows between two stored offsets */
+
+    /** get the offset of the stored row that is closest to (but not after) row iRow. @param skip, number of rows to skip from there */
+    uint64_t getOffset(uint64_t iRow, uint64_t& skip) const;
+
+    /** split [rowBegin, rowEnd) into nRanges ranges of (almost) the same number of rows. @returns the boundaries (nRanges + 1) */
+    std::vector<uint64_t> splitRows(uint64_t rowBegin, uint64_t rowEnd, size_t nRanges) const;
+
+    static std::string getSidecarName(std::string datfile) { return datfile + ".idx"; } /**< get the name of the sidecar file */
+
+    /** get size and modification time (in ns) of a file. @returns false if it does not exist */
+    static bool statFile(const std::string& filename, int64_t& size, int64_t& mtime);
+
+  private:
+    uint64_t m_stride; /**< an offset is stored for every stride-th row */
+    uint64_t m_nRows; /**< number of rows */
+    uint64_t m_nColumns; /**< number of values in the first row */
+    uint64_t m_dataStart; /**< offset of the first line after the header line */
+    int64_t m_datSize; /**< size of the .dat file */
+    int64_t m_datMTime; /**< modification time of the .dat file in ns */
+    std::vector<uint64_t> m_offsets; /**< offsets of the rows 0, stride, 2 * stride, ... */
+  };
+
+  // ==================================================== STAT ====================================================================
+  inline bool DatIndex::statFile(const std::string& filename, int64_t& size, int64_t& mtime)
+  {
+    struct stat st;
+    if(stat(filename.c_str(), &st) != 0) return false;
+    size = st.st_size;
+    mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+  }
+
+  // ==================================================== BUILD ===================================================================
+  inline bool DatIndex::build(std::string datfile, uint64_t stride)
+  {
+    int fd = open(datfile.c_str(), O_RDONLY);
+    if(fd < 0 || !statFile(datfile, m_datSize, m_datMTime)) {
+      std::cerr << "ERROR: could not open file " << datfile << std::endl;
+      if(fd >= 0) close(fd);
+      return false;
+    }
+    m_stride = std::max<uint64_t>(stride, 1);
+    m_nRows = 0;
+    m_nColumns = 0;
+    m_dataStart = 0;
+    m_offsets.clear();
+
+    LineScanner scanner(fd, 0);
+    const char* begin;
+    const char* end;
+    uint64_t offset;
+    bool first = true;
+    std::vector<double> values(1024);
+    while(scanner.next(begin, end, offset)) {
+      if(!isDataLine(begin, end)) continue;
+      if(first) { // first data line is either the header (column names) or determines the number of columns
+        int nValues = parseLine(begin, end, values.data(), values.size());
+        if(nValues < 0 && m_dataStart == 0) {
+          m_dataStart = end - begin + offset + 1;
+          continue;
+        }
+        first = false;
+        m_nColumns = std::max(nValues, 0);
+      }
+      if(m_nRows % m_stride == 0) m_offsets.push_back(offset);
+      m_nRows++;
+    }
+    close(fd);
+    return true;
+  }
+
+  // ==================================================== LOAD / WRITE ============================================================
+  inline bool DatIndex::load(std::string datfile)
+  {
+    int64_t datSize, datMTime;
+    if(!statFile(datfile, datSize, datMTime)) return false;
+    FILE* file = fopen(getSidecarName(datfile).c_str(), "rb");
+    if(file == 0) return false;
+
+    DatIndexHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "DATIDX01", 8) == 0 &&
+      header.datSize == datSize && header.datMTime == datMTime && header.stride > 0 &&
+      header.nOffsets == (header.nRows + header.stride - 1) / header.stride;
+    if(ok) {
+      m_offsets.resize(header.nOffsets);
+      ok = fread(m_offsets.data(), sizeof(uint64_t), m_offsets.size(), file) == m_offsets.size();
+    }
+    fclose(file);
+    if(!ok) return false;
+
+    m_stride = header.stride;
+    m_nRows = header.nRows;
+    m_nColumns = header.nColumns;
+    m_dataStart = header.dataStart;
+    m_datSize = datSize;
+    m_datMTime = datMTime;
+    return true;
+  }
+
+  inline bool DatIndex::write(std::string datfile) const
+  {
+    DatIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "DATIDX01", 8);
+    header.datSize = m_datSize;
+    header.datMTime = m_datMTime;
+    header.stride = m_stride;
+    header.nRows = m_nRows;
+    header.nColumns = m_nColumns;
+    header.dataStart = m_dataStart;
+    header.nOffsets = m_offsets.size();
+
+    // write to a temporary file first and rename afterwards, so that readers never see a partially written file
+    std::string filename = getSidecarName(datfile);
+    std::string tmpname = filename + ".tmp." + std::to_string(getpid());
+    FILE* file = fopen(tmpname.c_str(), "wb");
+    if(file == 0) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if(!m_offsets.empty()) ok &= fwrite(m_offsets.data(), sizeof(uint64_t), m_offsets.size(), file) == m_offsets.size();
+    ok &= fclose(file) == 0;
+    if(!ok || rename(tmpname.c_str(), filename.c_str()) != 0) {
+      unlink(tmpname.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  inline bool DatIndex::loadOrBuild(std::string datfile, bool writeSidecar)
+  {
+    if(load(datfile)) return true;
+    if(!build(datfile)) return false;
+    if(writeSidecar && !write(datfile)) {
+      std::cerr << "WARNING: could not write index file " << getSidecarName(datfile) << std::endl;
+    }
+    return true;
+  }
+
+  // ==================================================== OFFSETS =================================================================
+  inline uint64_t DatIndex::getOffset(uint64_t iRow, uint64_t& skip) const
+  {
+    if(m_offsets.empty()) { skip = 0; return m_dataStart; }
+    uint64_t iOffset = std::min<uint64_t>(iRow / m_stride, m_offsets.size() - 1);
+    skip = iRow - iOffset * m_stride;
+    return m_offsets[iOffset];
+  }
+
+  inline std::vector<uint64_t> DatIndex::splitRows(uint64_t rowBegin, uint64_t rowEnd, size_t nRanges) const
+  {
+    nRanges = std::max<size_t>(nRanges, 1);
+    std::vector<uint64_t> bounds;
+    for(size_t i = 0; i <= nRanges; ++i) bounds.push_back(rowBegin + (rowEnd - rowBegin) * i / nRanges);
+    return bounds;
+  }
+
+  /**
+   * class reading rows of a .dat file using its index. All reading functions can be called concurrently.
+   * usage:
+   *   DatReader reader("data.dat");
+   *   std::vector<double> values; // row-major
+   *   reader.readRowsParallel(0, reader.getNRows(), values, nThreads);
+   */
+  class DatReader {
+  public:
+    /** open the file and load (or build) its index */
+    DatReader(std::string datfile);
+
+    ~DatReader() { if(m_fd >= 0) close(m_fd); }
+
+    bool good() const { return m_fd >= 0; } /**< check if the file could be opened and indexed */
+
+    const DatIndex& getIndex() const { return m_index; } /**< get the index */
+
+    uint64_t getNRows() const { return m_index.getNRows(); } /**< number of rows */
+
+    uint64_t getNColumns() const { return m_index.getNColumns(); } /**< number of values per row */
+
+    /**
+     * read the rows [rowBegin, rowEnd) into values (row-major, getNColumns() values per row; has to hold enough space).
+     * Rows with the wrong number of values are filled with NaN.
+     * @returns the number of such (bad) rows
+     */
+    size_t readRows(uint64_t rowBegin, uint64_t rowEnd, double* values) const;
+
+    /** read the rows [rowBegin, rowEnd) into values (resized) splitting the range for nThreads threads. @returns the number of bad rows */
+    size_t readRowsParallel(uint64_t rowBegin, uint64_t rowEnd, std::vector<double>& values, unsigned nThreads) const;
+
+  private:
+    std::string m_filename; /**< the .dat file */
+    int m_fd; /**< file descriptor of the .dat file */
+    DatIndex m_index; /**< index of the .dat file */
+  };
+
+  inline DatReader::DatReader(std::string datfile) : m_filename(datfile), m_fd(-1)
+  {
+    if(!m_index.loadOrBuild(datfile)) return;
+    m_fd = open(datfile.c_str(), O_RDONLY);
+    if(m_fd < 0) std::cerr << "ERROR: could not open file " << datfile << std::endl;
+  }
+
+  inline size_t DatReader::readRows(uint64_t rowBegin, uint64_t rowEnd, double* values) const
+  {
+    rowEnd = std::min(rowEnd, getNRows());
+    if(rowBegin >= rowEnd || !good()) return 0;
+
+    const size_t nColumns = getNColumns();
+    uint64_t skip;
+    LineScanner scanner(m_fd, m_index.getOffset(rowBegin, skip));
+    const char* begin;
+    const char* end;
+    uint64_t offset;
+    size_t nBad = 0;
+    for(uint64_t iRow = rowBegin - skip; iRow < rowEnd && scanner.next(begin, end, offset); ) {
+      if(!isDataLine(begin, end)) continue;
+      if(iRow >= rowBegin) {
+        double* row = values + (iRow - rowBegin) * nColumns;
+        if(parseLine(begin, end, row, nColumns) != int(nColumns)) {
+          std::fill(row, row + nColumns, std::numeric_limits<double>::quiet_NaN());
+          nBad++;
+        }
+      }
+      ++iRow;
+    }
+    return nBad;
+  }
+
+  inline size_t DatReader::readRowsParallel(uint64_t rowBegin, uint64_t rowEnd, std::vector<double>& values, unsigned nThreads) const
+  {
+    rowEnd = std::min(rowEnd, getNRows());
+    rowBegin = std::min(rowBegin, rowEnd);
+    values.resize((rowEnd - rowBegin) * getNColumns());
+
+    nThreads = parallel::getNThreads(nThreads);
+    std::vector<uint64_t> bounds = m_index.splitRows(rowBegin, rowEnd, nThreads);
+    std::vector<size_t> nBad(nThreads, 0);
+    parallel::parallelFor(nThreads, nThreads, [&](size_t first, size_t last, unsigned) {
+        for(size_t i = first; i < last; ++i) {
+          nBad[i] = readRows(bounds[i], bounds[i + 1], values.data() + (bounds[i] - rowBegin) * getNColumns());
+        }
+      });
+
+    size_t nBadTotal = 0;
+    for(size_t n : nBad) nBadTotal += n;
+    return nBadTotal;
+  }
+
+  /** parse a row range of the form first:last (last excluded, either can be omitted). @returns false if it is malformed */
+  inline bool parseRowRange(std::string range, uint64_t& rowBegin, uint64_t& rowEnd)
+  {
+    size_t colon = range.find(':');
+    if(colon == std::string::npos) return false;
+    std::string first = range.substr(0, colon);
+    std::string last = range.substr(colon + 1);
+    rowBegin = first.empty() ? 0 : strtoull(first.c_str(), 0, 10);
+    rowEnd = last.empty() ? std::numeric_limits<uint64_t>::max() : strtoull(last.c_str(), 0, 10);
+    return rowBegin <= rowEnd;
+  }
+}
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+#include "datformat.h"
+#include "parallel_helper.h"
+
+namespace decorrelation {
+
+  /**
+   * streaming estimate of the mean and the covariance matrix (same normalization as MATLABs cov, i.e. 1/(n-1)) of nDims variables.
+   * The samples are added one by one (Welford's algorithm), accumulators filled by different threads can be merged with add
+   * (pairwise update of Chan et al.), such that the result does not depend on the number of threads (apart from rounding).
+   */
+  class CovarianceAccumulator {
+  public:
+    CovarianceAccumulator(size_t nDims = 0) : m_nDims(nDims), m_n(0), m_mean(nDims, 0), m_comoment(nDims * nDims, 0), m_delta(nDims) {}
+
+    /** add one sample (nDims values) */
+    void fill(const double* x)
+    {
+      m_n++;
+      const double invN = 1.0 / m_n;
+      for(size_t i = 0; i < m_nDims; ++i) {
+        m_delta[i] = x[i] - m_mean[i];
+        m_mean[i] += m_delta[i] * invN;
+      }
+      // comoment += (x - oldMean) * (x - newMean)'
+      for(size_t i = 0; i < m_nDims; ++i) {
+        const double d = x[i] - m_mean[i];
+        double* row = &m_comoment[i * m_nDims];
+        for(size_t j = 0; j < m_nDims; ++j) row[j] += m_delta[j] * d;
+      }
+    }
+
+    /** merge the samples of another accumulator (with the same number of variables) */
+    void add(const CovarianceAccumulator& other);
+
+    uint64_t getN() const { return m_n; } /**< number of samples */
+
+    size_t getNDims() const { return m_nDims; } /**< number of variables */
+
+    const std::vector<double>& getMean() const { return m_mean; } /**< mean of every variable */
+
+    /** get the covariance matrix (row-major nDims x nDims) */
+    std::vector<double> getCovariance() const
+    {
+      std::vector<double> cov(m_comoment);
+      const double norm = m_n > 1 ? 1.0 / (m_n - 1) : 0;
+      for(double& c : cov) c *= norm;
+      return cov;
+    }
+
+  private:
+    size_t m_nDims; /**< number of variables */
+    uint64_t m_n; /**< number of samples */
+    std::vector<double> m_mean; /**< running mean */
+    std::vector<double> m_comoment; /**< sum of (x - mean)(x - mean)' (row-major) */
+    std::vector<double> m_delta; /**< scratch space for fill */
+  };
+
+  inline void CovarianceAccumulator::add(const CovarianceAccumulator& other)
+  {
+    if(other.m_n == 0) return;
+    if(m_n == 0) {
+      *this = other;
+      return;
+    }
+    const double n = m_n + other.m_n;
+    const double factor = double(m_n) * other.m_n / n;
+    for(size_t i = 0; i < m_nDims; ++i) m_delta[i] = other.m_mean[i] - m_mean[i];
+    for(size_t i = 0; i < m_nDims; ++i) {
+      for(size_t j = 0; j < m_nDims; ++j) {
+        m_comoment[i * m_nDims + j] += other.m_comoment[i * m_nDims + j] + m_delta[i] * m_delta[j] * factor;
+      }
+    }
+    for(size_t i = 0; i < m_nDims; ++i) m_mean[i] += m_delta[i] * other.m_n / n;
+    m_n += other.m_n;
+  }
+
+  /**
+   * eigendecomposition of a symmetric matrix A (row-major n x n) with the cyclic Jacobi method: A = U * diag(D) * U'.
+   * The eigenvalues are sorted in ascending order (as returned by MATLABs eig for symmetric matrices), U holds the (normalized)
+   * eigenvectors in its columns (row-major). Meant for small matrices (like the 9 x 9 covariance matrix of the inputs)
+   */
+  inline void eigenSymmetric(std::vector<double> A, size_t n, std::vector<double>& U, std::vector<double>& D)
+  {
+    std::vector<double> V(n * n, 0);
+    for(size_t i = 0; i < n; ++i) V[i * n + i] = 1;
+
+    for(int sweep = 0; sweep < 100; ++sweep) {
+      double offDiagonal = 0, diagonal = 0;
+      for(size_t i = 0; i < n; ++i) {
+        diagonal += A[i * n + i] * A[i * n + i];
+        for(size_t j = i + 1; j < n; ++j) offDiagonal += A[i * n + j] * A[i * n + j];
+      }
+      if(offDiagonal <= 1e-30 * diagonal || offDiagonal == 0) break;
+
+      for(size_t p = 0; p < n; ++p) {
+        for(size_t q = p + 1; q < n; ++q) {
+          const double apq = A[p * n + q];
+          if(apq == 0) continue;
+          // rotation that zeroes A(p,q), see e.g. Golub, van Loan: Matrix Computations, 8.4
+          const double tau = (A[q * n + q] - A[p * n + p]) / (2 * apq);
+          const double t = (tau >= 0 ? 1 : -1) / (std::fabs(tau) + std::sqrt(1 + tau * tau));
+          const double c = 1 / std::sqrt(1 + t * t), s = t * c;
+          for(size_t k = 0; k < n; ++k) { // A = A * J
+            const double akp = A[k * n + p], akq = A[k * n + q];
+            A[k * n + p] = c * akp - s * akq;
+            A[k * n + q] = s * akp + c * akq;
+          }
+          for(size_t k = 0; k < n; ++k) { // A = J' * A
+            const double apk = A[p * n + k], aqk = A[q * n + k];
+            A[p * n + k] = c * apk - s * aqk;
+            A[q * n + k] = s * apk + c * aqk;
+          }
+          for(size_t k = 0; k < n; ++k) { // V = V * J
+            const double vkp = V[k * n + p], vkq = V[k * n + q];
+            V[k * n + p] = c * vkp - s * vkq;
+            V[k * n + q] = s * vkp + c * vkq;
+          }
+        }
+      }
+    }
+
+    std::vector<size_t> order(n);
+    for(size_t i = 0; i < n; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return A[a * n + a] < A[b * n + b]; });
+    D.resize(n);
+    U.resize(n * n);
+    for(size_t j = 0; j < n; ++j) {
+      D[j] = A[order[j] * n + order[j]];
+      for(size_t i = 0; i < n; ++i) U[i * n + j] = V[i * n + order[j]];
+    }
+  }
+
+  /**
+   * decorrelation transform of decorrelate.m: Z = X * U (/ sqrt(D) if normalized), where cov(X) = U * diag(D) * U'.
+   * As in decorrelate.m the inputs are not centered. The transform of a sample is one (nDims x nDims) matrix vector product with the
+   * normalization folded into the matrix, applied to a block of rows at once (see apply).
+   * usage:
+   *   DecorrelationTransform transform;
+   *   transform.compute(accumulator); // or transform.load(filename);
+   *   transform.apply(values.data(), nRows, nColumns); // in place, the first nDims columns of every row
+   */
+  class DecorrelationTransform {
+  public:
+    DecorrelationTransform() : m_nDims(0), m_normalize(true) {}
+
+    /** compute the transform from the covariance of the samples. @returns false if the covariance matrix is not positive definite */
+    bool compute(const CovarianceAccumulator& accumulator, bool normalize = true)
+    {
+      m_nDims = accumulator.getNDims();
+      m_normalize = normalize;
+      eigenSymmetric(accumulator.getCovariance(), m_nDims, m_U, m_D);
+      updateMatrix();
+      return m_nDims > 0 && m_D[0] > 0;
+    }
+
+    size_t getNDims() const { return m_nDims; } /**< number of transformed variables (columns) */
+
+    const std::vector<double>& getEigenvectors() const { return m_U; } /**< U (row-major, eigenvectors in the columns) */
+
+    const std::vector<double>& getEigenvalues() const { return m_D; } /**< diagonal of D */
+
+    /**
+     * transform the first nDims columns of nRows rows (row-major, nColumns values per row) in place. NaN (unreadable rows) stays NaN
+     */
+    void apply(double* values, size_t nRows, size_t nColumns) const;
+
+    /** apply the transform to nRows rows on nThreads threads */
+    void applyParallel(double* values, size_t nRows, size_t nColumns, unsigned nThreads) const
+    {
+      parallel::parallelFor(nRows, nThreads, [&](size_t first, size_t last, unsigned) {
+          apply(values + first * nColumns, last - first, nColumns);
+        });
+    }
+
+    /** write the transform (text file with full precision) */
+    bool write(std::string filename) const;
+
+    /** read a transform written by write. @returns false if the file cannot be read */
+    bool load(std::string filename);
+
+    /** get the name of the file with the transform of a model */
+    static std::string getSidecarName(std::string modelfile) { return modelfile + ".decor"; }
+
+  private:
+    /** update m_W from U and D */
+    void updateMatrix()
+    {
+      m_W.resize(m_nDims * m_nDims);
+      for(size_t i = 0; i < m_nDims; ++i) {
+        for(size_t j = 0; j < m_nDims; ++j) m_W[i * m_nDims + j] = m_U[i * m_nDims + j] / (m_normalize ? std::sqrt(m_D[j]) : 1.0);
+      }
+    }
+
+    size_t m_nDims; /**< number of variables */
+    bool m_normalize; /**< divide by sqrt(D) */
+    std::vector<double> m_U; /**< eigenvectors of the covariance matrix (columns, row-major) */
+    std::vector<double> m_D; /**< eigenvalues of the covariance matrix */
+    std::vector<double> m_W; /**< U / sqrt(D) (row-major), i.e. z = x * W */
+  };
+
+  inline void DecorrelationTransform::apply(double* values, size_t nRows, size_t nColumns) const
+  {
+    const size_t blockSize = 64;
+    std::vector<double> z(blockSize * m_nDims);
+    for(size_t begin = 0; begin < nRows; begin += blockSize) {
+      const size_t n = std::min(blockSize, nRows - begin);
+      double* block = values + begin * nColumns;
+      // z(r, :) = sum_i x(r, i) * W(i, :), innermost loop over the output columns such that it can be vectorized
+      std::fill(z.begin(), z.begin() + n * m_nDims, 0);
+      for(size_t r = 0; r < n; ++r) {
+        const double* x = block + r * nColumns;
+        double* zr = &z[r * m_nDims];
+        for(size_t i = 0; i < m_nDims; ++i) {
+          const double xi = x[i];
+          const double* w = &m_W[i * m_nDims];
+          for(size_t j = 0; j < m_nDims; ++j) zr[j] += xi * w[j];
+        }
+      }
+      for(size_t r = 0; r < n; ++r) std::copy(&z[r * m_nDims], &z[(r + 1) * m_nDims], block + r * nColumns);
+    }
+  }
+
+  inline bool DecorrelationTransform::write(std::string filename) const
+  {
+    std::ofstream outfile(filename.c_str());
+    std::string line = "# decorrelation " + std::to_string(m_nDims) + " " + std::to_string(int(m_normalize)) + "\n# eigenvalues\n";
+    for(size_t j = 0; j < m_nDims; ++j) {
+      datformat::appendRoundtrip(line, m_D[j]);
+      line.push_back(j + 1 < m_nDims ? ' ' : '\n');
+    }
+    line += "# eigenvectors (columns)\n";
+    for(size_t i = 0; i < m_nDims; ++i) {
+      for(size_t j = 0; j < m_nDims; ++j) {
+        datformat::appendRoundtrip(line, m_U[i * m_nDims + j]);
+        line.push_back(j + 1 < m_nDims ? ' ' : '\n');
+      }
+    }
+    outfile << line;
+    return outfile.good();
+  }
+
+  inline bool DecorrelationTransform::load(std::string filename)
+  {
+    std::ifstream infile(filename.c_str());
+    std::string line, hash, tag;
+    int normalize = 1;
+    if(!std::getline(infile, line) || !(std::istringstream(line) >> hash >> tag >> m_nDims >> normalize) || tag != "decorrelation") {
+      return false;
+    }
+    m_normalize = normalize != 0;
+    m_D.resize(m_nDims);
+    m_U.resize(m_nDims * m_nDims);
+    std::getline(infile, line); // # eigenvalues
+    for(double& d : m_D) infile >> d;
+    std::getline(infile, line); // rest of the line
+    std::getline(infile, line); // # eigenvectors
+    for(double& u : m_U) infile >> u;
+    if(!infile) return false;
+    updateMatrix();
+    return true;
+  }
+
+  /**
+   * compute the covariance of the first nDims columns of nRows rows (row-major, nColumns values per row) on nThreads threads.
+   * Rows with NaN (unreadable rows) are skipped
+   */
+  inline CovarianceAccumulator computeCovariance(const double* values, size_t nRows, size_t nColumns, size_t nDims, unsigned nThreads)
+  {
+    nThreads = parallel::getNThreads(nThreads);
+    std::vector<CovarianceAccumulator> accumulators(nThreads, CovarianceAccumulator(nDims));
+    parallel::parallelFor(nRows, nThreads, [&](size_t first, size_t last, unsigned iThread) {
+        CovarianceAccumulator& acc = accumulators[iThread];
+        for(size_t r = first; r < last; ++r) {
+          const double* x = values + r * nColumns;
+          bool good = true;
+          for(size_t i = 0; i < nDims; ++i) good &= x[i] == x[i];
+          if(good) acc.fill(x);
+        }
+      });
+    for(unsigned t = 1; t < nThreads; ++t) accumulators[0].add(accumulators[t]);
+    return accumulators[0];
+  }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+
+namespace fbdtbundle {
+
+  /** first column of the vxdids (of hit 1, 2, 3) in the .dat files written by root2dat (VxdIDs on [10:12] in get_sensor_combis.m) */
+  const size_t c_vxdidColumn = 9;
+
+  /** first word of a model bundle file (a plain FastBDT weight file starts with '<') */
+  const std::string c_bundleTag = "# fbdt-bundle";
+
+  /** sensor combination of the samples with an invalid vxdid (no model has it, i.e. these samples always go to the fallback) */
+  const uint64_t c_invalidCombination = ~uint64_t(0);
+
+  /**
+   * get the sensor combination of a sample (row of a .dat file), i.e. the key of get_sensor_combis.m without the loss of precision:
+   * the raw vxdids have 16 bits, so all three of them fit into one 64 bit key.
+   * @returns c_invalidCombination if one of the vxdids is NaN (bad rows) or not in [0, 0xffff]
+   */
+  inline uint64_t getSensorCombination(const double* row)
+  {
+    uint64_t combination = 0;
+    for(size_t i = 0; i < 3; ++i) {
+      const double vxdid = row[c_vxdidColumn + i];
+      if(!(vxdid >= 0 && vxdid <= 0xffff)) return c_invalidCombination; // also catches NaN
+      combination = (combination << 16) | (uint64_t(vxdid) & 0xffff);
+    }
+    return combination;
+  }
+
+  /** get the key of a sensor combination as in the bundle file (vxdid1:vxdid2:vxdid3) */
+  inline std::string getCombinationName(uint64_t combination)
+  {
+    return std::to_string(combination >> 32) + ":" + std::to_string((combination >> 16) & 0xffff) + ":" +
+           std::to_string(combination & 0xffff);
+  }
+
+  /** one model of a bundle (the weights are stored as written by the FBDT_Writer, such that this does not depend on FastBDT) */
+  struct BundleModel {
+    BundleModel() : combination(0), fallback(false), nSamples(0) {}
+    uint64_t combination; /**< sensor combination of the model (unused for the fallback) */
+    bool fallback; /**< the model is used for all combinations without an own model */
+    uint64_t nSamples; /**< number of samples the model was trained with */
+    std::string weights; /**< contents of the weight file */
+  };
+
+  /**
+   * write a bundle of models. Format: one line "# fbdt-bundle nModels", then for every model one line
+   * "# model vxdid1:vxdid2:vxdid3 nSamples nBytes" (or "# model fallback nSamples nBytes") followed by nBytes of weights
+   */
+  inline bool writeBundle(std::ostream& out, const std::vector<BundleModel>& models)
+  {
+    out << c_bundleTag << " " << models.size() << "\n";
+    for(const BundleModel& model : models) {
+      out << "# model " << (model.fallback ? std::string("fallback") : getCombinationName(model.combination)) << " "
+          << model.nSamples << " " << model.weights.size() << "\n";
+      out.write(model.weights.data(), model.weights.size());
+    }
+    return out.good();
+  }
+
+  /** check if a file is a bundle (as opposed to the weight file of a single FastBDT) */
+  inline bool isBundle(std::string filename)
+  {
+    std::ifstream infile(filename.c_str());
+    std::string line;
+    return std::getline(infile, line) && line.compare(0, c_bundleTag.size(), c_bundleTag) == 0;
+  }
+
+  /** read a bundle written by writeBundle. @returns false (and prints the reason) if it is malformed */
+  inline bool readBundle(std::istream& in, std::vector<BundleModel>& models)
+  {
+    models.clear();
+    std::string line;
+    if(!std::getline(in, line) || line.compare(0, c_bundleTag.size(), c_bundleTag) != 0) {
+      std::cerr << "ERROR: not a model bundle (missing '" << c_bundleTag << "')" << std::endl;
+      return false;
+    }
+    size_t nModels = 0;
+    if(!(std::istringstream(line.substr(c_bundleTag.size())) >> nModels)) {
+      std::cerr << "ERROR: malformed bundle header (number of models missing): " << line << std::endl;
+      return false;
+    }
+    for(size_t i = 0; i < nModels; ++i) {
+      std::string hash, tag, key;
+      uint64_t nBytes = 0;
+      BundleModel model;
+      if(!std::getline(in, line) || !(std::istringstream(line) >> hash >> tag >> key >> model.nSamples >> nBytes) || tag != "model") {
+        std::cerr << "ERROR: malformed header of model " << i << " in bundle: " << line << std::endl;
+        return false;
+      }
+      unsigned vxdids[3];
+      char sep1 = 0, sep2 = 0;
+      model.fallback = key == "fallback";
+      if(!model.fallback) {
+        if(!(std::istringstream(key) >> vxdids[0] >> sep1 >> vxdids[1] >> sep2 >> vxdids[2]) || sep1 != ':' || sep2 != ':' ||
+           vxdids[0] > 0xffff || vxdids[1] > 0xffff || vxdids[2] > 0xffff) { // the vxdids have 16 bits, see getSensorCombination
+          std::cerr << "ERROR: invalid sensor combination " << key << " in bundle" << std::endl;
+          return false;
+        }
+        model.combination = (uint64_t(vxdids[0]) << 32) | (uint64_t(vxdids[1]) << 16) | vxdids[2];
+      }
+      model.weights.resize(nBytes);
+      if(!in.read(&model.weights[0], nBytes)) {
+        std::cerr << "ERROR: bundle is truncated (model " << key << ")" << std::endl;
+        return false;
+      }
+      models.push_back(model);
+    }
+    return true;
+  }
+}
@@ -1,6 +1,14 @@
 #include "FBDT.h"
 #include "FBDT_Reader.h"
 #include "tt_timer.h"
+#include "tt_profiler.h"
+#include "tt_perfcounters.h"
+#include "tt_memory.h"
+#include "datreader.h"
+#include "vxdfilter.h"
+#include "fbdt_bundle.h"
+#include "decorrelation.h"
+#include "parallel_helper.h"
 
 #include <iostream>
 #include <iomanip>
@@ -8,67 +16,260 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <unordered_map>
+
+// getopt
+#include <unistd.h>
 
 using namespace FastBDT;
 using namespace timing;
 
-/** takes as inputs a .xml file where the FastBDT is stored and a file where the data is stored*/
+/**
+ * decorrelate the inputs (row-major values) with the transform stored next to the model (modelfile.decor, see fbdt-train -d).
+ * Nothing is done if there is none. @returns false if it cannot be applied
+ */
+bool applyDecorrelation(std::string modelfile, std::vector<double>& values, size_t nColumns, unsigned nThreads)
+{
+  const std::string transformfile = decorrelation::DecorrelationTransform::getSidecarName(modelfile);
+  if(!std::ifstream(transformfile.c_str())) return true;
+  decorrelation::DecorrelationTransform transform;
+  if(!transform.load(transformfile) || transform.getNDims() > nColumns) {
+    std::cerr << "ERROR: could not apply the decorrelation transform " << transformfile << std::endl;
+    return false;
+  }
+  ScopedTimer decorrelateScope("decorrelate");
+  PerfRegion decorrelatePerf("DecorrelationTransform::apply", values.size() / nColumns, "sample");
+  parallel::parallelFor(values.size() / nColumns, parallel::getNThreads(nThreads), [&](size_t first, size_t last, unsigned) {
+      PerfThreadScope perf(decorrelatePerf);
+      transform.apply(values.data() + first * nColumns, last - first, nColumns);
+    });
+  std::cout << "(decorrelated with " << transformfile << ") " << std::flush;
+  return true;
+}
+
+/**
+ * evaluate the data file with a model bundle (see fbdt-train -p): the samples are grouped by their sensor combination and every
+ * group is evaluated in one batch with its FastBDT (or the fallback), the groups in parallel on nThreads threads. The outputs are
+ * written in the order of the data file
+ */
+int evaluateBundle(const char* bundlefile, const char* datafile, const char* outputfile, uint64_t rowBegin, uint64_t rowEnd,
+                   int vxdFilter, unsigned nThreads)
+{
+  TicTocTimer timer(1000000); // want ms
+  std::cout << "reading in model bundle ... " << std::flush;
+  ScopedTimer readWeightsScope("read_weights");
+  MemoryStage readWeightsMemory;
+  std::vector<fbdtbundle::BundleModel> models;
+  std::ifstream bundle(bundlefile, std::ifstream::binary);
+  if(!fbdtbundle::readBundle(bundle, models)) return 1;
+  std::vector<Forest> forests;
+  std::vector<std::vector<FeatureBinning<double> > > featBins;
+  std::unordered_map<uint64_t, size_t> modelIndex;
+  size_t fallback = models.size();
+  size_t nInputs = 0;
+  for(const fbdtbundle::BundleModel& model : models) {
+    std::istringstream weights(model.weights);
+    FBDT_Reader reader(weights);
+    if(model.fallback) fallback = forests.size();
+    else modelIndex[model.combination] = forests.size();
+    forests.push_back(reader.getFastBDT());
+    featBins.push_back(reader.getFeatureBinnings());
+    nInputs = std::max(nInputs, featBins.back().size());
+  }
+  if(fallback == models.size()) {
+    std::cerr << "ERROR: the model bundle has no fallback model" << std::endl;
+    return 1;
+  }
+  readWeightsScope.stop();
+  std::cout << "DONE. " << models.size() << " models. " << timer << " " << readWeightsMemory << std::endl;
+
+  std::cout << "reading in data ... " << std::flush;
+  timer.tic();
+  ScopedTimer readDataScope("read_data");
+  MemoryStage readDataMemory;
+  datfile::DatReader datreader(datafile);
+  if(!datreader.good()) return 1;
+  const size_t nColumns = datreader.getNColumns();
+  if(nColumns < std::max(nInputs, fbdtbundle::c_vxdidColumn + 3)) {
+    std::cerr << "data file has only " << nColumns << " columns, but the model bundle needs " << nInputs << " inputs and the vxdids"
+              << std::endl;
+    return 1;
+  }
+  std::vector<double> values; // row-major
+  datreader.readRowsParallel(rowBegin, rowEnd, values, nThreads);
+  if(vxdFilter >= 0) {
+    RootToolBox::VXDFilterIndex vxdIndex;
+    if(!datfile::loadVXDFilterIndex(datafile, datreader.getNRows(), vxdIndex)) return 1;
+    datfile::applyVXDFilter(vxdIndex, vxdFilter, rowBegin, nColumns, values);
+  }
+  if(!applyDecorrelation(bundlefile, values, nColumns, nThreads)) return 1;
+  const size_t nSamples = values.size() / nColumns;
+  readDataScope.stop();
+  std::cout << "DONE. " << timer << " " << readDataMemory << std::endl;
+
+  // group the samples by model (counting sort, such that every group keeps the order of the file)
+  std::cout << "evaluating data ... " << std::flush;
+  timer.tic();
+  ScopedTimer evaluateScope("evaluate");
+  MemoryStage evaluateMemory;
+  std::vector<size_t> sampleModel(nSamples);
+  std::vector<size_t> groupBegin(forests.size() + 1, 0);
+  for(size_t iE = 0; iE < nSamples; ++iE) {
+    auto it = modelIndex.find(fbdtbundle::getSensorCombination(&values[iE * nColumns]));
+    sampleModel[iE] = it == modelIndex.end() ? fallback : it->second;
+    groupBegin[sampleModel[iE] + 1]++;
+  }
+  for(size_t i = 0; i < forests.size(); ++i) groupBegin[i + 1] += groupBegin[i];
+  std::vector<size_t> grouped(nSamples);
+  std::vector<size_t> fill(groupBegin.begin(), groupBegin.end() - 1);
+  for(size_t iE = 0; iE < nSamples; ++iE) grouped[fill[sampleModel[iE]]++] = iE;
+
+  std::vector<double> outputs(nSamples);
+  PerfRegion evaluatePerf("Forest::Analyse (bundle, incl. FeatureBinning::ValueToBin)", nSamples, "sample");
+  parallel::parallelForEach(forests.size(), parallel::getNThreads(nThreads), [&](size_t iModel, unsigned) {
+      PerfThreadScope perf(evaluatePerf);
+      const std::vector<FeatureBinning<double> >& bins = featBins[iModel];
+      std::vector<unsigned> event(bins.size());
+      for(size_t i = groupBegin[iModel]; i < groupBegin[iModel + 1]; ++i) {
+        const double* row = &values[grouped[i] * nColumns];
+        for(size_t iF = 0; iF < bins.size(); ++iF) event[iF] = bins[iF].ValueToBin(row[iF]);
+        outputs[grouped[i]] = forests[iModel].Analyse(event);
+      }
+    });
+  evaluatePerf.stop();
+  evaluateScope.stop();
+  std::cout << "DONE. " << nSamples - (groupBegin[fallback + 1] - groupBegin[fallback]) << " samples with an own model. " << timer
+            << " " << evaluateMemory << std::endl;
+
+  std::fstream outfs(outputfile, std::fstream::out);
+  std::cout << "writing output data ... " << std::flush;
+  timer.tic();
+  ScopedTimer writeScope("write");
+  for (const double& val : outputs) { outfs << val << std::endl; }
+  writeScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+
+  return 0;
+}
+
+/**
+ * takes as inputs a .xml file where the FastBDT is stored (or a model bundle written by fbdt-train -p) and a file where the data is stored
+ * usage: fbdt-eval [-j nThreads] [-r first:last] [-V filter] weightfile datafile outputfile
+ * -j: number of threads used for reading the data file (and evaluating a model bundle), -r: evaluate only the rows [first, last) of the data file
+ * (the data file is read via its index (datafile.idx), which is created if it does not exist, see datindex)
+ * If there is a decorrelation transform next to the weight file (weightfile.decor, see fbdt-train -d), the inputs are decorrelated with it
+ * -V: use only the rows that pass filter (0-9, see RootToolBox::passVXDFilter), needs the VXD filter index (datafile.vxd)
+ */
 int main(int argc, char* argv[])
 {
-  if(argc < 3) {
-    std::cerr << "need a .xml file, a data file! (in this order)" << std::endl;
+  unsigned nThreads = 0;
+  uint64_t rowBegin = 0, rowEnd = std::numeric_limits<uint64_t>::max();
+  int vxdFilter = -1;
+  int opt;
+  while((opt = getopt(argc, argv, "j:r:V:")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = atoi(optarg); break;
+    case 'r':
+      if(!datfile::parseRowRange(optarg, rowBegin, rowEnd)) {
+        std::cerr << "invalid row range " << optarg << " (expected first:last)" << std::endl;
+        return 1;
+      }
+      break;
+    case 'V':
+      vxdFilter = atoi(optarg);
+      if(vxdFilter < 0 || unsigned(vxdFilter) >= RootToolBox::c_nVXDFilters) {
+        std::cerr << "invalid VXD filter " << optarg << " (expected 0 to " << RootToolBox::c_nVXDFilters - 1 << ")" << std::endl;
+        return 1;
+      }
+      break;
+    default:
+      std::cerr << "usage: " << argv[0] << " [-j nThreads] [-r first:last] [-V filter] weightfile datafile outputfile" << std::endl;
+      return 1;
+    }
+  }
+  argc -= optind - 1; // the positional arguments are handled as before
+  argv += optind - 1;
+
+  if(argc < 4) {
+    std::cerr << "need a .xml file, a data file and an output file! (in this order)" << std::endl;
     return 1;
   }
 
+  TT_PROFILE_SCOPE("fbdt-eval");
+  if(fbdtbundle::isBundle(argv[1])) return evaluateBundle(argv[1], argv[2], argv[3], rowBegin, rowEnd, vxdFilter, nThreads);
+
   TicTocTimer timer(1000000); // want ms
   // read in .xml file and construct FastBDT::Forest from it
   std::fstream weights(argv[1], std::fstream::in);
   std::cout << "reading in weight file ... " << std::flush;
   timer.tic();
+  ScopedTimer readWeightsScope("read_weights");
+  MemoryStage readWeightsMemory;
   FBDT_Reader reader(weights);
   Forest fbdt = reader.getFastBDT();
   std::vector<FeatureBinning<double> > featBins = reader.getFeatureBinnings();
   weights.close();
   timer.toc();
-  std::cout << "DONE. " << timer << std::endl;
+  readWeightsScope.stop();
+  std::cout << "DONE. " << timer << " " << readWeightsMemory << std::endl;
 
   size_t nInputs = featBins.size();
   // read in data and pass it to the fbdt to be analyzed
-  std::fstream datafs(argv[2], std::fstream::in);
-  std::string line;
   std::cout << "reading in data ... " << std::flush;
   timer.tic();
-  std::vector<std::vector<unsigned> > data;
-  while(std::getline(datafs, line)) {
-    if(line.empty()) break;
-    std::stringstream sin{line};
-    std::vector<unsigned> bins(nInputs);
+  ScopedTimer readDataScope("read_data");
+  MemoryStage readDataMemory;
+  datfile::DatReader datreader(argv[2]);
+  if(!datreader.good()) return 1;
+  const size_t nColumns = datreader.getNColumns();
+  if(nColumns < nInputs) {
+    std::cerr << "data file has only " << nColumns << " columns, but the FastBDT needs " << nInputs << " inputs" << std::endl;
+    return 1;
+  }
+  std::vector<double> values; // row-major
+  datreader.readRowsParallel(rowBegin, rowEnd, values, nThreads);
+  if(vxdFilter >= 0) {
+    RootToolBox::VXDFilterIndex vxdIndex;
+    if(!datfile::loadVXDFilterIndex(argv[2], datreader.getNRows(), vxdIndex)) return 1;
+    datfile::applyVXDFilter(vxdIndex, vxdFilter, rowBegin, nColumns, values);
+  }
+  if(!applyDecorrelation(argv[1], values, nColumns, nThreads)) return 1;
+  std::vector<std::vector<unsigned> > data(values.size() / nColumns, std::vector<unsigned>(nInputs));
+  PerfRegion binningPerf("FeatureBinning::ValueToBin", data.size() * nInputs, "value");
+  for(size_t iE = 0; iE < data.size(); ++iE) {
     for(size_t i = 0; i < nInputs; ++i) {
-      double val;
-      sin >> val;
-      bins[i] = featBins[i].ValueToBin(val);
+      data[iE][i] = featBins[i].ValueToBin(values[iE * nColumns + i]);
     }
-    data.push_back(bins);
   }
+  binningPerf.stop();
   timer.toc();
-  std::cout << "DONE. " << timer << std::endl;
+  readDataScope.stop();
+  std::cout << "DONE. " << timer << " " << readDataMemory << std::endl;
 
   std::vector<double> outputs;
   outputs.reserve(data.size());
   std::cout << "evaluating data ... " << std::flush;
   timer.tic();
+  ScopedTimer evaluateScope("evaluate");
+  MemoryStage evaluateMemory;
+  PerfRegion evaluatePerf("Forest::Analyse", data.size(), "sample");
   for(const auto& bins: data) {
     outputs.push_back(fbdt.Analyse(bins));
   }
+  evaluatePerf.stop();
   timer.toc();
-  std::cout << "DONE. " << timer << std::endl;
+  evaluateScope.stop();
+  std::cout << "DONE. " << timer << " " << evaluateMemory << std::endl;
 
   std::fstream outfs(argv[3], std::fstream::out);
   std::cout << "writing output data ... " << std::flush;
   timer.tic();
+  ScopedTimer writeScope("write");
+  MemoryStage writeMemory;
   for (const double& val : outputs) { outfs << val << std::endl; }
   timer.toc();
-  std::cout << "DONE. " << timer << std::endl;
+  writeScope.stop();
+  std::cout << "DONE. " << timer << " " << writeMemory << std::endl;
 
   return 0;
 }
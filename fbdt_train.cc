@@ -1,12 +1,25 @@
 #include "FBDT.h"
 #include "FBDT_Writer.h"
 #include "tt_timer.h"
+#include "tt_profiler.h"
+#include "tt_perfcounters.h"
+#include "tt_memory.h"
+#include "datreader.h"
+#include "vxdfilter.h"
+#include "fbdt_bundle.h"
+#include "decorrelation.h"
+#include "parallel_helper.h"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// getopt
+#include <unistd.h>
 
 // timing
 #include <chrono>
@@ -16,8 +29,165 @@ using std::chrono::high_resolution_clock;
 using std::chrono::duration_cast;
 using namespace timing;
 
+/** number of inputs of the FastBDT (CAUTION: hardcoded to take only the first 9 columns as inputs) */
+const size_t nInputs = 9;
+
+/**
+ * train a FastBDT on the rows @param rows of data (row-major, nColumns values per row, truth in the last column) in the same way
+ * as the unpartitioned training in main and return its weight file
+ */
+std::string trainForest(const std::vector<double>& data, size_t nColumns, const std::vector<size_t>& rows, int nTrees, int depth)
+{
+  std::vector<FeatureBinning<double> > featBins;
+  std::vector<double> feature(rows.size());
+  for(size_t iF = 0; iF < nInputs; ++iF) {
+    for(size_t iE = 0; iE < rows.size(); ++iE) feature[iE] = data[rows[iE] * nColumns + iF];
+    featBins.push_back(FeatureBinning<double>(8, feature.begin(), feature.end()));
+  }
+
+  EventSample eventSamp(rows.size(), nInputs, 8);
+  std::vector<unsigned> bins(nInputs);
+  for(size_t row : rows) {
+    const double* event = &data[row * nColumns];
+    for(size_t iF = 0; iF < nInputs; ++iF) bins[iF] = featBins[iF].ValueToBin(event[iF]);
+    eventSamp.AddEvent(bins, 1.0, int(event[nColumns - 1]) == 1);
+  }
+
+  ForestBuilder fbdt(eventSamp, nTrees, 0.15, 0.5, depth);
+  std::ostringstream weights;
+  FBDT_Writer writer(weights);
+  writer.writeToFile(fbdt, featBins);
+  return weights.str();
+}
+
+/**
+ * partitioned training: one FastBDT for every sensor combination (vxdids of the three hits, see get_sensor_combis.m) with at least
+ * minSamples samples and a fallback FastBDT for all other samples (incl. the samples with invalid vxdids, for all samples if there are
+ * none), trained in parallel and written to one model bundle (see fbdt_bundle.h)
+ */
+int trainPartitioned(const std::vector<double>& data, size_t nColumns, size_t minSamples, int nTrees, int depth, unsigned nThreads,
+                     std::string outputfilename)
+{
+  TicTocTimer timer(1000000); // want ms
+  const size_t nEvents = data.size() / nColumns;
+  std::cout << "partitioning samples by sensor combination ... " << std::flush;
+  ScopedTimer partitionScope("partition");
+  std::unordered_map<uint64_t, std::vector<size_t> > combinations;
+  for(size_t iE = 0; iE < nEvents; ++iE) combinations[fbdtbundle::getSensorCombination(&data[iE * nColumns])].push_back(iE);
+
+  std::vector<fbdtbundle::BundleModel> models;
+  std::vector<std::vector<size_t> > modelRows;
+  std::vector<size_t> fallbackRows;
+  std::vector<uint64_t> keys;
+  for(const auto& combination : combinations) keys.push_back(combination.first);
+  std::sort(keys.begin(), keys.end()); // same bundle for the same data
+  for(uint64_t key : keys) {
+    std::vector<size_t>& rows = combinations[key];
+    if(key != fbdtbundle::c_invalidCombination && rows.size() >= minSamples) {
+      models.push_back(fbdtbundle::BundleModel());
+      models.back().combination = key;
+      modelRows.push_back(std::vector<size_t>());
+      modelRows.back().swap(rows);
+    } else {
+      fallbackRows.insert(fallbackRows.end(), rows.begin(), rows.end());
+    }
+  }
+  const size_t nRest = fallbackRows.size();
+  if(fallbackRows.empty()) {
+    fallbackRows.resize(nEvents);
+    for(size_t iE = 0; iE < nEvents; ++iE) fallbackRows[iE] = iE;
+  }
+  std::sort(fallbackRows.begin(), fallbackRows.end()); // keep the order of the file (as for the other models)
+  models.push_back(fbdtbundle::BundleModel());
+  models.back().fallback = true;
+  modelRows.push_back(fallbackRows);
+  partitionScope.stop();
+  std::cout << "DONE. " << combinations.size() << " combinations, " << models.size() - 1 << " with at least " << minSamples
+            << " samples, " << nRest << " samples in the other combinations. " << timer << std::endl;
+  auto invalid = combinations.find(fbdtbundle::c_invalidCombination);
+  if(invalid != combinations.end()) {
+    std::cerr << "WARNING: " << invalid->second.size() << " samples have invalid vxdids, they are used for the fallback" << std::endl;
+  }
+
+  // largest models first, such that the threads finish at about the same time
+  std::vector<size_t> order(models.size());
+  for(size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return modelRows[a].size() > modelRows[b].size(); });
+
+  std::cout << "training " << models.size() << " FastBDTs ... " << std::flush;
+  timer.tic();
+  ScopedTimer trainScope("train");
+  MemoryStage trainMemory;
+  PerfRegion trainPerf("ForestBuilder (partitioned)", uint64_t(nEvents + fallbackRows.size()) * nTrees, "sample * tree");
+  parallel::parallelForEach(models.size(), parallel::getNThreads(nThreads), [&](size_t i, unsigned) {
+      PerfThreadScope perf(trainPerf);
+      fbdtbundle::BundleModel& model = models[order[i]];
+      model.nSamples = modelRows[order[i]].size();
+      model.weights = trainForest(data, nColumns, modelRows[order[i]], nTrees, depth);
+    });
+  trainPerf.stop();
+  trainScope.stop();
+  std::cout << "DONE. " << timer << " " << trainMemory << std::endl;
+
+  std::cout << "writing model bundle ... " << std::flush;
+  timer.tic();
+  ScopedTimer writeScope("write");
+  std::ofstream outfile(outputfilename.c_str(), std::ofstream::binary);
+  if(!fbdtbundle::writeBundle(outfile, models)) {
+    std::cerr << "ERROR: could not write " << outputfilename << std::endl;
+    return 1;
+  }
+  outfile.close();
+  writeScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+  return 0;
+}
+
+/**
+ * usage: fbdt-train [-j nThreads] [-r first:last] [-V filter] [-p minSamples] [-d] datafile [outputfile [nTrees [depth]]]
+ * -j: number of threads used for reading the data file (and training with -p), -r: use only the rows [first, last) of the data file
+ * (the data file is read via its index (datafile.idx), which is created if it does not exist, see datindex)
+ * -p: partitioned training, one FastBDT per sensor combination with at least minSamples samples and one for the rest, trained
+ *     in parallel on -j threads and stored in one model bundle (needs the vxdids in the data file, i.e. the full output of root2dat)
+ * -d: decorrelate the inputs before the training (as decorrelate.m, transform computed from the training data) and store the
+ *     transform next to the weight file (outputfile.decor), from where fbdt-eval takes it
+ * -V: use only the rows that pass filter (0-9, see RootToolBox::passVXDFilter), needs the VXD filter index (datafile.vxd)
+ */
 int main(int argc, char* argv[])
 {
+  unsigned nThreads = 0;
+  uint64_t rowBegin = 0, rowEnd = std::numeric_limits<uint64_t>::max();
+  int vxdFilter = -1;
+  size_t minSamples = 0;
+  bool decorrelate = false;
+  int opt;
+  while((opt = getopt(argc, argv, "j:r:V:p:d")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = atoi(optarg); break;
+    case 'r':
+      if(!datfile::parseRowRange(optarg, rowBegin, rowEnd)) {
+        std::cerr << "invalid row range " << optarg << " (expected first:last)" << std::endl;
+        return 1;
+      }
+      break;
+    case 'V':
+      vxdFilter = atoi(optarg);
+      if(vxdFilter < 0 || unsigned(vxdFilter) >= RootToolBox::c_nVXDFilters) {
+        std::cerr << "invalid VXD filter " << optarg << " (expected 0 to " << RootToolBox::c_nVXDFilters - 1 << ")" << std::endl;
+        return 1;
+      }
+      break;
+    case 'p': minSamples = std::max(1L, atol(optarg)); break;
+    case 'd': decorrelate = true; break;
+    default:
+      std::cerr << "usage: " << argv[0] << " [-j nThreads] [-r first:last] [-V filter] [-p minSamples] [-d] datafile [outputfile [nTrees [depth]]]"
+                << std::endl;
+      return 1;
+    }
+  }
+  argc -= optind - 1; // the positional arguments are handled as before
+  argv += optind - 1;
+
   if(argc <= 1) {
     std::cerr << "Need a data file" << std::endl;
     return 1;
@@ -37,62 +207,123 @@ int main(int argc, char* argv[])
     if(d > 0) depth = d;
   }
 
+  TT_PROFILE_SCOPE("fbdt-train");
   TicTocTimer timer(1000000); // measure time in ms
 
-  std::fstream datastr(argv[1], std::fstream::in);
-  std::string line;
-  std::vector<std::vector<double> > data;
   std::cout << "reading training data ... " << std::flush;
   timer.tic();
-  while(std::getline(datastr, line)) {
-    std::stringstream ins{line};
-    double val = 0;
-    std::vector<double> row;
-    while(ins >> val) {
-      row.push_back(val);
+  ScopedTimer readScope("read");
+  MemoryStage readMemory;
+  datfile::DatReader datreader(argv[1]);
+  if(!datreader.good()) return 1;
+  std::vector<double> data; // row-major
+  size_t nBad = datreader.readRowsParallel(rowBegin, rowEnd, data, nThreads);
+  const size_t nColumns = datreader.getNColumns();
+  if(vxdFilter >= 0) {
+    RootToolBox::VXDFilterIndex vxdIndex;
+    if(!datfile::loadVXDFilterIndex(argv[1], datreader.getNRows(), vxdIndex)) return 1;
+    datfile::applyVXDFilter(vxdIndex, vxdFilter, rowBegin, nColumns, data);
+  }
+  const size_t nEvents = nColumns ? data.size() / nColumns : 0;
+  readScope.stop();
+  std::cout << "DONE. " << timer << " " << readMemory << std::endl; // automatically calls toc on the timer
+  if(nBad) std::cerr << "WARNING: " << nBad << " rows do not have " << nColumns << " values" << std::endl;
+  if(nEvents == 0 || nColumns < 10) {
+    std::cerr << "Need at least one row with 9 inputs and the truth in the data file" << std::endl;
+    return 1;
+  }
+
+  if(decorrelate) {
+    std::cout << "decorrelating inputs ... " << std::flush;
+    timer.tic();
+    ScopedTimer decorrelateScope("decorrelate");
+    decorrelation::DecorrelationTransform transform;
+    if(!transform.compute(decorrelation::computeCovariance(data.data(), nEvents, nColumns, nInputs, nThreads))) {
+      std::cerr << "ERROR: the covariance matrix of the inputs is not positive definite" << std::endl;
+      return 1;
     }
-    data.push_back(row);
+    PerfRegion decorrelatePerf("DecorrelationTransform::apply", nEvents, "sample");
+    parallel::parallelFor(nEvents, parallel::getNThreads(nThreads), [&](size_t first, size_t last, unsigned) {
+        PerfThreadScope perf(decorrelatePerf);
+        transform.apply(data.data() + first * nColumns, last - first, nColumns);
+      });
+    decorrelatePerf.stop();
+    const std::string transformfile = decorrelation::DecorrelationTransform::getSidecarName(outputfilename);
+    if(!transform.write(transformfile)) {
+      std::cerr << "ERROR: could not write " << transformfile << std::endl;
+      return 1;
+    }
+    decorrelateScope.stop();
+    std::cout << "DONE. " << timer << " (transform in " << transformfile << ")" << std::endl;
+  } else {
+    // a transform of an earlier training would be picked up by fbdt-eval
+    remove(decorrelation::DecorrelationTransform::getSidecarName(outputfilename).c_str());
+  }
+
+  if(minSamples > 0) {
+    if(nColumns < fbdtbundle::c_vxdidColumn + 4) {
+      std::cerr << "Need the vxdids (columns " << fbdtbundle::c_vxdidColumn + 1 << " to " << fbdtbundle::c_vxdidColumn + 3
+                << ") in the data file for the partitioned training" << std::endl;
+      return 1;
+    }
+    return trainPartitioned(data, nColumns, minSamples, nTrees, depth, nThreads, outputfilename);
   }
-  std::cout << "DONE. " << timer << std::endl; // automatically calls toc on the timer
 
   std::cout << "creating FeatureBinnings ... " << std::flush;
   timer.tic();
+  ScopedTimer binningScope("binning");
+  MemoryStage binningMemory;
   std::vector<FeatureBinning<double> > featBins;
-  for(size_t iF = 0; iF < 9; ++iF) { // CAUTION: hardcoded to take only the first 9 arguments as inputs
-    std::vector<double> feature;
-    for(auto& event: data) {
-      feature.push_back( event[iF] );
+  std::vector<double> feature(nEvents);
+  for(size_t iF = 0; iF < nInputs; ++iF) { // CAUTION: hardcoded to take only the first 9 arguments as inputs
+    for(size_t iE = 0; iE < nEvents; ++iE) {
+      feature[iE] = data[iE * nColumns + iF];
     }
     featBins.push_back(FeatureBinning<double>(8, feature.begin(), feature.end() ));
   }
-  std::cout << "DONE. " << timer << std::endl;
+  binningScope.stop();
+  std::cout << "DONE. " << timer << " " << binningMemory << std::endl;
 
   std::cout << "creating EventSamples ... " << std::flush;
   timer.tic();
-  EventSample eventSamp(data.size(), data[0].size() -1, 8); // 8 bins in FeatureBinning so nLevel = 8 ?
-  for(auto& event: data) {
-    bool signal = int(event.back()) == 1;
-    std::vector<unsigned> bins(9);
+  ScopedTimer eventsampleScope("eventsample");
+  MemoryStage eventsampleMemory;
+  EventSample eventSamp(nEvents, nColumns -1, 8); // 8 bins in FeatureBinning so nLevel = 8 ?
+  std::vector<unsigned> bins(9);
+  PerfRegion eventsamplePerf("EventSample (incl. FeatureBinning::ValueToBin)", nEvents, "sample");
+  for(size_t iE = 0; iE < nEvents; ++iE) {
+    const double* event = &data[iE * nColumns];
+    bool signal = int(event[nColumns - 1]) == 1;
     for(size_t iF = 0; iF < 9; ++iF) {
       bins[iF] = featBins[iF].ValueToBin( event[iF] );
     }
 
     eventSamp.AddEvent(bins, 1.0, signal);
   };
-  std::cout << "DONE. " << timer << std::endl;
+  eventsamplePerf.stop();
+  eventsampleScope.stop();
+  std::cout << "DONE. " << timer << " " << eventsampleMemory << std::endl;
 
   std::cout << "training FastBDT ...  " << std::flush;
   timer.tic();
+  ScopedTimer trainScope("train");
+  MemoryStage trainMemory;
+  PerfRegion trainPerf("ForestBuilder", uint64_t(nEvents) * nTrees, "sample * tree");
   ForestBuilder fbdt(eventSamp, nTrees, 0.15, 0.5, depth);
-  std::cout << "DONE. " << timer << std::endl;
+  trainPerf.stop();
+  trainScope.stop();
+  std::cout << "DONE. " << timer << " " << trainMemory << std::endl;
 
   std::cout << "writing XML file ... " << std::flush;
   timer.tic();
+  ScopedTimer writeScope("write");
+  MemoryStage writeMemory;
   std::fstream treexml(outputfilename.c_str(), std::fstream::out);
   FBDT_Writer writer(treexml);
   writer.writeToFile(fbdt, featBins);
   treexml.close();
-  std::cout << "DONE. " << timer << std::endl;
+  writeScope.stop();
+  std::cout << "DONE. " << timer << " " << writeMemory << std::endl;
 
   return 0;
 }
@@ -0,0 +1,98 @@
+// small benchmark comparing the serial and the parallel data fetching of the RootToolBox
+// (RootFileData::fetchData vs. RootFileData::fetchDataParallel)
+//
+// by Thomas Madlener, 2015
+
+// stl
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// ROOT toolbox
+#include "RootToolBox/RootFileData.hpp"
+#include "RootToolBox/RootTreeData.hpp"
+
+#include "tt_timer.h"
+
+using namespace std;
+using namespace RootToolBox;
+using namespace timing;
+
+/** check if the data of the branch with name @param name are the same in both trees */
+template<typename T>
+bool compareBranch(const RootTreeData& serial, const RootTreeData& parallel, std::string name)
+{
+  const std::vector<T>& sData = serial.getBranchData<T>(name)->getData();
+  const std::vector<T>& pData = parallel.getBranchData<T>(name)->getData();
+  if(sData != pData) {
+    cout << "ERROR: data of branch " << name << " differ! (serial: " << sData.size() << " values, parallel: " << pData.size() << " values)" << endl;
+    return false;
+  }
+  return true;
+}
+
+/** compare the data of all branches in the two trees */
+bool compareTrees(const RootTreeData& serial, const RootTreeData& parallel)
+{
+  bool same = true;
+  for(const RootBranch& branch : serial.getBranches()) {
+    std::string name = branch.getName();
+    switch(serial.getDataType(name)) {
+    case c_double: same &= compareBranch<double>(serial, parallel, name); break;
+    case c_int: same &= compareBranch<int>(serial, parallel, name); break;
+    case c_uint: same &= compareBranch<unsigned int>(serial, parallel, name); break;
+    case c_usint: same &= compareBranch<unsigned short int>(serial, parallel, name); break;
+    default: break;
+    }
+  }
+  return same;
+}
+
+#ifndef __CINT__
+/**
+ * main routine:
+ * first argument is the root file (e.g. with a ThreeHitSamplesTree), second (optional) the number of threads to use
+ */
+int main(int argc, char* argv[])
+{
+  if(argc < 2) {
+    cout << "please provide a root file (and optionally the number of threads)" << endl;
+    return -1;
+  }
+  unsigned nThreads = 0;
+  if(argc >= 3) {
+    int n = atoi(argv[2]);
+    if(n > 0) nThreads = n;
+  }
+
+  TicTocTimer timer(1000000); // want ms
+
+  RootFileData serialFile(argv[1]);
+  timer.tic();
+  serialFile.fetchData();
+  timer.toc();
+  const double serialTime = timer.time();
+  cout << "serial fetching: " << timer << endl;
+
+  RootFileData parallelFile(argv[1]);
+  timer.tic();
+  parallelFile.fetchDataParallel(nThreads);
+  timer.toc();
+  const double parallelTime = timer.time();
+  cout << "parallel fetching: " << timer << endl;
+
+  bool same = true;
+  for(size_t i = 0; i < serialFile.getNTrees(); ++i) {
+    same &= compareTrees(serialFile.getTreeData((int) i), parallelFile.getTreeData((int) i));
+  }
+
+  cout << "speedup: " << (parallelTime > 0 ? serialTime / parallelTime : 0) << endl;
+  if(!same) {
+    cout << "ERROR: serial and parallel fetching do not give the same data!" << endl;
+    return 1;
+  }
+
+  return 0;
+}
+#endif
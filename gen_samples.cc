@@ -0,0 +1,600 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// generator of synthetic samples with the layout of the ThreeHitSamplesTree, for scaling tests of the tools on machines     //
+// where no production files are available.                                                                                  //
+//                                                                                                                           //
+// Tracks (pions, kaons, protons, electrons, muons with charge, pT, theta and phi) are propagated as helices from the        //
+// interaction point through the six VXD layers (1.5 T), the hits are smeared with the resolution of the layer and get the   //
+// vxdid (layer, ladder, sensor in raw format, i.e. within the VXDRANGE of filter_vxdid.m) of the sensor they are on.        //
+// - signal: three hits of the same track on subsequent layers it crosses (mostly consecutive layers, gaps where the track    //
+//   misses a sensor)                                                                                                        //
+// - background: combinatorial, hits of different tracks (or two of the same and one of another track), mostly on           //
+//   consecutive layers, but also with gaps or two hits on the same layer                                                   //
+// pT, momentum, charge and pdg are the ones of the track of the (innermost) first hit.                                     //
+//                                                                                                                           //
+// The samples are generated in chunks, every chunk with its own random number stream (seeded from the seed and the index   //
+// of the chunk), and written in order, so that the output only depends on the seed (and chunk size), not on the number of   //
+// threads.                                                                                                                  //
+//                                                                                                                           //
+// by Thomas Madlener, 2015                                                                                                  //
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+// getopt
+#include <unistd.h>
+
+#ifdef WITH_ROOT
+// ROOT
+#include "TFile.h"
+#include "TTree.h"
+#endif
+
+#include "parallel_helper.h"
+#include "datformat.h"
+#include "samplechunk.h"
+#include "vxdfilter.h"
+#include "RootToolBox/RootColumnCache.hpp"
+#include "tt_timer.h"
+#include "tt_profiler.h"
+#include "tt_memory.h"
+
+using namespace std;
+using namespace timing;
+
+/** default number of samples per chunk (NOTE: the generated samples depend on it) */
+const size_t defaultChunkSamples = 1 << 14;
+
+/** default number of samples per entry of the tree in the ROOT output (same as in dat2root) */
+const size_t defaultSamplesPerEntry = 100;
+
+/** magnetic field in T */
+const double c_bField = 1.5;
+
+/** geometry of a VXD layer */
+struct VXDLayer {
+  double radius; /**< radius in cm */
+  double halfLength; /**< half length of the sensitive area in z in cm */
+  double resolution; /**< hit resolution in cm */
+  unsigned nLadders; /**< number of ladders */
+  unsigned nSensors; /**< number of sensors per ladder */
+};
+
+/**
+ * (simplified) geometry of the six layers: cylinders, the ladders divide phi, the sensors z into equal parts. The numbers of ladders
+ * and sensors give the upper edges of RootToolBox::c_vxdRange (i.e. VXDRANGE in filter_vxdid.m)
+ */
+const VXDLayer c_layers[RootToolBox::c_nVXDLayers] = {
+  { 1.42, 4.5, 0.001, 8, 2 }, { 2.2, 6.2, 0.001, 12, 2 }, { 3.9, 6.5, 0.003, 7, 2 },
+  { 8.0, 12.5, 0.003, 10, 3 }, { 10.4, 16.5, 0.003, 12, 4 }, { 13.5, 21.5, 0.003, 16, 5 }
+};
+
+/**
+ * xoshiro256** random number generator. Own implementation (instead of the std::random engines and distributions) such that the
+ * samples are the same with every compiler and standard library
+ */
+class SampleRNG {
+public:
+  /** ctor: independent stream @param stream for the seed @param seed (state initialized with splitmix64) */
+  SampleRNG(uint64_t seed, uint64_t stream)
+  {
+    uint64_t x = seed ^ (stream * 0x9e3779b97f4a7c15ULL);
+    for(uint64_t& s : m_state) {
+      x += 0x9e3779b97f4a7c15ULL;
+      uint64_t z = x;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      s = z ^ (z >> 31);
+    }
+  }
+
+  /** next 64 random bits */
+  uint64_t next()
+  {
+    const uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+    const uint64_t t = m_state[1] << 17;
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+    m_state[2] ^= t;
+    m_state[3] = rotl(m_state[3], 45);
+    return result;
+  }
+
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); } /**< uniform in [0, 1) */
+
+  double uniform(double a, double b) { return a + (b - a) * uniform(); } /**< uniform in [a, b) */
+
+  unsigned integer(unsigned n) { return unsigned(uniform() * n); } /**< uniform integer in [0, n) */
+
+  /** standard normal (Box-Muller, without caching the second value) */
+  double gauss() { return std::sqrt(-2 * std::log(1 - uniform())) * std::cos(2 * M_PI * uniform()); }
+
+private:
+  uint64_t m_state[4]; /**< the state */
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+/** a hit on a layer */
+struct Hit {
+  double x, y, z; /**< position in cm */
+  unsigned vxdid; /**< vxdid in raw format */
+};
+
+/** a track with its hits */
+struct Track {
+  double pT; /**< transverse momentum in GeV */
+  double momentum; /**< momentum in GeV */
+  double charge; /**< charge */
+  int pdg; /**< pdg code */
+  std::array<Hit, RootToolBox::c_nVXDLayers> hits; /**< hit on every layer */
+  std::array<bool, RootToolBox::c_nVXDLayers> hasHit; /**< does the track cross the sensitive area of the layer */
+  unsigned nHits; /**< number of layers with a hit */
+};
+
+/** get the vxdid (raw format: layer << 13 | ladder << 8 | sensor << 5) of the sensor at the position on layer iLayer (0-based) */
+unsigned getVXDID(unsigned iLayer, double x, double y, double z)
+{
+  const VXDLayer& layer = c_layers[iLayer];
+  double phi = std::atan2(y, x);
+  if(phi < 0) phi += 2 * M_PI;
+  const unsigned ladder = std::min(layer.nLadders - 1, unsigned(phi / (2 * M_PI) * layer.nLadders)) + 1;
+  const double zFrac = std::max(0., std::min(1., (z + layer.halfLength) / (2 * layer.halfLength)));
+  const unsigned sensor = std::min(layer.nSensors - 1, unsigned(zFrac * layer.nSensors)) + 1;
+  return ((iLayer + 1) << 13) | (ladder << 8) | (sensor << 5);
+}
+
+/**
+ * generate a track from the interaction point and its (smeared) hits on all layers (helix in the magnetic field, no material
+ * effects). The hits are on the first half turn (i.e. curlers cross every layer only once)
+ */
+void generateTrack(SampleRNG& rng, Track& track)
+{
+  // particle species: pions, kaons, protons, electrons, muons
+  static const int pdgs[] = { 211, 321, 2212, 11, 13 };
+  static const double fractions[] = { 0.7, 0.1, 0.05, 0.1, 0.05 };
+  double u = rng.uniform();
+  size_t species = 0;
+  while(species < 4 && u >= fractions[species]) u -= fractions[species++];
+  track.charge = rng.uniform() < 0.5 ? -1 : 1;
+  const bool lepton = pdgs[species] < 100;
+  track.pdg = (lepton ? -1 : 1) * int(track.charge) * pdgs[species]; // e.g. 11 is the electron (negative), 211 is the pi+
+
+  track.pT = 0.05 - 0.35 * std::log(1 - rng.uniform()); // mostly low momentum tracks
+  const double theta = rng.uniform(17, 150) * M_PI / 180; // acceptance of the VXD
+  const double cotTheta = std::cos(theta) / std::sin(theta);
+  track.momentum = track.pT / std::sin(theta);
+  const double phi0 = rng.uniform(0, 2 * M_PI);
+  const double z0 = 0.5 * rng.gauss();
+
+  const double radius = track.pT / (0.3 * c_bField) * 100; // in cm
+  const double h = -track.charge; // direction of the rotation
+  track.nHits = 0;
+  for(unsigned iL = 0; iL < RootToolBox::c_nVXDLayers; ++iL) {
+    const VXDLayer& layer = c_layers[iL];
+    track.hasHit[iL] = false;
+    if(layer.radius > 2 * radius) continue; // curler does not reach the layer
+    const double s = 2 * radius * std::asin(layer.radius / (2 * radius)); // transverse arc length to the layer
+    const double phi = phi0 + h * s / radius;
+    Hit& hit = track.hits[iL];
+    hit.z = z0 + s * cotTheta;
+    if(std::abs(hit.z) > layer.halfLength) continue;
+    hit.x = radius * h * (std::sin(phi) - std::sin(phi0)) + layer.resolution * rng.gauss();
+    hit.y = -radius * h * (std::cos(phi) - std::cos(phi0)) + layer.resolution * rng.gauss();
+    hit.z += layer.resolution * rng.gauss();
+    hit.vxdid = getVXDID(iL, hit.x, hit.y, hit.z);
+    track.hasHit[iL] = true;
+    track.nHits++;
+  }
+}
+
+/** generate tracks until one has a hit on layer iLayer (or at least minHits hits if iLayer is negative) */
+void generateTrackWithHit(SampleRNG& rng, Track& track, int iLayer, unsigned minHits = 1)
+{
+  do {
+    generateTrack(rng, track);
+  } while(iLayer >= 0 ? !track.hasHit[iLayer] : track.nHits < minHits);
+}
+
+/** add a sample with the hits (inner to outer) and the track information of track to the chunk */
+void addSample(SampleChunk& chunk, const std::array<const Hit*, 3>& hits, const Track& track, bool signal)
+{
+  for(size_t iH = 0; iH < 3; ++iH) {
+    chunk.positions[3 * iH].push_back(hits[iH]->x);
+    chunk.positions[3 * iH + 1].push_back(hits[iH]->y);
+    chunk.positions[3 * iH + 2].push_back(hits[iH]->z);
+    chunk.vxdids[iH].push_back(hits[iH]->vxdid);
+  }
+  chunk.additionalInfo[0].push_back(track.pT);
+  chunk.additionalInfo[1].push_back(track.momentum);
+  chunk.additionalInfo[2].push_back(track.charge);
+  chunk.pdg.push_back(track.pdg);
+  chunk.signal.push_back(signal);
+}
+
+/** generate a signal sample: three hits of one track on subsequent layers it crosses */
+void generateSignal(SampleRNG& rng, SampleChunk& chunk, Track& track)
+{
+  generateTrackWithHit(rng, track, -1, 3);
+  std::vector<unsigned> layers;
+  for(unsigned iL = 0; iL < RootToolBox::c_nVXDLayers; ++iL) {
+    if(track.hasHit[iL]) layers.push_back(iL);
+  }
+  const unsigned first = rng.integer(layers.size() - 2);
+  addSample(chunk, { &track.hits[layers[first]], &track.hits[layers[first + 1]], &track.hits[layers[first + 2]] }, track, true);
+}
+
+/**
+ * generate a background sample: the layers are consecutive (70 %), have a gap (20 %) or two hits are on the same layer (10 %).
+ * The hits are from three different tracks (70 %) or two of them from the same track
+ */
+void generateBackground(SampleRNG& rng, SampleChunk& chunk, std::array<Track, 3>& tracks)
+{
+  const unsigned nLayers = RootToolBox::c_nVXDLayers;
+  std::array<unsigned, 3> layers;
+  const double pattern = rng.uniform();
+  if(pattern < 0.7) { // consecutive
+    layers[0] = rng.integer(nLayers - 2);
+    layers[1] = layers[0] + 1;
+    layers[2] = layers[0] + 2;
+  } else if(pattern < 0.9) { // three different layers, not all consecutive
+    do {
+      for(unsigned& layer : layers) layer = rng.integer(nLayers);
+      std::sort(layers.begin(), layers.end());
+    } while(layers[0] == layers[1] || layers[1] == layers[2] || layers[2] - layers[0] == 2);
+  } else { // two hits on the same layer (exactly two, else two hits of a track could be the same)
+    do {
+      for(unsigned& layer : layers) layer = rng.integer(nLayers);
+      std::sort(layers.begin(), layers.end());
+    } while((layers[0] == layers[1]) == (layers[1] == layers[2]));
+  }
+
+  const unsigned nTracks = rng.uniform() < 0.7 ? 3 : 2;
+  // (with two tracks) the hit that is from another track than the other two, which have to be on different layers
+  unsigned shared = rng.integer(3);
+  if(layers[0] == layers[1]) shared = rng.integer(2);
+  else if(layers[1] == layers[2]) shared = 1 + rng.integer(2);
+  std::array<const Hit*, 3> hits;
+  if(nTracks == 3) {
+    for(size_t iH = 0; iH < 3; ++iH) {
+      generateTrackWithHit(rng, tracks[iH], layers[iH]);
+      hits[iH] = &tracks[iH].hits[layers[iH]];
+    }
+  } else {
+    const unsigned a = shared == 0 ? 1 : 0, b = shared == 2 ? 1 : 2;
+    do {
+      generateTrackWithHit(rng, tracks[0], layers[a]);
+    } while(!tracks[0].hasHit[layers[b]]);
+    generateTrackWithHit(rng, tracks[1], layers[shared]);
+    hits[a] = &tracks[0].hits[layers[a]];
+    hits[b] = &tracks[0].hits[layers[b]];
+    hits[shared] = &tracks[1].hits[layers[shared]];
+  }
+  const Track& first = nTracks == 3 ? tracks[0] : (shared == 0 ? tracks[1] : tracks[0]);
+  addSample(chunk, hits, first, false);
+}
+
+/** generate the samples [first, first + n) of chunk iChunk */
+void generateChunk(uint64_t seed, uint64_t iChunk, size_t n, double signalFraction, SampleChunk& chunk)
+{
+  chunk.clear();
+  SampleRNG rng(seed, iChunk);
+  std::array<Track, 3> tracks;
+  for(size_t i = 0; i < n; ++i) {
+    if(rng.uniform() < signalFraction) generateSignal(rng, chunk, tracks[0]);
+    else generateBackground(rng, chunk, tracks);
+  }
+}
+
+/** a generated chunk and its formatted lines */
+struct GeneratedChunk {
+  SampleChunk samples; /**< the samples */
+  FormattedChunk formatted; /**< lines of the .dat file (only for the .dat output) */
+};
+
+/** writes the generated chunks (in order) to the output */
+class SampleWriter {
+public:
+  virtual ~SampleWriter() {}
+  virtual bool good() const = 0; /**< check if everything went fine so far */
+  virtual void write(const GeneratedChunk& chunk) = 0; /**< write a chunk */
+  virtual bool close() = 0; /**< finish the output. @returns false if something went wrong */
+};
+
+/** .dat file (same format as root2dat, with the topology codes and the VXD filter index if requested) */
+class DatWriter : public SampleWriter {
+public:
+  DatWriter(std::string filename, bool topology) :
+    m_filename(filename), m_file(fopen(filename.c_str(), "wb")), m_topology(topology), m_writeError(false)
+  {
+    if(!m_file) cout << "ERROR: could not open output file " << filename << endl;
+  }
+  ~DatWriter() { if(m_file) fclose(m_file); }
+
+  bool good() const override { return m_file != 0; }
+
+  void write(const GeneratedChunk& chunk) override
+  {
+    const std::string& buffer = chunk.formatted.buffer;
+    if(fwrite(buffer.data(), 1, buffer.size(), m_file) != buffer.size()) m_writeError = true;
+    for(unsigned code : chunk.formatted.topology) m_vxdIndex.add(code);
+  }
+
+  bool close() override
+  {
+    bool ok = fclose(m_file) == 0 && !m_writeError;
+    m_file = 0;
+    if(m_topology && !datfile::writeVXDFilterIndex(m_filename, m_vxdIndex)) {
+      cout << "ERROR: could not write VXD filter index " << RootToolBox::VXDFilterIndex::getSidecarName(m_filename) << endl;
+      ok = false;
+    }
+    if(!m_topology) datfile::removeVXDFilterIndex(m_filename); // would belong to an older version of the file
+    return ok;
+  }
+
+private:
+  std::string m_filename; /**< name of the file */
+  FILE* m_file; /**< the file */
+  bool m_topology; /**< write the VXD filter index */
+  bool m_writeError; /**< a write failed (e.g. the disk is full) */
+  RootToolBox::VXDFilterIndex m_vxdIndex; /**< the VXD filter index */
+};
+
+/**
+ * binary columnar output: one file per branch (prefix.branchname.col) with the raw values (native byte order), in the layout of the
+ * files of the RootColumnCache (header, tree and branch name, values starting at an aligned offset), such that they can be mmapped.
+ * The truth is stored as one byte per value (c_bool)
+ */
+class ColumnWriter : public SampleWriter {
+public:
+  ColumnWriter(std::string prefix);
+  ~ColumnWriter() { for(FILE* file : m_files) if(file) fclose(file); }
+
+  bool good() const override { return m_good; }
+
+  void write(const GeneratedChunk& chunk) override;
+
+  bool close() override;
+
+  /** name of the file of a branch */
+  static std::string getColumnFileName(std::string prefix, std::string branch) { return prefix + "." + branch + ".col"; }
+
+private:
+  std::vector<FILE*> m_files; /**< one file per branch (in the order of branchnames) */
+  std::vector<RootToolBox::CacheFileHeader> m_headers; /**< their headers */
+  std::vector<unsigned char> m_truth; /**< buffer for the truth values */
+  bool m_good; /**< could all files be opened (and written so far) */
+
+  /** write the values of a column to file iFile */
+  template<typename T>
+  void writeColumn(size_t iFile, const std::vector<T>& values)
+  {
+    if(fwrite(values.data(), sizeof(T), values.size(), m_files[iFile]) != values.size()) m_good = false;
+    m_headers[iFile].nValues += values.size();
+  }
+};
+
+ColumnWriter::ColumnWriter(std::string prefix) : m_good(true)
+{
+  for(size_t iB = 0; iB < branchnames.size(); ++iB) {
+    const std::string& branch = branchnames[iB];
+    RootToolBox::CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "RTBCOL01", 8);
+    if(branch == "truth") { header.dataType = RootToolBox::c_bool; header.valueSize = 1; }
+    else if(branch == "pdg") { header.dataType = RootToolBox::c_int; header.valueSize = sizeof(int); }
+    else if(branch.compare(0, 5, "vxdid") == 0) { header.dataType = RootToolBox::c_uint; header.valueSize = sizeof(unsigned); }
+    else { header.dataType = RootToolBox::c_double; header.valueSize = sizeof(double); }
+    header.treeLength = treename.size();
+    header.branchLength = branch.size();
+    const uint64_t namesEnd = sizeof(header) + treename.size() + branch.size();
+    header.dataOffset = (namesEnd + RootToolBox::c_cacheAlignment - 1) / RootToolBox::c_cacheAlignment * RootToolBox::c_cacheAlignment;
+    m_headers.push_back(header);
+
+    const std::string filename = getColumnFileName(prefix, branch);
+    m_files.push_back(fopen(filename.c_str(), "wb"));
+    if(!m_files.back()) {
+      cout << "ERROR: could not open output file " << filename << endl;
+      m_good = false;
+      continue;
+    }
+    std::vector<char> padding(header.dataOffset - namesEnd, 0);
+    fwrite(&header, sizeof(header), 1, m_files.back());
+    fwrite(treename.data(), 1, treename.size(), m_files.back());
+    fwrite(branch.data(), 1, branch.size(), m_files.back());
+    fwrite(padding.data(), 1, padding.size(), m_files.back());
+  }
+}
+
+void ColumnWriter::write(const GeneratedChunk& chunk)
+{
+  const SampleChunk& samples = chunk.samples;
+  for(size_t j = 0; j < npositions; ++j) writeColumn(j, samples.positions[j]);
+  m_truth.assign(samples.signal.begin(), samples.signal.end());
+  writeColumn(npositions, m_truth);
+  for(size_t j = 0; j < nvxdids; ++j) writeColumn(npositions + 1 + j, samples.vxdids[j]);
+  for(size_t j = 0; j < nadditional; ++j) writeColumn(npositions + 1 + nvxdids + j, samples.additionalInfo[j]);
+  writeColumn(branchnames.size() - 1, samples.pdg);
+}
+
+bool ColumnWriter::close()
+{
+  bool ok = m_good;
+  for(size_t iB = 0; iB < m_files.size(); ++iB) { // write the headers again with the number of values
+    ok &= fseek(m_files[iB], 0, SEEK_SET) == 0 && fwrite(&m_headers[iB], sizeof(m_headers[iB]), 1, m_files[iB]) == 1;
+    ok &= fclose(m_files[iB]) == 0;
+    m_files[iB] = 0;
+  }
+  return ok;
+}
+
+#ifdef WITH_ROOT
+/** ROOT file with the ThreeHitSamplesTree (vector branches, samplesPerEntry samples per entry, as read by root2dat) */
+class RootWriter : public SampleWriter {
+public:
+  RootWriter(std::string filename, size_t samplesPerEntry);
+  ~RootWriter() { if(m_file) close(); }
+
+  bool good() const override { return m_file != 0 && !m_file->IsZombie(); }
+
+  void write(const GeneratedChunk& chunk) override;
+
+  bool close() override;
+
+private:
+  TFile* m_file; /**< the file */
+  TTree* m_tree; /**< the tree (owned by the file) */
+  size_t m_samplesPerEntry; /**< number of samples per entry */
+  std::array<std::vector<double>, npositions> m_positions; /**< position branches */
+  std::vector<bool> m_signal; /**< truth branch */
+  std::array<std::vector<unsigned>, nvxdids> m_vxdids; /**< vxdid branches */
+  std::array<std::vector<double>, nadditional> m_additionalInfo; /**< pT, momentum, charge branches */
+  std::vector<int> m_pdg; /**< pdg branch */
+};
+
+RootWriter::RootWriter(std::string filename, size_t samplesPerEntry) :
+  m_file(new TFile(filename.c_str(), "recreate")), m_tree(0), m_samplesPerEntry(samplesPerEntry)
+{
+  if(m_file->IsZombie()) {
+    cout << "ERROR: could not open output file " << filename << endl;
+    return;
+  }
+  m_tree = new TTree(treename.c_str(), "synthetic three hit samples (gensamples)");
+  for(size_t j = 0; j < npositions; ++j) m_tree->Branch(branchnames[j].c_str(), &m_positions[j]);
+  m_tree->Branch(branchnames[npositions].c_str(), &m_signal);
+  for(size_t j = 0; j < nvxdids; ++j) m_tree->Branch(branchnames[npositions + 1 + j].c_str(), &m_vxdids[j]);
+  for(size_t j = 0; j < nadditional; ++j) m_tree->Branch(branchnames[npositions + 1 + nvxdids + j].c_str(), &m_additionalInfo[j]);
+  m_tree->Branch(branchnames.back().c_str(), &m_pdg);
+}
+
+void RootWriter::write(const GeneratedChunk& chunk)
+{
+  const SampleChunk& samples = chunk.samples;
+  for(size_t begin = 0; begin < samples.size(); begin += m_samplesPerEntry) {
+    const size_t end = std::min(samples.size(), begin + m_samplesPerEntry);
+    for(size_t j = 0; j < npositions; ++j) m_positions[j].assign(&samples.positions[j][begin], &samples.positions[j][end]);
+    m_signal.assign(samples.signal.begin() + begin, samples.signal.begin() + end);
+    for(size_t j = 0; j < nvxdids; ++j) m_vxdids[j].assign(&samples.vxdids[j][begin], &samples.vxdids[j][end]);
+    for(size_t j = 0; j < nadditional; ++j) m_additionalInfo[j].assign(&samples.additionalInfo[j][begin], &samples.additionalInfo[j][end]);
+    m_pdg.assign(&samples.pdg[begin], &samples.pdg[end]);
+    m_tree->Fill();
+  }
+}
+
+bool RootWriter::close()
+{
+  m_file->cd();
+  bool ok = m_tree->Write() > 0;
+  m_file->Close();
+  delete m_file; // also deletes the tree
+  m_file = 0;
+  return ok;
+}
+#endif
+
+/** check if filename ends with extension */
+bool hasExtension(const std::string& filename, const std::string& extension)
+{
+  return filename.size() > extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+#ifndef __CINT__
+/**
+ * main routine: gensamples [-j nThreads] [-n nSamples] [-s seed] [-f signalFraction] [-c chunkSamples] [-r] [-t] [-e samplesPerEntry]
+ *               outputfile
+ * -n: number of samples (default 1000000, e.g. 1e9 is accepted), -s: seed (default 1), -f: fraction of signal samples (default 0.5)
+ * -c: samples per chunk (default 16384, the samples depend on seed and chunk size only, not on the number of threads)
+ * the type of the output is determined from the extension of the outputfile:
+ * .dat: same format as root2dat (-r: full precision, -t: topology codes and VXD filter index (outputfile.vxd))
+ * .col: binary columnar, one file per branch (outputfile without .col + ".branchname.col")
+ * .root: ThreeHitSamplesTree with samplesPerEntry (-e, default 100) samples per entry (needs -DWITH_ROOT, see makefile)
+ */
+int main(int argc, char* argv[])
+{
+  unsigned nThreads = 0;
+  uint64_t nSamples = 1000000;
+  uint64_t seed = 1;
+  double signalFraction = 0.5;
+  size_t chunkSamples = defaultChunkSamples;
+  bool roundtrip = false;
+  bool topology = false;
+  size_t samplesPerEntry = defaultSamplesPerEntry;
+  int opt;
+  while((opt = getopt(argc, argv, "j:n:s:f:c:rte:")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = std::max(0, atoi(optarg)); break;
+    case 'n': nSamples = uint64_t(std::max(0., atof(optarg))); break;
+    case 's': seed = strtoull(optarg, 0, 10); break;
+    case 'f': signalFraction = std::max(0., std::min(1., atof(optarg))); break;
+    case 'c': chunkSamples = std::max(1L, atol(optarg)); break;
+    case 'r': roundtrip = true; break;
+    case 't': topology = true; break;
+    case 'e': samplesPerEntry = std::max(1L, atol(optarg)); break;
+    default:
+      cout << "usage: " << argv[0] << " [-j nThreads] [-n nSamples] [-s seed] [-f signalFraction] [-c chunkSamples] [-r] [-t]"
+           << " [-e samplesPerEntry] outputfile(.dat|.col|.root)" << endl;
+      return -1;
+    }
+  }
+  if(argc - optind != 1) {
+    cout << "please provide an output file name!" << endl;
+    return -1;
+  }
+  const std::string outfilename(argv[optind]);
+
+  std::unique_ptr<SampleWriter> writer;
+  bool format = false;
+  if(hasExtension(outfilename, ".col")) {
+    writer.reset(new ColumnWriter(outfilename.substr(0, outfilename.size() - 4)));
+  } else if(hasExtension(outfilename, ".root")) {
+#ifdef WITH_ROOT
+    writer.reset(new RootWriter(outfilename, samplesPerEntry));
+#else
+    (void) samplesPerEntry; // only used for the ROOT output
+    cout << "ERROR: ROOT output is not compiled in (-DWITH_ROOT)" << endl;
+    return -1;
+#endif
+  } else {
+    writer.reset(new DatWriter(outfilename, topology));
+    format = true;
+  }
+  if(!writer->good()) return -1;
+
+  TT_PROFILE_SCOPE("gensamples");
+  MemoryStage memory;
+  TicTocTimer timer(1000000); // want ms
+  // the producer only hands out the chunk indices, the workers generate (and format) the chunks and the consumer writes them in order
+  const uint64_t nChunks = (nSamples + chunkSamples - 1) / chunkSamples;
+  uint64_t nextChunk = 0, nWritten = 0, nSignal = 0;
+  parallel::OrderedPipeline<uint64_t, GeneratedChunk> pipeline(parallel::getNThreads(nThreads));
+  pipeline.run([&](uint64_t& iChunk) { iChunk = nextChunk; return nextChunk++ < nChunks; },
+               [&](uint64_t& iChunk, GeneratedChunk& chunk) {
+                 TT_PROFILE_SCOPE("generate_chunk");
+                 generateChunk(seed, iChunk, std::min<uint64_t>(chunkSamples, nSamples - iChunk * chunkSamples), signalFraction,
+                               chunk.samples);
+                 if(format) formatChunk(chunk.samples, chunk.formatted, roundtrip, topology);
+               },
+               [&](GeneratedChunk& chunk) {
+                 TT_PROFILE_SCOPE("write_chunk");
+                 nWritten += chunk.samples.size();
+                 nSignal += std::count(chunk.samples.signal.begin(), chunk.samples.signal.end(), true);
+                 writer->write(chunk);
+               });
+  const bool ok = writer->close();
+
+  cout << "wrote " << nWritten << " samples (" << nSignal << " signal) to " << outfilename << ". " << timer << " " << memory << endl;
+  if(!ok) cout << "ERROR: could not write " << outfilename << endl;
+  return ok ? 0 : -1;
+}
+#endif
@@ -0,0 +1,101 @@
+// small benchmark comparing the read throughput of the RootToolBox for different layouts of the same data
+// (e.g. vector branches vs. scalar branches, different compression algorithms, basket sizes, ...; see dat2root -h)
+// For every passed file the data are read twice:
+//   - RootFileData::fetchData (everything at once, without the on-disk cache)
+//   - RootChunkReader over the input branches of tmva_evaluation (Z0 ... Z8, chunk-wise)
+//
+// by Thomas Madlener, 2015
+
+// stl
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+// ROOT toolbox
+#include "RootToolBox/RootFile.hpp"
+#include "RootToolBox/RootFileData.hpp"
+#include "RootToolBox/RootTreeData.hpp"
+#include "RootToolBox/RootChunkReader.hpp"
+
+#include "tt_timer.h"
+
+using namespace std;
+using namespace RootToolBox;
+using namespace timing;
+
+/** number of events that are read from the tree at once by the RootChunkReader (same as in tmva_evaluation) */
+const int chunkSize = 1000;
+
+/** get the number of values of all branches in the tree data */
+size_t getNValues(const RootTreeData& treedata)
+{
+  size_t nValues = 0;
+  for(const RootBranch& branch : treedata.getBranches()) {
+    std::string name = branch.getName();
+    switch(treedata.getDataType(name)) {
+    case c_double: nValues += treedata.getBranchData<double>(name)->getData().size(); break;
+    case c_int: nValues += treedata.getBranchData<int>(name)->getData().size(); break;
+    case c_uint: nValues += treedata.getBranchData<unsigned int>(name)->getData().size(); break;
+    case c_usint: nValues += treedata.getBranchData<unsigned short int>(name)->getData().size(); break;
+    default: break;
+    }
+  }
+  return nValues;
+}
+
+/** get the size of a file in MB */
+double getFileSizeMB(const char* filename)
+{
+  struct stat st;
+  if(stat(filename, &st) != 0) return 0;
+  return st.st_size / 1e6;
+}
+
+#ifndef __CINT__
+/**
+ * main routine:
+ * arguments are the root files that shall be compared (all containing a testtree, e.g. created by dat2root from the same .dat file)
+ */
+int main(int argc, char* argv[])
+{
+  if(argc < 2) {
+    cout << "please provide at least one root file (containing a testtree)" << endl;
+    return -1;
+  }
+
+  std::vector<std::string> inputnames;
+  for(size_t i = 0; i < 9; ++i) inputnames.push_back("Z" + std::to_string(i)); // CAUTION: same as in tmva_evaluation
+
+  cout << std::setw(40) << "file" << std::setw(12) << "size [MB]" << std::setw(12) << "entries"
+       << std::setw(16) << "fetchData [ms]" << std::setw(14) << "[Mvalues/s]"
+       << std::setw(16) << "chunks [ms]" << std::setw(14) << "[Msamples/s]" << endl;
+
+  TicTocTimer timer(1000000); // want ms
+  for(int iFile = 1; iFile < argc; ++iFile) {
+    RootFileData filedata(argv[iFile]);
+    filedata.setUseCache(false);
+    timer.tic();
+    filedata.fetchData();
+    timer.toc();
+    const double fetchTime = timer.time();
+    size_t nValues = 0;
+    for(size_t i = 0; i < filedata.getNTrees(); ++i) nValues += getNValues(filedata.getTreeData((int) i));
+
+    RootFile file(argv[iFile]);
+    RootChunkReader reader(file, "testtree", inputnames, chunkSize);
+    size_t nSamples = 0;
+    timer.tic();
+    while(reader.next()) nSamples += reader.getNValues();
+    timer.toc();
+    const double chunkTime = timer.time();
+
+    cout << std::setw(40) << argv[iFile] << std::setw(12) << getFileSizeMB(argv[iFile]) << std::setw(12) << reader.getNEvents()
+         << std::setw(16) << fetchTime << std::setw(14) << (fetchTime > 0 ? nValues / fetchTime / 1e3 : 0)
+         << std::setw(16) << chunkTime << std::setw(14) << (chunkTime > 0 ? nSamples / chunkTime / 1e3 : 0) << endl;
+  }
+
+  return 0;
+}
+#endif
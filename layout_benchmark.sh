@@ -0,0 +1,48 @@
+#!/bin/bash
+# convert a .dat file with dat2root into different layouts / compression settings and compare the read throughput of
+# RootFileData and RootChunkReader (layoutbench) and optionally of the complete TMVA evaluation (evaltmva)
+#
+# usage: layout_benchmark.sh datfile [tmva weightfile]
+#
+# by Thomas Madlener, 2015
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 datfile [tmva weightfile]"
+    exit 1
+fi
+
+datfile=$1
+weightfile=$2
+outdir=$(mktemp -d layout_benchmark.XXXX)
+
+# name and dat2root options of the layouts that are compared
+layouts=(
+    "vector_zlib:-c zlib"
+    "vector_lz4:-c lz4"
+    "vector_zstd:-c zstd"
+    "scalar_zlib:-s -c zlib"
+    "scalar_lz4:-s -c lz4"
+    "scalar_zstd:-s -c zstd"
+    "scalar_lz4_b256k:-s -c lz4 -B 262144 -f -30000000"
+    "scalar_none:-s -c none"
+)
+
+files=()
+for layout in "${layouts[@]}"; do
+    name=${layout%%:*}
+    options=${layout#*:}
+    ./dat2root ${options} ${datfile} ${outdir}/${name}.root > /dev/null || exit 1
+    files+=(${outdir}/${name}.root)
+done
+
+./layoutbench ${files[@]}
+
+if [ -n "${weightfile}" ]; then
+    echo
+    echo "evaltmva (read / evaluation time):"
+    for file in ${files[@]}; do
+        echo "${file}: $(./evaltmva ${weightfile} ${file} /dev/null | grep duration | tr '\n' ' ')"
+    done
+fi
+
+echo "the converted files are in ${outdir}"
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <algorithm>
+
+#include <zlib.h>
+
+namespace matfile {
+
+  /** MAT-file (level 5) data types (only the ones used here) */
+  enum e_miTypes {
+    c_miINT8 = 1,
+    c_miINT32 = 5,
+    c_miUINT32 = 6,
+    c_miDOUBLE = 9,
+    c_miMATRIX = 14,
+    c_miCOMPRESSED = 15,
+  };
+
+  /** MAT-file array class of double matrices */
+  const uint32_t c_mxDOUBLE_CLASS = 6;
+
+  /**
+   * class that writes numeric (double) matrices to a MAT-file (version 5), such that they can be read in MATLAB via load.
+   * The matrices are written column by column (i.e. in MATLAB memory order) and can be streamed, i.e. they never have to be in memory
+   * as a whole. Every matrix can optionally be compressed (zlib, as MATLAB does with save -v7).
+   * usage:
+   *   MatFileWriter writer("out.mat");
+   *   writer.beginMatrix("data", 17, nSamples, true);
+   *   writer.append(values, 17 * nChunk); // as often as needed
+   *   writer.endMatrix();
+   * NOTE: the size of every matrix is limited to 2^32 bytes (format restriction of version 5 MAT-files)
+   */
+  class MatFileWriter {
+  public:
+    MatFileWriter(std::string filename); /**< ctor, opens the file and writes the header */
+    ~MatFileWriter(); /**< dtor, ends an unfinished matrix and closes the file */
+
+    bool good() const { return m_file != 0 && !m_error; } /**< check if everything went fine so far */
+
+    /**
+     * start a new (rows x cols) double matrix with name @param name.
+     * @returns false if the matrix is too large for a version 5 MAT-file (more than 2^31 - 1 rows or columns or more than 2^32 bytes)
+     */
+    bool beginMatrix(std::string name, uint64_t rows, uint64_t cols, bool compress);
+
+    /** append n values to the current matrix (column-major) */
+    void append(const double* values, size_t n);
+
+    /** finish the current matrix (if fewer values than rows * cols have been appended, the rest is filled with zeros) */
+    void endMatrix();
+
+  private:
+    FILE* m_file; /**< the output file */
+    bool m_error; /**< an error occured */
+    bool m_inMatrix; /**< a matrix has been started but not yet ended */
+    bool m_compress; /**< the current matrix is compressed */
+    uint64_t m_nExpected; /**< number of values in the current matrix */
+    uint64_t m_nWritten; /**< number of values appended to the current matrix */
+    long m_sizePos; /**< position of the size of the miCOMPRESSED element in the file */
+    uint64_t m_compressedSize; /**< number of compressed bytes written */
+    z_stream m_zstream; /**< zlib stream of the current matrix */
+    std::vector<unsigned char> m_zbuffer; /**< output buffer for the zlib stream */
+
+    void write(const void* data, size_t n); /**< write to the matrix (compressed or not) */
+
+    void writeFile(const void* data, size_t n); /**< write directly to the file */
+
+    void deflateBuffer(int flush); /**< run deflate on the current input and write the output to the file */
+
+    void writeTag(uint32_t type, uint32_t nBytes) { uint32_t tag[2] = {type, nBytes}; write(tag, sizeof(tag)); } /**< write a data element tag */
+  };
+
+  // ======================================================= CTOR / DTOR ==========================================================
+  inline MatFileWriter::MatFileWriter(std::string filename) :
+    m_file(fopen(filename.c_str(), "wb")), m_error(false), m_inMatrix(false), m_compress(false), m_nExpected(0), m_nWritten(0),
+    m_sizePos(0), m_compressedSize(0), m_zbuffer(1 << 20)
+  {
+    if(m_file == 0) {
+      std::cerr << "ERROR: could not open MAT-file " << filename << std::endl;
+      return;
+    }
+
+    // 116 bytes descriptive text, 8 bytes subsystem data offset, 2 bytes version, 2 bytes endian indicator
+    char header[128];
+    memset(header, ' ', 116);
+    time_t now = time(0);
+    char date[32];
+    strftime(date, sizeof(date), "%a %b %d %H:%M:%S %Y", localtime(&now));
+    std::string text = std::string("MATLAB 5.0 MAT-file, Platform: GLNXA64, Created on: ") + date + " by root2dat";
+    memcpy(header, text.data(), std::min<size_t>(text.size(), 116));
+    memset(header + 116, 0, 8);
+    uint16_t version = 0x0100;
+    memcpy(header + 124, &version, 2);
+    header[126] = 'I'; header[127] = 'M'; // written in native (little endian) byte order -> MATLAB reads "IM"
+    writeFile(header, sizeof(header));
+  }
+
+  inline MatFileWriter::~MatFileWriter()
+  {
+    if(m_inMatrix) endMatrix();
+    if(m_file) fclose(m_file);
+  }
+
+  // ======================================================= BEGIN MATRIX =========================================================
+  inline bool MatFileWriter::beginMatrix(std::string name, uint64_t rows, uint64_t cols, bool compress)
+  {
+    if(!good()) return false;
+    if(m_inMatrix) endMatrix();
+
+    if(rows > 0x7fffffffULL || cols > 0x7fffffffULL) { // the dimensions are stored as int32
+      std::cerr << "ERROR: matrix " << name << " (" << rows << "x" << cols << ") has too many rows or columns for a version 5 MAT-file. "
+                << "Split the data into several files!" << std::endl;
+      return false;
+    }
+    const uint64_t dataBytes = uint64_t(rows) * cols * sizeof(double);
+    const uint64_t nameBytes = name.size() <= 4 ? 0 : (name.size() + 7) / 8 * 8; // short names are packed into the tag
+    const uint64_t matrixBytes = 16 + 16 + 8 + nameBytes + 8 + dataBytes; // flags, dimensions, name tag (+ name), data tag + data
+    if(matrixBytes > 0xffffffffULL) {
+      std::cerr << "ERROR: matrix " << name << " (" << rows << "x" << cols << ") is too large for a version 5 MAT-file. "
+                << "Split the data into several files!" << std::endl;
+      return false;
+    }
+
+    m_inMatrix = true;
+    m_compress = compress;
+    m_nExpected = uint64_t(rows) * cols;
+    m_nWritten = 0;
+    if(m_compress) {
+      uint32_t tag[2] = {c_miCOMPRESSED, 0}; // size is patched in endMatrix
+      m_sizePos = ftell(m_file);
+      writeFile(tag, sizeof(tag));
+      m_compressedSize = 0;
+      memset(&m_zstream, 0, sizeof(m_zstream));
+      if(deflateInit(&m_zstream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        std::cerr << "ERROR: could not initialize zlib" << std::endl;
+        m_error = true;
+      }
+    }
+
+    writeTag(c_miMATRIX, matrixBytes);
+    writeTag(c_miUINT32, 8); // array flags
+    uint32_t flags[2] = {c_mxDOUBLE_CLASS, 0};
+    write(flags, sizeof(flags));
+    writeTag(c_miINT32, 8); // dimensions
+    int32_t dims[2] = {int32_t(rows), int32_t(cols)};
+    write(dims, sizeof(dims));
+    if(name.size() <= 4) { // small data element format
+      uint32_t tag = (uint32_t(name.size()) << 16) | c_miINT8;
+      char packed[4] = {0, 0, 0, 0};
+      memcpy(packed, name.data(), name.size());
+      write(&tag, sizeof(tag));
+      write(packed, sizeof(packed));
+    } else {
+      writeTag(c_miINT8, name.size());
+      std::vector<char> padded(nameBytes, 0);
+      memcpy(padded.data(), name.data(), name.size());
+      write(padded.data(), padded.size());
+    }
+    writeTag(c_miDOUBLE, dataBytes); // data are always a multiple of 8 bytes -> no padding needed
+
+    return good();
+  }
+
+  // ========================================================= APPEND =============================================================
+  inline void MatFileWriter::append(const double* values, size_t n)
+  {
+    if(!m_inMatrix) return;
+    if(m_nWritten + n > m_nExpected) {
+      std::cerr << "WARNING: trying to write more values than the matrix can hold. Ignoring the rest!" << std::endl;
+      n = m_nExpected - m_nWritten;
+    }
+    write(values, n * sizeof(double));
+    m_nWritten += n;
+  }
+
+  // ======================================================= END MATRIX ===========================================================
+  inline void MatFileWriter::endMatrix()
+  {
+    if(!m_inMatrix) return;
+    if(m_nWritten < m_nExpected) {
+      std::cerr << "WARNING: only " << m_nWritten << " of " << m_nExpected << " values were written to the matrix. Filling with zeros!" << std::endl;
+      std::vector<double> zeros(4096, 0);
+      while(m_nWritten < m_nExpected) append(zeros.data(), std::min<uint64_t>(zeros.size(), m_nExpected - m_nWritten));
+    }
+    m_inMatrix = false;
+
+    if(m_compress) {
+      deflateBuffer(Z_FINISH);
+      deflateEnd(&m_zstream);
+      if(m_compressedSize > 0xffffffffULL) {
+        std::cerr << "ERROR: compressed matrix is too large for a version 5 MAT-file!" << std::endl;
+        m_error = true;
+      }
+      uint32_t size = m_compressedSize;
+      long endPos = ftell(m_file);
+      fseek(m_file, m_sizePos + 4, SEEK_SET);
+      writeFile(&size, sizeof(size));
+      fseek(m_file, endPos, SEEK_SET);
+    }
+  }
+
+  // ========================================================= WRITING ============================================================
+  inline void MatFileWriter::write(const void* data, size_t n)
+  {
+    if(!m_compress) {
+      writeFile(data, n);
+      return;
+    }
+    m_zstream.next_in = (Bytef*) data;
+    m_zstream.avail_in = n;
+    deflateBuffer(Z_NO_FLUSH);
+  }
+
+  inline void MatFileWriter::writeFile(const void* data, size_t n)
+  {
+    if(m_file == 0) return;
+    if(fwrite(data, 1, n, m_file) != n) m_error = true;
+  }
+
+  inline void MatFileWriter::deflateBuffer(int flush)
+  {
+    int ret;
+    do {
+      m_zstream.next_out = m_zbuffer.data();
+      m_zstream.avail_out = m_zbuffer.size();
+      ret = deflate(&m_zstream, flush);
+      const size_t nOut = m_zbuffer.size() - m_zstream.avail_out;
+      writeFile(m_zbuffer.data(), nOut);
+      m_compressedSize += nOut;
+    } while(m_zstream.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END && ret != Z_STREAM_ERROR));
+  }
+}
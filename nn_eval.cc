@@ -0,0 +1,149 @@
+#include "nn_inference.h"
+#include "tt_timer.h"
+#include "tt_profiler.h"
+#include "tt_perfcounters.h"
+#include "tt_memory.h"
+#include "datreader.h"
+#include "vxdfilter.h"
+#include "decorrelation.h"
+#include "datformat.h"
+#include "parallel_helper.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// getopt
+#include <unistd.h>
+
+using namespace timing;
+
+/** number of samples that are evaluated at once (the activations of a batch stay in the cache) */
+const size_t batchSize = 256;
+
+/**
+ * evaluates a feedforward net exported from MATLAB (see MATLAB/export_net.m) on the samples of a data file (same as fbdt-eval)
+ * usage: nn-eval [-j nThreads] [-r first:last] [-V filter] netfile datafile outputfile
+ * -j: number of threads used for reading and evaluating the data file, -r: evaluate only the rows [first, last) of the data file
+ * (the data file is read via its index (datafile.idx), which is created if it does not exist, see datindex)
+ * If there is a decorrelation transform next to the net (netfile.decor), the inputs are decorrelated with it
+ * -V: use only the rows that pass filter (0-9, see RootToolBox::passVXDFilter), needs the VXD filter index (datafile.vxd)
+ * The outputfile has one line per sample with all outputs of the net
+ */
+int main(int argc, char* argv[])
+{
+  unsigned nThreads = 0;
+  uint64_t rowBegin = 0, rowEnd = std::numeric_limits<uint64_t>::max();
+  int vxdFilter = -1;
+  int opt;
+  while((opt = getopt(argc, argv, "j:r:V:")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = atoi(optarg); break;
+    case 'r':
+      if(!datfile::parseRowRange(optarg, rowBegin, rowEnd)) {
+        std::cerr << "invalid row range " << optarg << " (expected first:last)" << std::endl;
+        return 1;
+      }
+      break;
+    case 'V':
+      vxdFilter = atoi(optarg);
+      if(vxdFilter < 0 || unsigned(vxdFilter) >= RootToolBox::c_nVXDFilters) {
+        std::cerr << "invalid VXD filter " << optarg << " (expected 0 to " << RootToolBox::c_nVXDFilters - 1 << ")" << std::endl;
+        return 1;
+      }
+      break;
+    default:
+      std::cerr << "usage: " << argv[0] << " [-j nThreads] [-r first:last] [-V filter] netfile datafile outputfile" << std::endl;
+      return 1;
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  if(argc < 4) {
+    std::cerr << "need a net file, a data file and an output file! (in this order)" << std::endl;
+    return 1;
+  }
+  nThreads = parallel::getNThreads(nThreads);
+
+  TT_PROFILE_SCOPE("nn-eval");
+  TicTocTimer timer(1000000); // want ms
+  std::cout << "reading in net ... " << std::flush;
+  ScopedTimer readNetScope("read_net");
+  nn::Net net;
+  if(!net.load(argv[1])) return 1;
+  readNetScope.stop();
+  std::cout << "DONE. " << net.getLayers().size() << " layers. " << timer << std::endl;
+
+  std::cout << "reading in data ... " << std::flush;
+  timer.tic();
+  ScopedTimer readDataScope("read_data");
+  MemoryStage readDataMemory;
+  datfile::DatReader datreader(argv[2]);
+  if(!datreader.good()) return 1;
+  const size_t nColumns = datreader.getNColumns();
+  if(nColumns < net.getNInputs()) {
+    std::cerr << "data file has only " << nColumns << " columns, but the net needs " << net.getNInputs() << " inputs" << std::endl;
+    return 1;
+  }
+  std::vector<double> values; // row-major
+  datreader.readRowsParallel(rowBegin, rowEnd, values, nThreads);
+  if(vxdFilter >= 0) {
+    RootToolBox::VXDFilterIndex vxdIndex;
+    if(!datfile::loadVXDFilterIndex(argv[2], datreader.getNRows(), vxdIndex)) return 1;
+    datfile::applyVXDFilter(vxdIndex, vxdFilter, rowBegin, nColumns, values);
+  }
+  const size_t nSamples = values.size() / nColumns;
+  const std::string transformfile = decorrelation::DecorrelationTransform::getSidecarName(argv[1]);
+  if(std::ifstream(transformfile.c_str())) {
+    decorrelation::DecorrelationTransform transform;
+    if(!transform.load(transformfile) || transform.getNDims() > nColumns) {
+      std::cerr << "ERROR: could not apply the decorrelation transform " << transformfile << std::endl;
+      return 1;
+    }
+    transform.applyParallel(values.data(), nSamples, nColumns, nThreads);
+    std::cout << "(decorrelated with " << transformfile << ") " << std::flush;
+  }
+  readDataScope.stop();
+  std::cout << "DONE. " << timer << " " << readDataMemory << std::endl;
+
+  // every thread evaluates batches of its range of samples with its own workspace
+  std::cout << "evaluating data ... " << std::flush;
+  timer.tic();
+  ScopedTimer evaluateScope("evaluate");
+  MemoryStage evaluateMemory;
+  const size_t nOutputs = net.getNOutputs();
+  std::vector<double> outputs(nSamples * nOutputs);
+  PerfRegion evaluatePerf("nn::Net::evaluate", nSamples, "sample");
+  parallel::parallelFor(nSamples, nThreads, [&](size_t first, size_t last, unsigned) {
+      PerfThreadScope perf(evaluatePerf);
+      nn::Workspace workspace;
+      for(size_t begin = first; begin < last; begin += batchSize) {
+        const size_t n = std::min(batchSize, last - begin);
+        net.evaluate(&values[begin * nColumns], n, nColumns, &outputs[begin * nOutputs], workspace);
+      }
+    });
+  evaluatePerf.stop();
+  evaluateScope.stop();
+  std::cout << "DONE. " << timer << " " << evaluateMemory << std::endl;
+
+  std::cout << "writing output data ... " << std::flush;
+  timer.tic();
+  ScopedTimer writeScope("write");
+  std::ofstream outfile(argv[3]);
+  std::string line;
+  for(size_t i = 0; i < nSamples; ++i) {
+    line.clear();
+    for(size_t o = 0; o < nOutputs; ++o) {
+      datformat::appendValue(line, outputs[i * nOutputs + o]);
+      line.push_back(o + 1 < nOutputs ? ' ' : '\n');
+    }
+    outfile << line;
+  }
+  outfile.close();
+  writeScope.stop();
+  std::cout << "DONE. " << timer << std::endl;
+
+  return outfile.fail() ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace nn {
+
+  /** transfer functions of the layers (same names as in MATLAB) */
+  enum e_transferFcn { c_tansig, c_logsig, c_purelin, c_softmax };
+
+  /** get the transfer function from its MATLAB name. @returns false if it is not supported */
+  inline bool getTransferFcn(std::string name, e_transferFcn& fcn)
+  {
+    if(name == "tansig") fcn = c_tansig;
+    else if(name == "logsig") fcn = c_logsig;
+    else if(name == "purelin") fcn = c_purelin;
+    else if(name == "softmax") fcn = c_softmax;
+    else return false;
+    return true;
+  }
+
+  /**
+   * exp(x) without branches and calls (round to the nearest power of 2 + polynomial of degree 11), such that loops calling it
+   * can be vectorized. Relative deviation from std::exp below 1e-14, x is clamped to [-708, 708] (gcc vectorizes the clamping only
+   * with -fno-trapping-math, see makefile)
+   */
+  inline double vexp(double x)
+  {
+    x = x < -708.0 ? -708.0 : x;
+    x = x > 708.0 ? 708.0 : x;
+    // n = round(x / ln2) via the mantissa of (x / ln2 + 1.5 * 2^52), whose lowest bits are then n
+    const double shift = 6755399441055744.0;
+    const double t = x * 1.4426950408889634 + shift;
+    const double n = t - shift;
+    uint64_t tBits;
+    std::memcpy(&tBits, &t, sizeof(t));
+    const double r = (x - n * 0.693145751953125) - n * 1.4286068203094172321e-6; // |r| <= ln2 / 2, ln2 split in two parts
+    double p = 1.0 / 39916800;
+    p = p * r + 1.0 / 3628800;
+    p = p * r + 1.0 / 362880;
+    p = p * r + 1.0 / 40320;
+    p = p * r + 1.0 / 5040;
+    p = p * r + 1.0 / 720;
+    p = p * r + 1.0 / 120;
+    p = p * r + 1.0 / 24;
+    p = p * r + 1.0 / 6;
+    p = p * r + 0.5;
+    p = p * r + 1;
+    p = p * r + 1;
+    const uint64_t scaleBits = (tBits + 1023) << 52; // 2^n
+    double scale;
+    std::memcpy(&scale, &scaleBits, sizeof(scale));
+    return p * scale;
+  }
+
+  /**
+   * apply a transfer function to the n values of every row of y (nRows x n, row-major) in place. Same definitions as in MATLAB
+   * (tansig(x) = 2 / (1 + exp(-2x)) - 1, logsig(x) = 1 / (1 + exp(-x))). The loops of tansig and logsig use vexp, such that
+   * they can be vectorized
+   */
+  inline void applyTransferFcn(e_transferFcn fcn, double* y, size_t nRows, size_t n)
+  {
+    const size_t size = nRows * n;
+    switch(fcn) {
+    case c_tansig:
+      for(size_t i = 0; i < size; ++i) y[i] = 2 / (1 + vexp(-2 * y[i])) - 1;
+      break;
+    case c_logsig:
+      for(size_t i = 0; i < size; ++i) y[i] = 1 / (1 + vexp(-y[i]));
+      break;
+    case c_softmax:
+      for(size_t r = 0; r < nRows; ++r) {
+        double* row = y + r * n;
+        const double maxValue = *std::max_element(row, row + n);
+        double sum = 0;
+        for(size_t i = 0; i < n; ++i) sum += row[i] = std::exp(row[i] - maxValue);
+        for(size_t i = 0; i < n; ++i) row[i] /= sum;
+      }
+      break;
+    case c_purelin:
+      break;
+    }
+  }
+
+  /**
+   * C (nRows x nOut) = A (nRows x nIn) * B (nIn x nOut) + bias (broadcast to every row), all row-major.
+   * Blocked over all three dimensions such that the tiles of A, B and C stay in the cache, the innermost loop runs over a row of
+   * C (and B) such that it can be vectorized
+   */
+  inline void gemmBias(const double* A, const double* B, const double* bias, double* C, size_t nRows, size_t nIn, size_t nOut)
+  {
+    const size_t rowTile = 64, inTile = 128, outTile = 256;
+    for(size_t r = 0; r < nRows; ++r) std::copy(bias, bias + nOut, C + r * nOut);
+    for(size_t o0 = 0; o0 < nOut; o0 += outTile) {
+      const size_t o1 = std::min(nOut, o0 + outTile);
+      for(size_t k0 = 0; k0 < nIn; k0 += inTile) {
+        const size_t k1 = std::min(nIn, k0 + inTile);
+        for(size_t r0 = 0; r0 < nRows; r0 += rowTile) {
+          const size_t r1 = std::min(nRows, r0 + rowTile);
+          for(size_t r = r0; r < r1; ++r) {
+            double* c = C + r * nOut;
+            const double* a = A + r * nIn;
+            for(size_t k = k0; k < k1; ++k) {
+              const double ak = a[k];
+              const double* b = B + k * nOut;
+              for(size_t o = o0; o < o1; ++o) c[o] += ak * b[o];
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /** one layer of a net */
+  struct Layer {
+    size_t nIn; /**< number of inputs */
+    size_t nOut; /**< number of neurons */
+    std::vector<double> weights; /**< transposed weight matrix (nIn x nOut, row-major), i.e. output = input * weights + biases */
+    std::vector<double> biases; /**< biases (nOut) */
+    e_transferFcn transferFcn; /**< transfer function */
+  };
+
+  /** buffers for the evaluation of a batch (one per thread, such that the evaluation does not allocate) */
+  struct Workspace {
+    std::vector<double> a; /**< inputs of the current layer */
+    std::vector<double> b; /**< outputs of the current layer */
+  };
+
+  /**
+   * feedforward net exported from MATLAB with export_net.m (inputs -> removeconstantrows, mapminmax -> layers -> reverse mapminmax).
+   * Batches of samples are evaluated at once, such that every layer is one matrix product.
+   * usage:
+   *   Net net;
+   *   net.load("net.txt");
+   *   Workspace workspace;
+   *   net.evaluate(values, nRows, nColumns, outputs, workspace); // outputs: nRows x getNOutputs()
+   */
+  class Net {
+  public:
+    Net() : m_nRawInputs(0), m_inputYMin(0), m_outputYMin(0) {}
+
+    /** read a net written by export_net.m. @returns false (and prints the reason) if the file cannot be read */
+    bool load(std::string filename);
+
+    size_t getNInputs() const { return m_nRawInputs; } /**< number of inputs (columns of the data that are used) */
+
+    size_t getNOutputs() const { return m_layers.empty() ? 0 : m_layers.back().nOut; } /**< number of outputs */
+
+    const std::vector<Layer>& getLayers() const { return m_layers; } /**< all layers */
+
+    /**
+     * evaluate nRows samples (row-major, the first getNInputs() of nColumns values per row are the inputs).
+     * The outputs are written to outputs (row-major, nRows x getNOutputs())
+     */
+    void evaluate(const double* values, size_t nRows, size_t nColumns, double* outputs, Workspace& workspace) const;
+
+  private:
+    size_t m_nRawInputs; /**< number of inputs before removeconstantrows */
+    std::vector<size_t> m_usedInputs; /**< inputs that are passed to the first layer */
+    std::vector<double> m_inputOffset; /**< xoffset of the input mapminmax */
+    std::vector<double> m_inputGain; /**< gain of the input mapminmax */
+    double m_inputYMin; /**< ymin of the input mapminmax */
+    std::vector<Layer> m_layers; /**< layers */
+    std::vector<double> m_outputOffset; /**< xoffset of the output mapminmax */
+    std::vector<double> m_outputGain; /**< gain of the output mapminmax */
+    double m_outputYMin; /**< ymin of the output mapminmax */
+  };
+
+  /** read the next line (skipping empty lines) into a stream */
+  inline bool readLine(std::istream& in, std::istringstream& line)
+  {
+    std::string buffer;
+    while(std::getline(in, buffer)) {
+      if(buffer.find_first_not_of(" \t\r") == std::string::npos) continue;
+      line.clear();
+      line.str(buffer);
+      return true;
+    }
+    return false;
+  }
+
+  /** read a line with n values */
+  template<typename T>
+  inline bool readValues(std::istream& in, std::vector<T>& values, size_t n)
+  {
+    std::istringstream line;
+    if(!readLine(in, line)) return false;
+    values.resize(n);
+    for(T& value : values) {
+      if(!(line >> value)) return false;
+    }
+    return true;
+  }
+
+  inline bool Net::load(std::string filename)
+  {
+    std::ifstream infile(filename.c_str());
+    std::istringstream line;
+    std::string hash, tag;
+    size_t nLayers = 0, nUsed = 0;
+    std::vector<double> ymin;
+    if(!readLine(infile, line) || !(line >> hash >> tag >> nLayers) || tag != "nn-net" ||
+       !readLine(infile, line) || !(line >> hash >> tag >> m_nRawInputs >> nUsed) || tag != "inputs" ||
+       !readValues(infile, m_usedInputs, nUsed) || !readValues(infile, m_inputOffset, nUsed) ||
+       !readValues(infile, m_inputGain, nUsed) || !readValues(infile, ymin, 1)) {
+      std::cerr << "ERROR: " << filename << " is not a net written by export_net.m" << std::endl;
+      return false;
+    }
+    m_inputYMin = ymin[0];
+    for(size_t i : m_usedInputs) {
+      if(i >= m_nRawInputs) {
+        std::cerr << "ERROR: invalid input index " << i << " in " << filename << std::endl;
+        return false;
+      }
+    }
+
+    m_layers.resize(nLayers);
+    size_t nIn = nUsed;
+    for(size_t l = 0; l < nLayers; ++l) {
+      Layer& layer = m_layers[l];
+      std::string fcn;
+      if(!readLine(infile, line) || !(line >> hash >> tag >> layer.nOut >> layer.nIn >> fcn) || tag != "layer") {
+        std::cerr << "ERROR: malformed header of layer " << l + 1 << " in " << filename << std::endl;
+        return false;
+      }
+      if(layer.nIn != nIn || !getTransferFcn(fcn, layer.transferFcn)) {
+        std::cerr << "ERROR: layer " << l + 1 << " in " << filename << " has " << layer.nIn << " inputs (expected " << nIn
+                  << ") or an unsupported transfer function (" << fcn << ")" << std::endl;
+        return false;
+      }
+      layer.weights.resize(layer.nIn * layer.nOut);
+      std::vector<double> row;
+      for(size_t o = 0; o < layer.nOut; ++o) {
+        if(!readValues(infile, row, layer.nIn)) {
+          std::cerr << "ERROR: could not read the weights of layer " << l + 1 << " in " << filename << std::endl;
+          return false;
+        }
+        for(size_t k = 0; k < layer.nIn; ++k) layer.weights[k * layer.nOut + o] = row[k];
+      }
+      if(!readValues(infile, layer.biases, layer.nOut)) {
+        std::cerr << "ERROR: could not read the biases of layer " << l + 1 << " in " << filename << std::endl;
+        return false;
+      }
+      nIn = layer.nOut;
+    }
+
+    size_t nOut = 0;
+    if(!readLine(infile, line) || !(line >> hash >> tag >> nOut) || tag != "outputs" || nOut != nIn ||
+       !readValues(infile, m_outputOffset, nOut) || !readValues(infile, m_outputGain, nOut) || !readValues(infile, ymin, 1)) {
+      std::cerr << "ERROR: could not read the output processing in " << filename << std::endl;
+      return false;
+    }
+    m_outputYMin = ymin[0];
+    return true;
+  }
+
+  inline void Net::evaluate(const double* values, size_t nRows, size_t nColumns, double* outputs, Workspace& workspace) const
+  {
+    // inputs: removeconstantrows + mapminmax, y = (x - xoffset) * gain + ymin
+    const size_t nUsed = m_usedInputs.size();
+    workspace.a.resize(nRows * nUsed);
+    for(size_t r = 0; r < nRows; ++r) {
+      const double* x = values + r * nColumns;
+      double* a = &workspace.a[r * nUsed];
+      for(size_t i = 0; i < nUsed; ++i) a[i] = (x[m_usedInputs[i]] - m_inputOffset[i]) * m_inputGain[i] + m_inputYMin;
+    }
+
+    for(const Layer& layer : m_layers) {
+      workspace.b.resize(nRows * layer.nOut);
+      gemmBias(workspace.a.data(), layer.weights.data(), layer.biases.data(), workspace.b.data(), nRows, layer.nIn, layer.nOut);
+      applyTransferFcn(layer.transferFcn, workspace.b.data(), nRows, layer.nOut);
+      workspace.a.swap(workspace.b);
+    }
+
+    // outputs: reverse mapminmax, x = (y - ymin) / gain + xoffset
+    const size_t nOut = getNOutputs();
+    for(size_t r = 0; r < nRows; ++r) {
+      const double* a = &workspace.a[r * nOut];
+      double* out = outputs + r * nOut;
+      for(size_t o = 0; o < nOut; ++o) out[o] = (a[o] - m_outputYMin) / m_outputGain[o] + m_outputOffset[o];
+    }
+  }
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+namespace parallel {
+
+  /** get the number of threads to use: @param requested if it is > 0, the number of hardware threads else */
+  inline unsigned getNThreads(unsigned requested = 0)
+  {
+    if(requested > 0) return requested;
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  /**
+   * split [0, n) into nThreads contiguous ranges and call func(begin, end, iThread) for each of them in its own thread.
+   * returns after all threads are done
+   */
+  inline void parallelFor(size_t n, unsigned nThreads, std::function<void(size_t, size_t, unsigned)> func)
+  {
+    nThreads = std::max(1u, std::min<unsigned>(nThreads, std::max<size_t>(n, 1)));
+    if(nThreads == 1) {
+      func(0, n, 0);
+      return;
+    }
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < nThreads; ++i) {
+      threads.push_back(std::thread(func, n * i / nThreads, n * (i + 1) / nThreads, i));
+    }
+    for(std::thread& thread : threads) thread.join();
+  }
+
+  /**
+   * call func(i, iThread) for every i in [0, n) on nThreads threads, where every thread takes the next i as soon as it is done with
+   * the previous one (i.e. for a few items of very different cost, where contiguous ranges would be unbalanced).
+   * returns after all threads are done
+   */
+  inline void parallelForEach(size_t n, unsigned nThreads, std::function<void(size_t, unsigned)> func)
+  {
+    std::atomic<size_t> next(0);
+    parallelFor(n, nThreads, [&](size_t, size_t, unsigned iThread) {
+        for(size_t i = next++; i < n; i = next++) func(i, iThread);
+      });
+  }
+
+  /**
+   * pipeline with one producer, nWorkers workers and one consumer, where the consumer gets the results in the order in which the
+   * inputs were produced.
+   * - produce(In&) is called sequentially on the calling thread until it returns false.
+   * - transform(In&, Out&) is called concurrently on the worker threads.
+   * - consume(Out&) is called sequentially (in production order) on a dedicated thread.
+   * At most maxInFlight items are in the pipeline at the same time. The In and Out objects are reused (i.e. they keep their
+   * allocated buffers) so that there is no (re)allocation after the first few items.
+   */
+  template<typename In, typename Out>
+  class OrderedPipeline {
+  public:
+    OrderedPipeline(unsigned nWorkers, size_t maxInFlight = 0) :
+      m_nWorkers(std::max(1u, nWorkers)), m_slots(maxInFlight > 0 ? maxInFlight : 4 * std::max(1u, nWorkers)), m_nProduced(0), m_done(false) {}
+
+    /** run the pipeline (returns when all items have been consumed) */
+    void run(std::function<bool(In&)> produce, std::function<void(In&, Out&)> transform, std::function<void(Out&)> consume);
+
+  private:
+    /** state of a slot in the ring buffer */
+    enum e_slotState { c_free, c_produced, c_transformed };
+
+    /** one item in the pipeline */
+    struct Slot {
+      Slot() : state(c_free) {}
+      In in; /**< input, filled by produce */
+      Out out; /**< output, filled by transform */
+      e_slotState state; /**< current state */
+    };
+
+    unsigned m_nWorkers; /**< number of worker threads */
+    std::vector<Slot> m_slots; /**< ring buffer of slots (item i is in slot i % size) */
+    std::deque<size_t> m_queue; /**< items waiting for a worker */
+    size_t m_nProduced; /**< number of items produced so far */
+    bool m_done; /**< producer has finished */
+    std::mutex m_mutex; /**< guards all of the above (but not the contents of a slot that is owned by a thread) */
+    std::condition_variable m_slotFree; /**< notified when a slot becomes free */
+    std::condition_variable m_work; /**< notified when there is new work (or the producer is done) */
+    std::condition_variable m_transformed; /**< notified when an item has been transformed (or the producer is done) */
+  };
+
+  template<typename In, typename Out>
+  void OrderedPipeline<In, Out>::run(std::function<bool(In&)> produce, std::function<void(In&, Out&)> transform, std::function<void(Out&)> consume)
+  {
+    const size_t nSlots = m_slots.size();
+
+    auto worker = [&]() {
+      for(;;) {
+        size_t item;
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_work.wait(lock, [&]() { return !m_queue.empty() || m_done; });
+          if(m_queue.empty()) return; // producer is done and there is no work left
+          item = m_queue.front();
+          m_queue.pop_front();
+        }
+        Slot& slot = m_slots[item % nSlots];
+        transform(slot.in, slot.out);
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          slot.state = c_transformed;
+        }
+        m_transformed.notify_all();
+      }
+    };
+
+    auto consumer = [&]() {
+      for(size_t item = 0; ; ++item) {
+        Slot& slot = m_slots[item % nSlots];
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_transformed.wait(lock, [&]() { return (item < m_nProduced && slot.state == c_transformed) || (m_done && item >= m_nProduced); });
+          if(item >= m_nProduced) return; // everything has been consumed
+        }
+        consume(slot.out);
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          slot.state = c_free;
+        }
+        m_slotFree.notify_one();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < m_nWorkers; ++i) threads.push_back(std::thread(worker));
+    std::thread consumerThread(consumer);
+
+    for(size_t item = 0; ; ++item) {
+      Slot& slot = m_slots[item % nSlots];
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_slotFree.wait(lock, [&]() { return slot.state == c_free; });
+      }
+      if(!produce(slot.in)) break;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        slot.state = c_produced;
+        m_queue.push_back(item);
+        m_nProduced = item + 1;
+      }
+      m_work.notify_one();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_done = true;
+    }
+    m_work.notify_all();
+    m_transformed.notify_all();
+
+    for(std::thread& thread : threads) thread.join();
+    consumerThread.join();
+  }
+}
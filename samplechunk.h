@@ -0,0 +1,129 @@
+// the samples of the ThreeHitSamplesTree held column-wise in memory and their formatting for the .dat (and MAT) files
+// (used by root2dat and gensamples, such that both write the same format)
+//
+// by Thomas Madlener, 2015
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "datformat.h"
+#include "RootToolBox/vxdhelper.hpp"
+
+/** name of the TTree in the root file*/
+const std::string treename = "ThreeHitSamplesTree";
+/** name of the branches in the TTree */
+const std::vector<std::string> branchnames = { "hit1X", "hit1Y", "hit1Z", "hit2X", "hit2Y", "hit2Z",
+                                               "hit3X", "hit3Y", "hit3Z", "truth", "vxdid1", "vxdid2", "vxdid3",
+                                               "pT", "momentum", "charge", "pdg" };
+
+/** number of all branches containing a vector<double> */
+const size_t npositions = 9;
+
+/** number of all branches containing a vector<short> */
+const size_t nvxdids = 3;
+
+/** number of all branches containing momentum/charge information */
+const size_t nadditional = 3;
+
+/**
+ * helper struct holding the values of many samples column-wise (i.e. a copy of the contents of several events of the tree)
+ */
+struct SampleChunk {
+  void clear(); /**< clear all columns (keeping the allocated memory) */
+  size_t size() const { return signal.size(); } /**< number of samples in the chunk */
+
+  std::array<std::vector<double>, npositions> positions; /**< position columns */
+  std::array<std::vector<unsigned>, nvxdids> vxdids; /**< vxdid columns */
+  std::array<std::vector<double>, nadditional> additionalInfo; /**< additional info columns */
+  std::vector<int> pdg; /**< pdg column */
+  std::vector<bool> signal; /**< signal column */
+};
+
+inline void SampleChunk::clear()
+{
+  for(auto& vec : positions) vec.clear();
+  for(auto& vec : vxdids) vec.clear();
+  for(auto& vec : additionalInfo) vec.clear();
+  pdg.clear();
+  signal.clear();
+}
+
+/** helper struct holding a formatted SampleChunk */
+struct FormattedChunk {
+  std::string buffer; /**< the lines of the .dat file */
+  size_t nSamples; /**< number of samples (lines) in buffer */
+  size_t nSignal; /**< number of signal samples in buffer */
+  std::vector<unsigned> topology; /**< topology codes of the samples (only filled if they are written) */
+};
+
+/** get the topology code (see RootToolBox::getTopologyCode) of sample i of the chunk */
+inline unsigned getTopologyCode(const SampleChunk& chunk, size_t i)
+{
+  return RootToolBox::getTopologyCode(chunk.vxdids[0][i], chunk.vxdids[1][i], chunk.vxdids[2][i]);
+}
+
+/**
+ * format the content of a SampleChunk into a buffer (one line per sample)
+ * @param: chunk, the SampleChunk helper struct, which contents shall be written to a .dat file
+ * @param: formatted, the FormattedChunk to which the lines are written (cleared before, but the memory is reused)
+ * @param: roundtrip, write doubles with the shortest representation that reads back exactly (instead of the default precision of 6)
+ * @param: topology, write the topology code of every sample (before the signal flag)
+ */
+inline void formatChunk(const SampleChunk& chunk, FormattedChunk& formatted, bool roundtrip, bool topology)
+{
+  std::string& buffer = formatted.buffer;
+  buffer.clear();
+  formatted.topology.clear();
+  formatted.nSamples = chunk.size();
+  formatted.nSignal = std::count(chunk.signal.begin(), chunk.signal.end(), true);
+  for(size_t i = 0; i < chunk.size(); ++i) {
+    for (size_t j = 0; j < npositions; ++j){
+      if(roundtrip) datformat::appendRoundtrip(buffer, chunk.positions[j][i]);
+      else datformat::appendValue(buffer, chunk.positions[j][i]);
+      buffer.push_back(' ');
+    }
+    for (size_t j = 0; j < nvxdids; ++j ) {
+      datformat::appendValue(buffer, chunk.vxdids[j][i]);
+      buffer.push_back(' ');
+    }
+    for (size_t j = 0; j < nadditional; ++j) {
+      if(roundtrip) datformat::appendRoundtrip(buffer, chunk.additionalInfo[j][i]);
+      else datformat::appendValue(buffer, chunk.additionalInfo[j][i]);
+      buffer.push_back(' ');
+    }
+    datformat::appendValue(buffer, chunk.pdg[i]);
+    buffer.push_back(' ');
+    if(topology) {
+      formatted.topology.push_back(getTopologyCode(chunk, i));
+      datformat::appendValue(buffer, formatted.topology.back());
+      buffer.push_back(' ');
+    }
+    datformat::appendValue(buffer, bool(chunk.signal[i]));
+    buffer.push_back('\n'); // no flushing after every line (as std::endl would do)
+  }
+}
+
+/** number of values per sample without the topology code (i.e. rows in the MAT-file matrix, lines in the .dat file) */
+const size_t nValuesPerSample = npositions + nvxdids + nadditional + 2;
+
+/**
+ * convert a SampleChunk to doubles in the order of the columns of the .dat file (i.e. column-major nValues x N matrix, where
+ * nValues is nValuesPerSample + 1 if the topology code is written)
+ */
+inline void chunkToMatrix(const SampleChunk& chunk, std::vector<double>& values, bool topology)
+{
+  values.resize(chunk.size() * (nValuesPerSample + topology));
+  double* value = values.data();
+  for(size_t i = 0; i < chunk.size(); ++i) {
+    for(size_t j = 0; j < npositions; ++j) *value++ = chunk.positions[j][i];
+    for(size_t j = 0; j < nvxdids; ++j) *value++ = chunk.vxdids[j][i];
+    for(size_t j = 0; j < nadditional; ++j) *value++ = chunk.additionalInfo[j][i];
+    *value++ = chunk.pdg[i];
+    if(topology) *value++ = getTopologyCode(chunk, i);
+    *value++ = chunk.signal[i];
+  }
+}
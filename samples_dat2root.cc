@@ -9,49 +9,101 @@
 
 // stl
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
-#include <array>
 #include <initializer_list>
 #include <utility>
-#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+// getopt
+#include <unistd.h>
 
 // root
 #include "TFile.h"
 #include "TTree.h"
 #include "TBranch.h"
+#include "TROOT.h"
+#include "Compression.h"
+
+#include "parallel_helper.h"
+#include "datreader.h"
+#include "tt_timer.h"
+#include "tt_profiler.h"
+#include "tt_memory.h"
 
 using namespace std;
-using std::chrono::high_resolution_clock;
 using namespace ROOT;
+using namespace timing;
+
+/** number of lines that are put into one entry of the tree (every entry holds vectors with the values of these lines) */
+const size_t defaultLinesPerEntry = 100;
 
-// /** enum for adhoc type handling*/
-// enum Type {
-//   b, /**< bool */
-//   i, /**< int */
-//   d, /**< double */
-// };
+/** number of bytes that are read from the .dat file at once (and parsed by one worker) */
+const size_t blockSize = 1 << 22;
 
 /**
- * helper struct that holds the values of a line in a .dat file
+ * helper struct holding the options for the layout of the output file
  */
-struct Line {
-  /** constructor from vector. initializes values to empty vector then swaps val and values*/
-  Line(std::vector<double>& val, bool t) : values{val}, truth(t) { ; }
-
-  void Print();
-  std::vector<double> values; /**< vector of doubles holding the values of a line */
-  bool truth;
+struct OutputOptions {
+  OutputOptions() : scalar(false), linesPerEntry(defaultLinesPerEntry), compression(-1), basketSize(0), autoFlush(0),
+                    rowRange(false), rowBegin(0), rowEnd(0) { ; }
+  bool scalar; /**< one sample per entry with scalar branches (instead of linesPerEntry samples per entry in vector branches) */
+  size_t linesPerEntry; /**< number of lines that are stored in one entry of the tree (vector layout only) */
+  int compression; /**< compression settings of the file (algorithm * 100 + level, -1 for the ROOT default) */
+  int basketSize; /**< basket size of all branches in bytes (0 for the ROOT default) */
+  long long autoFlush; /**< auto flush setting of the tree (> 0: entries, < 0: bytes, 0 for the ROOT default) */
+  bool rowRange; /**< convert only the rows [rowBegin, rowEnd) (always reads via the index) */
+  uint64_t rowBegin; /**< first row to convert */
+  uint64_t rowEnd; /**< last row to convert (excluded) */
 };
 
-void Line::Print()
+/**
+ * parse a compression setting of the form algorithm[:level] (algorithm: zlib, lzma, lz4, zstd, none)
+ * @returns false if the algorithm is unknown
+ */
+bool parseCompression(std::string setting, int& compression)
 {
-  for (double val: values) { cout << val << " "; }
-  cout << truth << endl;
+  std::string algorithm = setting.substr(0, setting.find(':'));
+  int level = -1;
+  if(setting.find(':') != std::string::npos) level = atoi(setting.substr(setting.find(':') + 1).c_str());
+
+  // default levels are the ones recommended by ROOT
+  if(algorithm == "none") { compression = 0; return true; }
+  else if(algorithm == "zlib") compression = ROOT::CompressionSettings(ROOT::kZLIB, level < 0 ? 1 : level);
+  else if(algorithm == "lzma") compression = ROOT::CompressionSettings(ROOT::kLZMA, level < 0 ? 8 : level);
+  else if(algorithm == "lz4") compression = ROOT::CompressionSettings(ROOT::kLZ4, level < 0 ? 4 : level);
+  else if(algorithm == "zstd") compression = ROOT::CompressionSettings(ROOT::kZSTD, level < 0 ? 5 : level);
+  else return false;
+  return true;
 }
 
+/**
+ * helper struct holding the columns of a block of parsed lines. the vectors are reused for every block
+ */
+struct ParsedBlock {
+  std::vector<std::vector<double> > columns; /**< one vector per column of the .dat file */
+  size_t nRows; /**< number of (valid) lines in the block */
+  size_t nBad; /**< number of lines that have been skipped because they had the wrong number of values */
+  std::vector<double> rows; /**< buffer for the (row-major) values when reading via the index */
+};
+
+/**
+ * helper struct holding a block of the .dat file that still has to be parsed: either the raw text or (when reading via the index)
+ * a range of rows
+ */
+struct DatBlock {
+  std::string text; /**< lines of the .dat file (sequential reading) */
+  uint64_t rowBegin; /**< first row (reading via the index) */
+  uint64_t rowEnd; /**< last row (excluded, reading via the index) */
+};
+
+/** number of rows per block when reading via the index */
+const uint64_t indexedBlockRows = 1 << 16;
+
 /**
  * small helper struct to keep the pointers of ROOT contained
  */
@@ -62,10 +114,13 @@ struct RootFile {
   RootFile(char* filename, std::string treename) : RootFile(filename, treename, {}) { ; }
   ~RootFile(); // { delete tree; delete file; } /**< destructor */
 
-  void Write() { file->cd(); file->Write(); } //file->Close(); } /**< Write the contents to the root file. Close in destructor */
+  /** Write the contents to the root file (closed in destructor). returns false if ROOT reported a write error */
+  bool Write() { file->cd(); file->Write(); return !file->TestBit(TFile::kWriteError); }
   // void Fill() { tree->Fill(); } /**< Fill the values into the tree */
   template<class T>
   void AddBranch(std::string name, T& var); /**< Add a branch in the ROOTfile */
+  /** Add a branch holding a single value of type leaftype (ROOT type code, e.g. "D") per entry */
+  void AddScalarBranch(std::string name, void* var, std::string leaftype);
   // void CreateBranches(const std::vector<Type>& types); /**< create a branch for each name and type */
   TFile* file;
   TTree* tree;
@@ -95,90 +150,280 @@ void RootFile::AddBranch(std::string name, T& var)
   branchNames.push_back(name); nBranches++;
 }
 
+void RootFile::AddScalarBranch(std::string name, void* var, std::string leaftype)
+{
+  tree->Branch(name.c_str(), var, (name + "/" + leaftype).c_str());
+  branchNames.push_back(name); nBranches++;
+}
+
+/**
+ * helper class that reads a .dat file in blocks of (approx.) blockSize bytes, such that every block ends with a complete line
+ */
+class DatBlockReader {
+public:
+  DatBlockReader(FILE* file) : m_file(file) { ; }
+
+  /** read the next block into text (cleared before, but the memory is reused). @returns false if there is nothing left */
+  bool next(std::string& text);
+
+private:
+  FILE* m_file; /**< the .dat file */
+  std::string m_carry; /**< incomplete last line of the previous block */
+};
+
+bool DatBlockReader::next(std::string& text)
+{
+  text.assign(m_carry);
+  m_carry.clear();
+  size_t nOld = text.size();
+  text.resize(nOld + blockSize);
+  size_t nRead = fread(&text[nOld], 1, blockSize, m_file);
+  text.resize(nOld + nRead);
+  if(text.empty()) return false;
+
+  if(nRead == blockSize) { // there is more to read -> keep the last incomplete line for the next block
+    size_t lastNewline = text.rfind('\n');
+    if(lastNewline != std::string::npos) {
+      m_carry.assign(text, lastNewline + 1, std::string::npos);
+      text.resize(lastNewline + 1);
+    }
+  }
+  return true;
+}
+
+/** split a line at whitespace */
+std::vector<std::string> splitLine(const std::string& line)
+{
+  std::vector<std::string> tokens;
+  size_t pos = 0;
+  for(;;) {
+    while(pos < line.size() && isspace((unsigned char) line[pos])) ++pos;
+    if(pos == line.size()) break;
+    size_t end = pos;
+    while(end < line.size() && !isspace((unsigned char) line[end])) ++end;
+    tokens.push_back(line.substr(pos, end - pos));
+    pos = end;
+  }
+  return tokens;
+}
+
+/** check if a string is a number (as far as strtod is concerned) */
+bool isNumber(const std::string& token)
+{
+  char* end;
+  strtod(token.c_str(), &end);
+  return end != token.c_str() && *end == 0;
+}
+
 /**
- * create a Line object from a raw string
+ * determine the branch names from the first line of the .dat file.
+ * If it starts with a '#' or contains non-numeric values, the values of this line are used as branch names (and it is not
+ * converted), else the last column is called truth and all others Z0 ... ZN
+ * @returns false if no names could be determined (e.g. empty file)
  */
-Line convertStringToLine(std::string rawline)
+bool readBranchNames(FILE* file, std::vector<std::string>& names)
 {
-  stringstream ss{rawline};
-  vector<double> rawvals;
-  for(;;){
-    double d;
-    ss >> d;
-    if(!ss) break;
-    rawvals.push_back(d);
+  std::string line;
+  int c;
+  while((c = fgetc(file)) != EOF && c != '\n') line.push_back(c);
+
+  bool isHeader = !line.empty() && line[0] == '#';
+  if(isHeader) line.erase(0, 1);
+  std::vector<std::string> tokens = splitLine(line);
+  for(const std::string& token : tokens) isHeader |= !isNumber(token);
+
+  if(isHeader) {
+    names = tokens;
+  } else {
+    rewind(file); // the first line contains data
+    names.clear();
+    for(size_t i = 0; i + 1 < tokens.size(); ++i) names.push_back("Z" + std::to_string(i));
+    if(!tokens.empty()) names.push_back("truth");
   }
+  return !names.empty();
+}
 
-  bool truth = rawvals.back();
-  rawvals.pop_back();
+/**
+ * parse a block of lines into columns.
+ * empty lines and lines starting with '#' are ignored, lines with the wrong number of values are skipped (and counted)
+ */
+void parseBlock(const std::string& text, size_t nColumns, ParsedBlock& block)
+{
+  block.columns.resize(nColumns);
+  for(std::vector<double>& column : block.columns) column.clear();
+  block.nRows = 0;
+  block.nBad = 0;
+
+  std::vector<double> values(nColumns);
+  const char* pos = text.c_str();
+  const char* end = pos + text.size();
+  while(pos < end) {
+    const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+    if(lineEnd == 0) lineEnd = end;
 
-  return Line(rawvals, truth);
+    if(datfile::isDataLine(pos, lineEnd)) {
+      if(datfile::parseLine(pos, lineEnd, values.data(), nColumns) == int(nColumns)) {
+        for(size_t i = 0; i < nColumns; ++i) block.columns[i].push_back(values[i]);
+        block.nRows++;
+      } else {
+        block.nBad++;
+      }
+    }
+    pos = lineEnd + 1;
+  }
 }
 
-/** read nLines (or until EOF) from infile and return vector of Lines */
-std::vector<Line> readNLines(ifstream& infile, unsigned int nLines)
+/**
+ * read the rows [rowBegin, rowEnd) via the index of the .dat file and put them into columns.
+ * rows with the wrong number of values are skipped (and counted)
+ */
+void readIndexedBlock(const datfile::DatReader& reader, uint64_t rowBegin, uint64_t rowEnd, ParsedBlock& block)
 {
-  vector<Line> lines{};
-  unsigned int lCtr{};
-  while(!infile.eof() && lCtr < nLines) {
-    string s;
-    getline(infile, s);
-    // cout << s << endl;
-    if(!s.empty()) lines.push_back(convertStringToLine(s));
-    // lines.back().Print();
-    lCtr++;
+  const size_t nColumns = reader.getNColumns();
+  block.columns.resize(nColumns);
+  for(std::vector<double>& column : block.columns) column.clear();
+  block.nRows = 0;
+  block.nBad = 0;
+
+  block.rows.resize((rowEnd - rowBegin) * nColumns);
+  reader.readRows(rowBegin, rowEnd, block.rows.data());
+  for(size_t iRow = 0; iRow < rowEnd - rowBegin; ++iRow) {
+    const double* row = &block.rows[iRow * nColumns];
+    if(row[0] != row[0]) { block.nBad++; continue; } // bad rows are filled with NaN by the reader
+    for(size_t i = 0; i < nColumns; ++i) block.columns[i].push_back(row[i]);
+    block.nRows++;
   }
-  return lines;
 }
 
 /**
  * create the .root file from the
  * @param: filename, dat file name
  * @param: outfilename, filename of the output file
+ * @param: nThreads, number of threads used for parsing (0 for all hardware threads)
+ * @param: options, layout and compression of the output file
+ * @return: false if the input could not be read or the output could not be written
  */
-void convertToRootFile(char* filename, char* outfilename)
+bool convertToRootFile(char* filename, char* outfilename, unsigned nThreads, const OutputOptions& options)
 {
-  ifstream infile(filename, ifstream::in);
-  // int nCols = getNColumns(infile);
+  TT_PROFILE_SCOPE("dat2root");
+  MemoryStage memory;
+  FILE* infile = fopen(filename, "r");
+  if(infile == 0) {
+    cout << "ERROR: could not open file " << filename << endl;
+    return false;
+  }
+  std::vector<std::string> names;
+  if(!readBranchNames(infile, names)) {
+    cout << "ERROR: could not determine the columns of file " << filename << endl;
+    fclose(infile);
+    return false;
+  }
+  const size_t nColumns = names.size();
 
+  // all columns but the last are stored as doubles, the last one (truth) is converted to bool and stored as int
+  // the vectors are only cleared after every Fill, so that they keep their memory (and the addresses stay valid)
   RootFile rootfile(outfilename,"testtree");
-  std::array<std::vector<double>,9> branches;
+  if(rootfile.file->IsZombie()) {
+    cout << "ERROR: could not create output file " << outfilename << endl;
+    fclose(infile);
+    return false;
+  }
+  if(options.compression >= 0) rootfile.file->SetCompressionSettings(options.compression); // has to be set before the branches are created
+  std::vector<std::vector<double> > branches(nColumns - 1);
   std::vector<int> truth;
-  for(size_t i = 0; i < branches.size(); ++i) {
-    stringstream name{}; name << "Z" << i;
-    rootfile.AddBranch(name.str().c_str(), branches[i]);
+  std::vector<double> scalars(nColumns - 1);
+  int scalarTruth = 0;
+  for(size_t i = 0; i + 1 < nColumns; ++i) {
+    if(options.scalar) rootfile.AddScalarBranch(names[i], &scalars[i], "D");
+    else rootfile.AddBranch(names[i], branches[i]);
   }
-  rootfile.AddBranch("truth", truth);
+  if(options.scalar) rootfile.AddScalarBranch(names.back(), &scalarTruth, "I");
+  else rootfile.AddBranch(names.back(), truth);
+  if(options.basketSize > 0) rootfile.tree->SetBasketSize("*", options.basketSize);
+  if(options.autoFlush != 0) rootfile.tree->SetAutoFlush(options.autoFlush);
 
-
-  std::vector<Line> lineValues{};
-  static size_t linnr = 0;
-  high_resolution_clock::time_point start = high_resolution_clock::now(); // measure time
-  for(;;) {
-    lineValues = readNLines(infile, 100); // COULDDO: increase this number (100 - 1000 seems to be optimum)
-    if(lineValues.empty()) break;
-    linnr += lineValues.size();
-
-    // clear vectors and arrays before readin
-    std::array<std::vector<double>,9> emptyBranches{};
-    branches.swap(emptyBranches);
-    truth.clear();
-
-    for(Line line: lineValues) {
-      for(size_t i = 0; i < branches.size(); ++i) {
-        branches[i].push_back(line.values[i]);
-      }
-      truth.push_back(line.truth);
+  const size_t linesPerEntry = options.linesPerEntry;
+  size_t linnr = 0;
+  size_t nBad = 0;
+  TicTocTimer timer(1000000); // want ms
+  // if there is a valid index (see datindex) the workers read and parse independent row ranges, else the file is read sequentially
+  // and only the parsing is done by the workers
+  datfile::DatIndex index;
+  bool indexed = options.rowRange ? index.loadOrBuild(filename) : index.load(filename);
+  datfile::DatReader* indexedReader = 0;
+  if(indexed) {
+    indexedReader = new datfile::DatReader(filename);
+    if(!indexedReader->good() || indexedReader->getNColumns() != nColumns) {
+      cout << "WARNING: index of file " << filename << " cannot be used, reading sequentially" << endl;
+      delete indexedReader;
+      indexedReader = 0;
     }
-
-    rootfile.tree->Fill();
   }
+  if(indexedReader == 0 && options.rowRange) {
+    cout << "ERROR: cannot convert a row range without a valid index" << endl;
+    fclose(infile);
+    return false;
+  }
+  uint64_t nextRow = options.rowRange ? options.rowBegin : 0;
+  const uint64_t lastRow = indexedReader ? std::min(options.rowRange ? options.rowEnd : indexedReader->getNRows(), indexedReader->getNRows()) : 0;
+
+  DatBlockReader reader(infile);
+  parallel::OrderedPipeline<DatBlock, ParsedBlock> pipeline(parallel::getNThreads(nThreads));
+  pipeline.run([&](DatBlock& block) {
+                 TT_PROFILE_SCOPE("read_block");
+                 if(indexedReader == 0) return reader.next(block.text);
+                 if(nextRow >= lastRow) return false;
+                 block.rowBegin = nextRow;
+                 block.rowEnd = nextRow = std::min(nextRow + indexedBlockRows, lastRow);
+                 return true;
+               },
+               [&](DatBlock& block, ParsedBlock& parsed) {
+                 TT_PROFILE_SCOPE("parse_block");
+                 if(indexedReader) readIndexedBlock(*indexedReader, block.rowBegin, block.rowEnd, parsed);
+                 else parseBlock(block.text, nColumns, parsed);
+               },
+               [&](ParsedBlock& block) { // writer: fills the tree in the order of the input file
+                 TT_PROFILE_SCOPE("fill_block");
+                 nBad += block.nBad;
+                 linnr += block.nRows;
+                 if(options.scalar) {
+                   for(size_t row = 0; row < block.nRows; ++row) {
+                     for(size_t i = 0; i < scalars.size(); ++i) scalars[i] = block.columns[i][row];
+                     scalarTruth = bool(block.columns.back()[row]);
+                     rootfile.tree->Fill();
+                   }
+                   return;
+                 }
+                 for(size_t row = 0; row < block.nRows; ) {
+                   size_t n = std::min(linesPerEntry - truth.size(), block.nRows - row);
+                   for(size_t i = 0; i < branches.size(); ++i) {
+                     branches[i].insert(branches[i].end(), block.columns[i].begin() + row, block.columns[i].begin() + row + n);
+                   }
+                   const std::vector<double>& truthColumn = block.columns.back();
+                   for(size_t j = row; j < row + n; ++j) truth.push_back(bool(truthColumn[j]));
+                   row += n;
+                   if(truth.size() == linesPerEntry) {
+                     rootfile.tree->Fill();
+                     for(std::vector<double>& branch : branches) branch.clear();
+                     truth.clear();
+                   }
+                 }
+               });
+  if(!truth.empty()) rootfile.tree->Fill(); // last (incomplete) entry
+
   cout << "read " << linnr << " lines from file: " << filename << endl;
+  if(nBad) cout << "WARNING: skipped " << nBad << " lines that did not have " << nColumns << " values" << endl;
 
-  infile.close();
-  rootfile.Write();
-  high_resolution_clock::time_point end = high_resolution_clock::now();
-  cout << "duration: " << chrono::duration_cast<chrono::microseconds>(end - start).count() / 1000. << " ms" << endl;
+  fclose(infile);
+  delete indexedReader;
+  if(!rootfile.Write()) {
+    cout << "ERROR: could not write output file " << outfilename << endl;
+    return false;
+  }
+  cout << "duration: " << timer << endl;
+  cout << "memory: " << memory << endl;
+  cout << "size: " << rootfile.tree->GetTotBytes() << " bytes uncompressed, " << rootfile.tree->GetZipBytes() << " bytes compressed" << endl;
+  return true;
 }
 
 #ifndef __CINT__
@@ -187,12 +432,46 @@ void convertToRootFile(char* filename, char* outfilename)
  */
 int main(int argc, char* argv[])
 {
-  if(argc != 3) {
+  unsigned nThreads = 0;
+  OutputOptions options;
+  int opt;
+  while((opt = getopt(argc, argv, "j:n:sc:B:f:r:")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = atoi(optarg); break;
+    case 'n': options.linesPerEntry = std::max(1, atoi(optarg)); break;
+    case 's': options.scalar = true; break;
+    case 'c':
+      if(!parseCompression(optarg, options.compression)) {
+        cout << "unknown compression " << optarg << " (valid: zlib, lzma, lz4, zstd, none, optionally followed by :level)" << endl;
+        return -1;
+      }
+      break;
+    case 'B': options.basketSize = atoi(optarg); break;
+    case 'f': options.autoFlush = atoll(optarg); break;
+    case 'r':
+      options.rowRange = datfile::parseRowRange(optarg, options.rowBegin, options.rowEnd);
+      if(!options.rowRange) {
+        cout << "invalid row range " << optarg << " (expected first:last)" << endl;
+        return -1;
+      }
+      break;
+    default:
+      cout << "usage: " << argv[0] << " [-j nThreads] [-n linesPerEntry | -s] [-c algorithm[:level]] [-B basketSize] [-f autoFlush] [-r first:last] datfile outputfile" << endl;
+      cout << "  -n: number of lines per entry (vector branches, default " << defaultLinesPerEntry << ")" << endl;
+      cout << "  -s: one line per entry (scalar branches)" << endl;
+      cout << "  -c: compression (zlib, lzma, lz4, zstd or none)" << endl;
+      cout << "  -B: basket size in bytes, -f: auto flush (> 0: entries, < 0: bytes)" << endl;
+      cout << "  -r: convert only the rows [first, last) (uses the index of the .dat file, see datindex)" << endl;
+      return -1;
+    }
+  }
+  if(argc - optind != 2) {
     cout << "please provide a .dat file and an output file name" << endl;
     return -1;
   }
 
-  convertToRootFile(argv[1], argv[2]);
+  ROOT::EnableThreadSafety(); // the tree is filled on the writer thread of the pipeline
+  if(!convertToRootFile(argv[optind], argv[optind + 1], nThreads, options)) return -1;
   return 0;
 }
 
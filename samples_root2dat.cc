@@ -12,30 +12,44 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <sstream>
+#include <iomanip>
+#include <climits>
+
+// getopt, glob
+#include <unistd.h>
+#include <glob.h>
 
 // ROOT
 #include "TFile.h"
 #include "TTree.h"
 #include "TBranch.h"
+#include "TROOT.h"
+
+#include "parallel_helper.h"
+#include "datformat.h"
+#include "samplechunk.h"
+#include "matfile.h"
+#include "tt_timer.h"
+#include "tt_profiler.h"
+#include "tt_memory.h"
+#include "vxdfilter.h"
 
 using namespace std;
 using namespace ROOT;
+using namespace timing;
 
-/** name of the TTree in the root file*/
-const std::string treename = "ThreeHitSamplesTree";
-/** name of the branches in the TTree */
-const std::vector<std::string> branchnames = { "hit1X", "hit1Y", "hit1Z", "hit2X", "hit2Y", "hit2Z",
-                                               "hit3X", "hit3Y", "hit3Z", "truth", "vxdid1", "vxdid2", "vxdid3",
-                                               "pT", "momentum", "charge", "pdg" };
 
-/** number of all branches containing a vector<double> */
-const size_t npositions = 9;
+/** maximum number of events (TTree entries) that are put into one chunk (chunks never span more than one cluster) */
+const long long maxChunkEvents = 256;
 
-/** number of all branches containing a vector<short> */
-const size_t nvxdids = 3;
-
-/** number of all branches containing momentum/charge information */
-const size_t nadditional = 3;
+/** size of the TTreeCache used for prefetching whole clusters (in bytes) */
+const long long treeCacheSize = 64 * 1024 * 1024;
 
 /** helper struct that can be used to get the values from the root file */
 struct RootBranches {
@@ -88,15 +102,58 @@ void setBranchAddresses(TTree* tree, RootBranches& branches)
   }
 }
 
+
 /**
- * get the data from the event onto the RootBranches, from where they can than be written to the file
- * @param: tree, the TTree containing the data
- * @param: branches, the RootBranches helper struct to which the data will be transfered
- * @param: event, the event number for which the data shall be obtained
+ * helper class that reads the tree in chunks, where a chunk never crosses a cluster boundary.
+ * The whole cluster is prefetched into the TTreeCache with one (bulk) read, so that GetEntry only has to decompress
  */
-void getEvent(TTree* tree, RootBranches& branches, unsigned event)
+class ChunkedTreeReader {
+public:
+  ChunkedTreeReader(TTree* tree, RootBranches& branches);
+
+  /** read the next chunk. @returns false if there are no more events */
+  bool next(SampleChunk& chunk);
+
+  long long getNEvents() const { return m_nEvents; } /**< number of events in the tree */
+
+private:
+  TTree* m_tree; /**< the tree */
+  RootBranches& m_branches; /**< the branches (with addresses set) */
+  TTree::TClusterIterator m_clusterIt; /**< iterator over the clusters of the tree */
+  long long m_nEvents; /**< number of events in the tree */
+  long long m_nextEvent; /**< next event to read */
+  long long m_clusterEnd; /**< first event after the current cluster */
+};
+
+ChunkedTreeReader::ChunkedTreeReader(TTree* tree, RootBranches& branches) :
+  m_tree(tree), m_branches(branches), m_clusterIt(tree->GetClusterIterator(0)), m_nEvents(tree->GetEntries()), m_nextEvent(0), m_clusterEnd(0)
 {
-  tree->GetEvent(event);
+  m_tree->SetCacheSize(treeCacheSize);
+  m_tree->AddBranchToCache("*", true);
+}
+
+bool ChunkedTreeReader::next(SampleChunk& chunk)
+{
+  chunk.clear();
+  if(m_nextEvent >= m_nEvents) return false;
+  if(m_nextEvent >= m_clusterEnd) {
+    m_clusterIt.Next();
+    m_clusterEnd = std::min(m_clusterIt.GetNextEntry(), m_nEvents);
+    if(m_clusterEnd <= m_nextEvent) m_clusterEnd = m_nEvents; // should not happen, but safeguard against endless loops
+  }
+
+  const long long lastEvent = std::min(m_clusterEnd, m_nextEvent + maxChunkEvents);
+  for(; m_nextEvent < lastEvent; ++m_nextEvent) {
+    m_tree->GetEntry(m_nextEvent);
+    const RootBranches& br = m_branches;
+    for(size_t j = 0; j < npositions; ++j) chunk.positions[j].insert(chunk.positions[j].end(), br.positions[j]->begin(), br.positions[j]->end());
+    for(size_t j = 0; j < nvxdids; ++j) chunk.vxdids[j].insert(chunk.vxdids[j].end(), br.vxdids[j]->begin(), br.vxdids[j]->end());
+    for(size_t j = 0; j < nadditional; ++j) chunk.additionalInfo[j].insert(chunk.additionalInfo[j].end(), br.additionalInfo[j]->begin(), br.additionalInfo[j]->end());
+    chunk.pdg.insert(chunk.pdg.end(), br.pdg->begin(), br.pdg->end());
+    chunk.signal.insert(chunk.signal.end(), br.signal->begin(), br.signal->end());
+  }
+
+  return true;
 }
 
 /**
@@ -108,66 +165,463 @@ void writeFileHeader(ofstream& outfile)
   outfile << "# sp_1_x  sp_1_y  sp_1_z  sp_2_x  sp_2_y  sp_2_z  sp_3_x  sp_3_y  sp_3_z  vxdid1  vxdid2  vxdid3 pT momentum charge pdg signal" << endl;
 }
 
+
+/** helper struct holding the statistics of a conversion */
+struct ConversionStats {
+  ConversionStats() : nSamples(0), nSignal(0), ok(false) {}
+  size_t nSamples; /**< number of samples written */
+  size_t nSignal; /**< number of signal samples written */
+  bool ok; /**< could the file be converted */
+};
+
+
 /**
- * write the content of the RootBranches helper struct to the file
- * @param: branches, the RootBranches helper struct, which contents shall be written to a .dat file
- * @param: outfile, the outfile streamer to which the data shall be written
+ * create the .dat file from the
+ * @param: filename, root file name
+ * @param: outfilename, filename of the output file
+ * @param: nThreads, number of threads used for formatting (0 for all hardware threads)
+ * @param: roundtrip, write doubles with full precision (NOTE: the output differs from the default format in this case!)
+ * @param: topology, write the topology code of every sample (before the signal flag) and the VXD filter index (outfilename.vxd)
+ *
+ * The tree is read cluster-wise (in chunks) on the calling thread, the chunks are formatted in parallel and a single writer thread
+ * writes the formatted chunks in order, such that the output is the same as if everything was done sequentially.
  */
-void writeToFile(const RootBranches& branches, ofstream& outfile)
+ConversionStats convertToDatFile(const char* filename, const char* outfilename, unsigned nThreads, bool roundtrip, bool topology)
 {
-  for(size_t i = 0; i < branches.signal->size(); ++i) {
-    for (size_t j = 0; j < npositions; ++j){
-      outfile << branches.positions[j]->operator[](i) << " ";
-    }
-    for (size_t j = 0; j < nvxdids; ++j ) {
-      outfile << branches.vxdids[j]->operator[](i) << " ";
-    }
-    for (size_t j = 0; j < nadditional; ++j) {
-      outfile << branches.additionalInfo[j]->operator[](i) << " ";
-    }
-    outfile << branches.pdg->operator[](i) << " ";
-    outfile << branches.signal->operator[](i) << endl;
+  TT_PROFILE_SCOPE("root2dat");
+  MemoryStage memory;
+  ConversionStats stats;
+  TFile* infile = TFile::Open(filename);
+  if(infile == 0) {
+    cout << "ERROR: could not open root file " << filename << endl;
+    return stats;
+  }
+  TTree* tree = (TTree*) infile->Get(treename.c_str());
+  if(tree == 0) {
+    cout << "ERROR: could not get tree " << treename << " from file " << filename << endl;
+    delete infile;
+    return stats;
   }
+  RootBranches branches;
+
+  setBranchAddresses(tree, branches);
+  ChunkedTreeReader reader(tree, branches);
+
+  ofstream outfile(outfilename, ofstream::out | ofstream::binary);
+  // writeFileHeader(outfile); // ommit when using with MATLAB (TODO: find an easy (and fast) way in MATLAB to ignore comments)
+
+  TicTocTimer timer(1000000); // want ms
+  RootToolBox::VXDFilterIndex vxdIndex;
+  parallel::OrderedPipeline<SampleChunk, FormattedChunk> pipeline(parallel::getNThreads(nThreads));
+  pipeline.run([&](SampleChunk& chunk) { TT_PROFILE_SCOPE("read_chunk"); return reader.next(chunk); },
+               [&](SampleChunk& chunk, FormattedChunk& formatted) {
+                 TT_PROFILE_SCOPE("format_chunk");
+                 formatChunk(chunk, formatted, roundtrip, topology);
+               },
+               [&](FormattedChunk& formatted) {
+                 TT_PROFILE_SCOPE("write_chunk");
+                 stats.nSamples += formatted.nSamples;
+                 stats.nSignal += formatted.nSignal;
+                 outfile.write(formatted.buffer.data(), formatted.buffer.size());
+                 for(unsigned code : formatted.topology) vxdIndex.add(code);
+               });
+
+  outfile.close();
+  stats.ok = !outfile.fail();
+  if(topology && !datfile::writeVXDFilterIndex(outfilename, vxdIndex)) {
+    cout << "ERROR: could not write VXD filter index " << RootToolBox::VXDFilterIndex::getSidecarName(outfilename) << endl;
+    stats.ok = false;
+  }
+  if(!topology) datfile::removeVXDFilterIndex(outfilename); // would belong to an older version of the file
+  cout << "wrote " << stats.nSamples << " samples from " << reader.getNEvents() << " events to file " << outfilename << ". " << timer
+       << " " << memory << endl;
+  infile->Close();
+  delete infile;
+  return stats;
 }
 
+
 /**
- * create the .dat file from the
+ * create a MAT-file (version 5) from the root file, containing one 17xN matrix (same layout as the matrices read in from the .dat
+ * files in MATLAB), such that it can be read in via load without any parsing and without loss of precision
  * @param: filename, root file name
  * @param: outfilename, filename of the output file
+ * @param: nThreads, number of threads used for converting the chunks (0 for all hardware threads)
+ * @param: compress, compress the matrix (zlib)
+ * @param: varname, name of the matrix in MATLAB
+ * @param: topology, add the topology code of every sample (row before the signal flag)
  */
-void convertToDatFile(char* filename, char* outfilename)
+ConversionStats convertToMatFile(const char* filename, const char* outfilename, unsigned nThreads, bool compress, std::string varname,
+                                 bool topology)
 {
+  TT_PROFILE_SCOPE("root2mat");
+  MemoryStage memory;
+  ConversionStats stats;
   TFile* infile = TFile::Open(filename);
+  if(infile == 0) {
+    cout << "ERROR: could not open root file " << filename << endl;
+    return stats;
+  }
   TTree* tree = (TTree*) infile->Get(treename.c_str());
+  if(tree == 0) {
+    cout << "ERROR: could not get tree " << treename << " from file " << filename << endl;
+    delete infile;
+    return stats;
+  }
   RootBranches branches;
-
   setBranchAddresses(tree, branches);
 
-  ofstream outfile(outfilename, ofstream::out);
-  // writeFileHeader(outfile); // ommit when using with MATLAB (TODO: find an easy (and fast) way in MATLAB to ignore comments)
+  TicTocTimer timer(1000000); // want ms
+  // the dimensions of the matrix have to be known before writing -> count the samples by reading only the signal branch
+  TBranch* signalBranch = tree->GetBranch(branchnames[npositions].c_str());
+  size_t nSamples = 0;
+  for(long long i = 0; i < tree->GetEntries(); ++i) {
+    signalBranch->GetEntry(i);
+    nSamples += branches.signal->size();
+  }
 
-  // get the data event-wise and write them to the file immediately
-  for(unsigned i = 0; i < tree->GetEntries(); ++i) {
-    getEvent(tree, branches, i);
-    writeToFile(branches, outfile);
+  const size_t nValues = nValuesPerSample + topology;
+  matfile::MatFileWriter writer(outfilename);
+  if(!writer.beginMatrix(varname, nValues, nSamples, compress)) {
+    delete infile;
+    return stats;
   }
 
-  outfile.close();
+  ChunkedTreeReader reader(tree, branches);
+  parallel::OrderedPipeline<SampleChunk, std::vector<double> > pipeline(parallel::getNThreads(nThreads));
+  pipeline.run([&](SampleChunk& chunk) { TT_PROFILE_SCOPE("read_chunk"); return reader.next(chunk); },
+               [&](SampleChunk& chunk, std::vector<double>& values) { TT_PROFILE_SCOPE("convert_chunk"); chunkToMatrix(chunk, values, topology); },
+               [&](std::vector<double>& values) {
+                 TT_PROFILE_SCOPE("write_chunk");
+                 stats.nSamples += values.size() / nValues;
+                 for(size_t i = nValues - 1; i < values.size(); i += nValues) stats.nSignal += values[i] != 0;
+                 writer.append(values.data(), values.size());
+               });
+  writer.endMatrix();
+
+  stats.ok = writer.good() && stats.nSamples == nSamples;
+  cout << "wrote " << stats.nSamples << " samples (" << nValues << "x" << nSamples << " matrix '" << varname << "') to file "
+       << outfilename << ". " << timer << " " << memory << endl;
+  infile->Close();
+  delete infile;
+  return stats;
+}
+
+/////////////////////////////////////////////
+// BATCH MODE (many files, merging, shards) //
+/////////////////////////////////////////////
+
+/** helper struct describing one output file of a batch conversion (for the manifest) */
+struct OutputEntry {
+  OutputEntry(std::string n) : name(n), nSamples(0), nSignal(0) {}
+  std::string name; /**< name of the output file */
+  size_t nSamples; /**< number of samples in the file */
+  size_t nSignal; /**< number of signal samples in the file */
+};
+
+/**
+ * expand the passed input arguments to a list of files. Every argument can either be a glob pattern (e.g. "samples_*.root")
+ * or a file list (prefixed with @, e.g. "@files.txt") containing one file (or glob pattern) per line
+ */
+std::vector<std::string> expandInputs(const std::vector<std::string>& args)
+{
+  std::vector<std::string> files;
+  for(const std::string& arg : args) {
+    if(!arg.empty() && arg[0] == '@') {
+      ifstream listfile(arg.substr(1));
+      if(!listfile) cout << "ERROR: could not open file list " << arg.substr(1) << endl;
+      std::string line;
+      std::vector<std::string> listed;
+      while(getline(listfile, line)) {
+        if(!line.empty() && line[0] != '#') listed.push_back(line);
+      }
+      std::vector<std::string> expanded = expandInputs(listed);
+      files.insert(files.end(), expanded.begin(), expanded.end());
+      continue;
+    }
+
+    glob_t globbuf;
+    if(glob(arg.c_str(), GLOB_TILDE | GLOB_NOCHECK, 0, &globbuf) == 0) {
+      for(size_t i = 0; i < globbuf.gl_pathc; ++i) files.push_back(globbuf.gl_pathv[i]);
+    }
+    globfree(&globbuf);
+  }
+  return files;
+}
+
+/**
+ * remove inputs that occur more than once (e.g. a file that matches several patterns or is listed twice), keeping the first occurrence.
+ * Files are compared by their canonical path (if they exist), such that the same file is never converted twice
+ */
+std::vector<std::string> removeDuplicateInputs(const std::vector<std::string>& files)
+{
+  std::vector<std::string> unique;
+  std::vector<std::string> canonical;
+  for(const std::string& file : files) {
+    char resolved[PATH_MAX];
+    std::string path = realpath(file.c_str(), resolved) != 0 ? std::string(resolved) : file;
+    if(std::find(canonical.begin(), canonical.end(), path) != canonical.end()) {
+      cout << "WARNING: ignoring duplicate input " << file << endl;
+      continue;
+    }
+    canonical.push_back(path);
+    unique.push_back(file);
+  }
+  return unique;
+}
+
+/** get the name of a file without directories and extension */
+std::string getBaseName(const std::string& filename)
+{
+  std::string base = filename.substr(filename.find_last_of('/') + 1);
+  return base.substr(0, base.find_last_of('.'));
+}
+
+/** get the name of the output of input iInput (the index keeps the names unique if inputs from different directories have the same name) */
+std::string getBatchOutputName(const std::string& outprefix, size_t iInput, const std::string& input)
+{
+  std::stringstream name{};
+  name << outprefix << "_" << std::setw(5) << std::setfill('0') << iInput << "_" << getBaseName(input) << ".dat";
+  return name.str();
+}
+
+/** get the name of shard iShard */
+std::string getShardName(const std::string& outprefix, size_t iShard)
+{
+  std::stringstream name{};
+  name << outprefix << "_" << std::setw(5) << std::setfill('0') << iShard << ".dat";
+  return name.str();
+}
+
+/**
+ * copy the (already converted) .dat files into the outputs, in the order of the passed files.
+ * if shardSize is 0, everything is merged into one file, else a new file is started after every shardSize samples
+ */
+std::vector<OutputEntry> mergeDatFiles(const std::vector<std::string>& datfiles, const std::string& outprefix, size_t shardSize)
+{
+  std::vector<OutputEntry> outputs;
+  FILE* outfile = 0;
+  auto openNext = [&]() {
+    if(outfile) fclose(outfile);
+    outputs.push_back(OutputEntry(shardSize ? getShardName(outprefix, outputs.size()) : outprefix + ".dat"));
+    outfile = fopen(outputs.back().name.c_str(), "wb");
+    if(outfile == 0) cout << "ERROR: could not open output file " << outputs.back().name << endl;
+  };
+  openNext();
+
+  std::vector<char> buffer(1 << 22);
+  char last = '\n', beforeLast = '\n'; // last two characters that have been read (signal flag is the last character of a line)
+  for(const std::string& datfile : datfiles) {
+    FILE* infile = fopen(datfile.c_str(), "rb");
+    if(infile == 0) {
+      cout << "ERROR: could not open intermediate file " << datfile << endl;
+      continue;
+    }
+    size_t nRead;
+    while((nRead = fread(buffer.data(), 1, buffer.size(), infile)) > 0) {
+      size_t begin = 0; // begin of the part of the buffer that has not yet been written
+      for(size_t i = 0; i < nRead; ++i) {
+        beforeLast = last;
+        last = buffer[i];
+        if(last != '\n') continue;
+        outputs.back().nSamples++;
+        outputs.back().nSignal += beforeLast == '1';
+        if(shardSize && outputs.back().nSamples == shardSize) { // shard is full: write everything up to here and start a new one
+          if(outfile) fwrite(buffer.data() + begin, 1, i + 1 - begin, outfile);
+          begin = i + 1;
+          openNext();
+        }
+      }
+      if(outfile) fwrite(buffer.data() + begin, 1, nRead - begin, outfile);
+    }
+    fclose(infile);
+  }
+  if(outfile) fclose(outfile);
+  if(shardSize && outputs.size() > 1 && outputs.back().nSamples == 0) { // do not leave an empty last shard
+    remove(outputs.back().name.c_str());
+    outputs.pop_back();
+  }
+  return outputs;
+}
+
+/** write a manifest with the number of samples (and signal/background samples) for every input and output file */
+void writeManifest(const std::string& filename, const std::vector<std::string>& inputs, const std::vector<ConversionStats>& stats,
+                   const std::vector<OutputEntry>& outputs)
+{
+  ofstream manifest(filename.c_str());
+  manifest << "# root2dat manifest" << endl;
+  manifest << "# type file samples signal background" << endl;
+  size_t nTotal = 0, nSignalTotal = 0;
+  for(size_t i = 0; i < inputs.size(); ++i) {
+    manifest << "input " << inputs[i] << " " << stats[i].nSamples << " " << stats[i].nSignal << " " << stats[i].nSamples - stats[i].nSignal
+             << (stats[i].ok ? "" : " FAILED") << endl;
+    nTotal += stats[i].nSamples;
+    nSignalTotal += stats[i].nSignal;
+  }
+  for(const OutputEntry& output : outputs) {
+    manifest << "output " << output.name << " " << output.nSamples << " " << output.nSignal << " " << output.nSamples - output.nSignal << endl;
+  }
+  manifest << "total all " << nTotal << " " << nSignalTotal << " " << nTotal - nSignalTotal << endl;
+}
+
+/**
+ * convert many root files to .dat files concurrently (at most nWorkers files at the same time)
+ * @param: inputs, the input files
+ * @param: outprefix, prefix of all output files (and the manifest: outprefix.manifest)
+ * @param: merge, merge all files into outprefix.dat (in the order of the inputs)
+ * @param: shardSize, if > 0 re-shard the outputs into files with shardSize samples (outprefix_00000.dat, ...)
+ * if neither merge nor shardSize are set, every input is converted to outprefix_<index>_<inputname>.dat
+ * @param: topology, write the topology codes and the VXD filter index of every output file
+ * inputs that could not be converted are not merged (and their outputs are removed), they are marked as FAILED in the manifest
+ * @returns false if any of the inputs could not be converted
+ */
+bool convertBatch(const std::vector<std::string>& inputs, const std::string& outprefix, unsigned nWorkers, unsigned nThreads,
+                  bool roundtrip, bool merge, size_t shardSize, bool topology)
+{
+  ROOT::EnableThreadSafety(); // every worker opens its own TFile
+  nWorkers = std::max(1u, std::min<unsigned>(parallel::getNThreads(nWorkers), inputs.size()));
+  if(nThreads == 0) nThreads = std::max(1u, parallel::getNThreads() / nWorkers); // share the hardware threads among the workers
+
+  const bool combine = merge || shardSize > 0;
+  std::vector<std::string> datfiles;
+  for(size_t i = 0; i < inputs.size(); ++i) {
+    std::string name = getBatchOutputName(outprefix, i, inputs[i]);
+    if(combine) name += ".tmp";
+    datfiles.push_back(name);
+  }
+
+  TicTocTimer timer(1000000); // want ms
+  std::vector<ConversionStats> stats(inputs.size());
+  std::atomic<size_t> nextFile(0);
+  std::vector<std::thread> workers;
+  for(unsigned i = 0; i < nWorkers; ++i) {
+    workers.push_back(std::thread([&]() {
+          for(size_t iFile = nextFile++; iFile < inputs.size(); iFile = nextFile++) {
+            stats[iFile] = convertToDatFile(inputs[iFile].c_str(), datfiles[iFile].c_str(), nThreads, roundtrip, topology);
+          }
+        }));
+  }
+  for(std::thread& worker : workers) worker.join();
+  cout << "converted " << inputs.size() << " files with " << nWorkers << " workers. " << timer << endl;
+  std::vector<std::string> converted; // outputs of the inputs that could be converted
+  size_t nFailed = 0;
+  for(size_t i = 0; i < inputs.size(); ++i) {
+    if(stats[i].ok) {
+      converted.push_back(datfiles[i]);
+      continue;
+    }
+    cout << "ERROR: conversion of " << inputs[i] << " failed, it is left out of the outputs" << endl;
+    nFailed++;
+    if(!combine) { // the tmp files are removed after merging
+      remove(datfiles[i].c_str());
+      if(topology) remove(RootToolBox::VXDFilterIndex::getSidecarName(datfiles[i]).c_str());
+    }
+  }
+
+  std::vector<OutputEntry> outputs;
+  if(combine) {
+    timer.tic();
+    outputs = mergeDatFiles(converted, outprefix, shardSize);
+    for(const std::string& datfile : datfiles) {
+      remove(datfile.c_str());
+      if(topology) remove(RootToolBox::VXDFilterIndex::getSidecarName(datfile).c_str());
+    }
+    // the samples are distributed differently in the outputs -> build their filter indices from the written topology codes
+    for(const OutputEntry& output : outputs) {
+      RootToolBox::VXDFilterIndex vxdIndex;
+      if(topology && (!datfile::buildVXDFilterIndex(output.name, -2, vxdIndex, nThreads) ||
+                      !datfile::writeVXDFilterIndex(output.name, vxdIndex))) {
+        cout << "ERROR: could not create VXD filter index of " << output.name << endl;
+      }
+      if(!topology) datfile::removeVXDFilterIndex(output.name);
+    }
+    cout << "wrote " << outputs.size() << " output files. " << timer << endl;
+  } else {
+    for(size_t i = 0; i < inputs.size(); ++i) {
+      if(!stats[i].ok) continue;
+      outputs.push_back(OutputEntry(datfiles[i]));
+      outputs.back().nSamples = stats[i].nSamples;
+      outputs.back().nSignal = stats[i].nSignal;
+    }
+  }
+
+  writeManifest(outprefix + ".manifest", inputs, stats, outputs);
+  cout << "wrote manifest " << outprefix << ".manifest" << endl;
+  if(nFailed) cout << "ERROR: " << nFailed << " of " << inputs.size() << " inputs could not be converted" << endl;
+  return nFailed == 0;
 }
 
 #ifndef __CINT__
 /**
  * main routine
  * first command line argument is root file, second is outputfile
+ * options: -j nThreads (number of formatting threads, default all hardware threads)
+ *          -r (write doubles with full (round trip) precision instead of the default precision, changes the output format! This is
+ *              the slow path of the conversion: up to 3 snprintf + strtod per value)
+ *          -t (write the topology code of every sample before the signal flag (see RootToolBox::getTopologyCode) and the
+ *              VXD filter index (outputfile.vxd), that can be used by the tools to select the samples of a filter_vxdid category)
+ * if the outputfile ends with .mat a MAT-file (version 5) is written instead of a .dat file
+ *          -z (compress the matrix in the MAT-file), -v name (name of the matrix in the MAT-file, default: data)
+ * batch mode: -b, all but the last argument are inputs (glob patterns or @filelist), the last one is the prefix for all outputs
+ *          -w nWorkers (number of files converted concurrently, default all hardware threads)
+ *          -m (merge all outputs into one file), -s shardSize (re-shard the outputs into files with shardSize samples)
+ *          a manifest with the number of (signal/background) samples per file is written to outputprefix.manifest
+ *          (duplicate inputs are converted only once, inputs that fail are left out and marked as FAILED in the manifest)
+ * returns non-zero if any conversion failed
  */
 int main(int argc, char* argv[])
 {
-  if(argc != 3) {
+  unsigned nThreads = 0;
+  unsigned nWorkers = 0;
+  bool roundtrip = false;
+  bool batch = false;
+  bool merge = false;
+  size_t shardSize = 0;
+  bool compress = false;
+  std::string varname = "data";
+  bool topology = false;
+  int opt;
+  while((opt = getopt(argc, argv, "j:rbw:ms:zv:t")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = std::max(0, atoi(optarg)); break;
+    case 'r': roundtrip = true; break;
+    case 'b': batch = true; break;
+    case 'w': nWorkers = std::max(0, atoi(optarg)); break;
+    case 'm': merge = true; break;
+    case 's': shardSize = std::max(0LL, atoll(optarg)); break;
+    case 'z': compress = true; break;
+    case 'v': varname = optarg; break;
+    case 't': topology = true; break;
+    default:
+      cout << "usage: " << argv[0] << " [-j nThreads] [-r] [-t] rootfile outputfile" << endl;
+      cout << "       " << argv[0] << " [-j nThreads] [-z] [-v name] [-t] rootfile outputfile.mat" << endl;
+      cout << "       " << argv[0] << " -b [-w nWorkers] [-m | -s shardSize] [-j nThreads] [-r] [-t] inputs... outputprefix" << endl;
+      cout << "  -r: write doubles with full (round trip) precision (slow path, up to 3 snprintf + strtod per value)" << endl;
+      return -1;
+    }
+  }
+
+  if(batch) {
+    if(argc - optind < 2) {
+      cout << "please provide at least one input (pattern or @filelist) and an output prefix!" << endl;
+      return -1;
+    }
+    std::vector<std::string> inputs = removeDuplicateInputs(expandInputs(std::vector<std::string>(argv + optind, argv + argc - 1)));
+    if(inputs.empty()) {
+      cout << "found no input files!" << endl;
+      return -1;
+    }
+    return convertBatch(inputs, argv[argc - 1], nWorkers, nThreads, roundtrip, merge, shardSize, topology) ? 0 : -1;
+  }
+
+  if(argc - optind != 2) {
     cout << "please provide a root file and an output file name!" << endl;
     return -1;
   }
-  convertToDatFile(argv[1], argv[2]);
-
-  return 0;
+  std::string outfilename(argv[optind + 1]);
+  if(outfilename.size() > 4 && outfilename.compare(outfilename.size() - 4, 4, ".mat") == 0) {
+    return convertToMatFile(argv[optind], argv[optind + 1], nThreads, compress, varname, topology).ok ? 0 : -1;
+  }
+  return convertToDatFile(argv[optind], argv[optind + 1], nThreads, roundtrip, topology).ok ? 0 : -1;
 }
 #endif
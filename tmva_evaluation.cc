@@ -9,129 +9,139 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <memory>
+
+// getopt
+#include <unistd.h>
 
 // chrono
 #include <chrono>
 
 // ROOT
-#include "TMVA/Reader.h"
 #include "TFile.h"
 #include "TTree.h"
+#include "TROOT.h"
 
 #include "TMVA/Factory.h"
 #include "TMVA/Tools.h"
 #include "TMVA/Config.h"
-#include "TPluginManager.h"
 
 // ROOT toolbox
-#include "RootToolBox/RootFileData.hpp"
-#include "RootToolBox/RootTreeData.hpp"
+#include "RootToolBox/RootFile.hpp"
+#include "RootToolBox/RootChunkReader.hpp"
+
+#include "tmva_reader.h"
+#include "parallel_helper.h"
+#include "tt_profiler.h"
+#include "tt_memory.h"
 
 using namespace std;
 using namespace ROOT;
 using namespace RootToolBox;
+using namespace timing;
 using std::chrono::high_resolution_clock;
 
-/**
- * load the FastBDT plugin (copied from framework)
- */
-void loadPlugins(const std::string& name)
-{
-  std::string base = "TMVA@@MethodBase";
-  std::string regexp1 = std::string(".*_") + name + std::string(".*");
-  std::string regexp2 = std::string(".*") + name + std::string(".*");
-  std::string className = std::string("TMVA::Method") + name;
-  std::string pluginName = std::string("TMVA") + name;
-  std::string ctor1 = std::string("Method") + name + std::string("(DataSetInfo&,TString)");
-  std::string ctor2 = std::string("Method") + name + std::string("(TString&, TString&,DataSetInfo&,TString&)");
-
-  gPluginMgr->AddHandler(base.c_str(), regexp1.c_str(), className.c_str(), pluginName.c_str(), ctor1.c_str());
-  gPluginMgr->AddHandler(base.c_str(), regexp2.c_str(), className.c_str(), pluginName.c_str(), ctor2.c_str());
-}
+/** number of events that are read from the tree at once (per thread) */
+const int chunkSize = 1000;
 
-/**
- * small helper class to keep the TMVAReader and pointers to it contained
- * currently allows only one booked method (but should be no problem for us)
- */
-class TMVAReader {
-public:
-  TMVAReader(std::string method, std::string weightfile); /**< ctor from method name and weightfile*/
-  ~TMVAReader() { delete m_reader; } /**< destructor */
-  template<class T> void addVariable(std::string name, T& var); /**< add variable */
-  std::string getBookMethod() { return m_method; } /**< get the method */
-  void bookMethod() { m_reader->BookMVA(m_method, m_weightfile); }
-  double evaluate() { return m_reader->EvaluateMVA(m_method); }
-private:
-  TMVA::Reader* m_reader;
-  std::string m_method;
-  std::string m_weightfile;
+/** the reader of one thread and its input buffer (the reader binds the variables by address) */
+struct ThreadReader {
+  ThreadReader(std::string weightfile) : reader("FastBDT", weightfile), input{} {}
+  TMVAReader reader; /**< the reader */
+  std::array<float, nTMVAInputs> input; /**< NOTE: reader can only handle floats (no doubles) */
 };
 
-TMVAReader::TMVAReader(std::string method, std::string weightfile)
-  : m_method(method), m_weightfile(weightfile)
-{
-  m_reader = new TMVA::Reader();
-  // m_reader->BookMVA(m_method, m_weightfile);
-}
-
-template<class T>
-void TMVAReader::addVariable(std::string name, T& var)
-{
-  m_reader->AddVariable(name, &var);
-}
-
-/**
- * get all values from the tree into an array (matrix like) structure
- */
-const std::vector<std::vector<double> > getValues(const RootTreeData& tree)
-{
-  std::vector<std::vector<double> > values;
-  for(size_t i = 0; i < 9; ++i) { // CAUTION: hardcoded here
-    std::stringstream name{}; name << "Z" << i;
-    values.push_back( tree.getBranchData<double>(name.str())->getData() );
-  }
-
-  return values;
-}
-
 ///////////////////////////////
 // END OF CLASS DECLARATIONS //
 ///////////////////////////////
 /**
  * evaluate the TMVA method and write the values to the outputfile
- * TODO:
+ * every thread evaluates a contiguous slice of each chunk with its own reader and writes to its part of the (preallocated) outputs
+ * if compareSerial is set, every chunk is also evaluated with a single reader (as before) to report the scaling and to check that
+ * the outputs agree
  */
-void evaluate_input(char* weightfile, char* inputfile, char* outputfile)
+void evaluate_input(char* weightfile, char* inputfile, char* outputfile, unsigned nThreads, bool compareSerial)
 {
+  TT_PROFILE_SCOPE("evaltmva");
+  MemoryStage memory;
+  ROOT::EnableThreadSafety(); // the readers are evaluated concurrently by the worker threads (call before creating them)
   loadPlugins("FastBDT");
 
-  RootFileData infile = RootFileData(std::string(inputfile));
-  infile.fetchData(); // get all data from tree
-  const RootTreeData& tree = infile.getTreeData("testtree");
-  TMVAReader reader("FastBDT", std::string(weightfile));
-  cout << "created reader" << endl;
-
-  std::array<float,9> input{}; // NOTE: reader can only handle floats (no doubles)
-  for(size_t i = 0; i < input.size(); ++i) { // add the variables
-    std::stringstream name{}; name << "Z" << i;
-    reader.addVariable(name.str(), input[i]);
+  RootFile infile(inputfile);
+  const std::vector<std::string> inputnames = getInputNames();
+  // only read the input branches chunk-wise (large enough chunks such that every thread gets chunkSize events)
+  RootChunkReader chunkreader(infile, "testtree", inputnames, chunkSize * nThreads);
+
+  // the readers are created one after another in this thread (the construction of a TMVA::Reader is not thread safe)
+  std::vector<std::unique_ptr<ThreadReader> > readers;
+  for(unsigned t = 0; t < nThreads + compareSerial; ++t) {
+    readers.push_back(std::unique_ptr<ThreadReader>(new ThreadReader(std::string(weightfile))));
+    for(size_t i = 0; i < nTMVAInputs; ++i) { // add the variables
+      readers.back()->reader.addVariable(inputnames[i], readers.back()->input[i]);
+    }
+    readers.back()->reader.bookMethod();
   }
-  reader.bookMethod();
+  cout << "created " << readers.size() << " reader(s)" << endl;
 
-  const std::vector<std::vector<double> > inputvalues = getValues(tree);
-  size_t nEntries = inputvalues[0].size();
   std::vector<double> outputs;
-
-  high_resolution_clock::time_point start = high_resolution_clock::now();
-  for(size_t i = 0; i < nEntries; ++i) {
-    for(size_t j = 0; j < input.size(); ++j) {
-
-      input[j] = inputvalues[j][i];
+  std::vector<double> serialOutputs;
+  std::vector<const std::vector<double>*> inputvalues(nTMVAInputs); // pointers to the buffers of the chunkreader
+
+  high_resolution_clock::duration evalTime{};
+  high_resolution_clock::duration serialTime{};
+  high_resolution_clock::duration readTime{};
+  for(;;) {
+    high_resolution_clock::time_point readStart = high_resolution_clock::now();
+    ScopedTimer readScope("read_chunk");
+    bool haveChunk = chunkreader.next();
+    readScope.stop();
+    readTime += high_resolution_clock::now() - readStart;
+    if(!haveChunk) break;
+
+    for(size_t j = 0; j < nTMVAInputs; ++j) inputvalues[j] = &chunkreader.getColumn<double>(j);
+    size_t nEntries = chunkreader.getNValues();
+    const size_t offset = outputs.size();
+    outputs.resize(offset + nEntries);
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    {
+      TT_PROFILE_SCOPE("evaluate_chunk");
+      parallel::parallelFor(nEntries, nThreads, [&](size_t first, size_t last, unsigned iThread) {
+          ThreadReader& threadReader = *readers[iThread];
+          for(size_t i = first; i < last; ++i) {
+            for(size_t j = 0; j < nTMVAInputs; ++j) {
+              threadReader.input[j] = inputvalues[j]->operator[](i);
+            }
+            outputs[offset + i] = threadReader.reader.evaluate();
+          }
+        });
     }
-    outputs.push_back(reader.evaluate());
+    evalTime += high_resolution_clock::now() - start;
+
+    if(compareSerial) {
+      start = high_resolution_clock::now();
+      TT_PROFILE_SCOPE("evaluate_chunk_serial");
+      ThreadReader& serialReader = *readers.back();
+      for(size_t i = 0; i < nEntries; ++i) {
+        for(size_t j = 0; j < nTMVAInputs; ++j) {
+          serialReader.input[j] = inputvalues[j]->operator[](i);
+        }
+        serialOutputs.push_back(serialReader.reader.evaluate());
+      }
+      serialTime += high_resolution_clock::now() - start;
+    }
+  }
+  const double evalMs = chrono::duration_cast<chrono::microseconds>(evalTime).count() / 1000.;
+  cout << "duration: " << evalMs << " ms (" << nThreads << " thread(s))" << endl;
+  if(compareSerial) {
+    const double serialMs = chrono::duration_cast<chrono::microseconds>(serialTime).count() / 1000.;
+    size_t nDiffer = 0;
+    for(size_t i = 0; i < outputs.size(); ++i) nDiffer += outputs[i] != serialOutputs[i];
+    cout << "serial duration: " << serialMs << " ms, speedup: " << (evalMs > 0 ? serialMs / evalMs : 0) << " (efficiency "
+         << (evalMs > 0 ? serialMs / evalMs / nThreads : 0) << "), " << nDiffer << " outputs differ" << endl;
   }
-  high_resolution_clock::time_point end = high_resolution_clock::now();
-  cout << "duration: " << chrono::duration_cast<chrono::microseconds>(end-start).count() / 1000. << " ms" << endl;
+  cout << "read duration: " << chrono::duration_cast<chrono::microseconds>(readTime).count() / 1000. << " ms (" << outputs.size() << " samples)" << endl;
+  cout << "memory: " << memory << endl;
 
   ofstream outfile(outputfile, ofstream::out);
   for(double d: outputs) outfile << d << endl;
@@ -142,16 +152,33 @@ void evaluate_input(char* weightfile, char* inputfile, char* outputfile)
 #ifndef __CINT__
 /**
  * main routine:
- * TODO
+ * usage: evaltmva [-j nThreads] [-s] weightfile inputfile outputfile
+ * -j: number of threads evaluating the method (every thread has its own reader, default: number of hardware threads)
+ * -s: also evaluate with a single reader and report the speedup of the threaded evaluation
  */
 int main(int argc, char* argv[])
 {
+  unsigned nThreads = 0;
+  bool compareSerial = false;
+  int opt;
+  while((opt = getopt(argc, argv, "j:s")) != -1) {
+    switch(opt) {
+    case 'j': nThreads = atoi(optarg); break;
+    case 's': compareSerial = true; break;
+    default:
+      cout << "usage: " << argv[0] << " [-j nThreads] [-s] weightfile inputfile outputfile" << endl;
+      return -1;
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
   if(argc != 4) {
     cout << "please provide: a weightfile, an inputfile and an outputfile (name)" << endl;
     return -1;
   }
   cout << argv[1] << " " << argv[2] << " " << argv[3] << endl;
-  evaluate_input(argv[1],argv[2],argv[3]);
+  evaluate_input(argv[1], argv[2], argv[3], parallel::getNThreads(nThreads), compareSerial);
 
   return 0;
 }
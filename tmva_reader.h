@@ -0,0 +1,81 @@
+// helpers for the evaluation of TMVA methods (used by evaltmva and compareclassifiers)
+//
+// by Thomas Madlener, 2015
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+// ROOT
+#include "TMVA/Reader.h"
+#include "TPluginManager.h"
+
+/**
+ * load the FastBDT plugin (copied from framework)
+ */
+inline void loadPlugins(const std::string& name)
+{
+  std::string base = "TMVA@@MethodBase";
+  std::string regexp1 = std::string(".*_") + name + std::string(".*");
+  std::string regexp2 = std::string(".*") + name + std::string(".*");
+  std::string className = std::string("TMVA::Method") + name;
+  std::string pluginName = std::string("TMVA") + name;
+  std::string ctor1 = std::string("Method") + name + std::string("(DataSetInfo&,TString)");
+  std::string ctor2 = std::string("Method") + name + std::string("(TString&, TString&,DataSetInfo&,TString&)");
+
+  gPluginMgr->AddHandler(base.c_str(), regexp1.c_str(), className.c_str(), pluginName.c_str(), ctor1.c_str());
+  gPluginMgr->AddHandler(base.c_str(), regexp2.c_str(), className.c_str(), pluginName.c_str(), ctor2.c_str());
+}
+
+/**
+ * small helper class to keep the TMVAReader and pointers to it contained
+ * currently allows only one booked method (but should be no problem for us)
+ * NOTE: the TMVA::Reader binds the variables by address, i.e. a TMVAReader can only be used by one thread at a time
+ */
+class TMVAReader {
+public:
+  TMVAReader(std::string method, std::string weightfile); /**< ctor from method name and weightfile*/
+  ~TMVAReader() { delete m_reader; } /**< destructor */
+  template<class T> void addVariable(std::string name, T& var); /**< add variable */
+  std::string getBookMethod() { return m_method; } /**< get the method */
+  void bookMethod() { m_reader->BookMVA(m_method, m_weightfile); }
+  double evaluate() { return m_reader->EvaluateMVA(m_method); }
+private:
+  TMVAReader(const TMVAReader&); /**< not copyable (owns the reader) */
+  TMVAReader& operator=(const TMVAReader&); /**< not copyable (owns the reader) */
+  TMVA::Reader* m_reader;
+  std::string m_method;
+  std::string m_weightfile;
+};
+
+inline TMVAReader::TMVAReader(std::string method, std::string weightfile)
+  : m_method(method), m_weightfile(weightfile)
+{
+  m_reader = new TMVA::Reader();
+  // m_reader->BookMVA(m_method, m_weightfile);
+}
+
+template<class T>
+void TMVAReader::addVariable(std::string name, T& var)
+{
+  m_reader->AddVariable(name, &var);
+}
+
+/** number of inputs of the TMVA methods */
+const size_t nTMVAInputs = 9;
+
+/**
+ * get the names of the branches that are used as inputs
+ */
+inline const std::vector<std::string> getInputNames()
+{
+  std::vector<std::string> names;
+  for(size_t i = 0; i < nTMVAInputs; ++i) { // CAUTION: hardcoded here
+    std::stringstream name{}; name << "Z" << i;
+    names.push_back(name.str());
+  }
+
+  return names;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <ostream>
+#include <iomanip>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+// getrusage
+#include <sys/resource.h>
+
+namespace timing {
+
+  /**
+   * global allocation counters, filled by the replaced global operator new / delete (see TT_MEMORY_HOOKS below).
+   * All members are only updated if the hooks are compiled into the program
+   */
+  struct AllocationCounters {
+    std::atomic<uint64_t> nAllocations; /**< number of calls to operator new (all variants) */
+    std::atomic<uint64_t> nDeallocations; /**< number of calls to operator delete (all variants, not counting nullptr) */
+    std::atomic<uint64_t> allocatedBytes; /**< total number of bytes requested */
+    std::atomic<int64_t> currentBytes; /**< number of bytes currently allocated */
+    std::atomic<int64_t> peakBytes; /**< maximum of currentBytes (since the last reset by a MemoryStage) */
+    bool hooked; /**< the hooks are compiled in */
+  };
+
+  /** get the allocation counters (zero-initialized, since it is a static) */
+  inline AllocationCounters& allocationCounters() { static AllocationCounters counters; return counters; }
+
+  /** read a value (in kB) from /proc/self/status (e.g. VmRSS, VmHWM). @returns -1 if it cannot be read */
+  inline long readProcStatus(const char* key)
+  {
+    FILE* file = fopen("/proc/self/status", "r");
+    if(file == 0) return -1;
+    char line[256];
+    long value = -1;
+    const size_t keyLength = strlen(key);
+    while(fgets(line, sizeof(line), file)) {
+      if(strncmp(line, key, keyLength) == 0 && line[keyLength] == ':') {
+        value = atol(line + keyLength + 1);
+        break;
+      }
+    }
+    fclose(file);
+    return value;
+  }
+
+  /** get the current resident set size in kB (-1 if not available) */
+  inline long getCurrentRSS() { return readProcStatus("VmRSS"); }
+
+  /** get the peak resident set size of the process in kB (VmHWM, or the maximum RSS from getrusage if /proc is not available) */
+  inline long getPeakRSS()
+  {
+    long peak = readProcStatus("VmHWM");
+    if(peak >= 0) return peak;
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) return usage.ru_maxrss;
+    return -1;
+  }
+
+  /**
+   * memory usage of a stage of a program: number of allocations and allocated bytes, net change and peak of the heap (all only if
+   * the allocation hooks are compiled in), as well as the resident set size at the end and the peak resident set size of the process.
+   * Stages can be nested (the peak of an outer stage includes the ones of the inner stages).
+   * usage (next to a TicTocTimer):
+   *   MemoryStage memory;
+   *   ... // do the work
+   *   std::cout << "DONE. " << timer << " " << memory << std::endl;
+   */
+  class MemoryStage {
+  public:
+    MemoryStage() : m_stopped(false) { start(); }
+
+    void start(); /**< (re)start the stage */
+
+    void stop(); /**< end the stage (called automatically by print, if it has not been called before) */
+
+    std::string print(); /**< get a one line summary */
+
+    uint64_t getNAllocations() const { return m_nAllocations; } /**< allocations in this stage */
+    uint64_t getAllocatedBytes() const { return m_allocatedBytes; } /**< bytes allocated in this stage */
+    int64_t getNetBytes() const { return m_netBytes; } /**< change of the allocated bytes in this stage */
+    int64_t getPeakBytes() const { return m_peakBytes; } /**< peak of the heap during this stage */
+
+  private:
+    uint64_t m_startAllocations; /**< nAllocations at the start */
+    uint64_t m_startAllocatedBytes; /**< allocatedBytes at the start */
+    int64_t m_startBytes; /**< currentBytes at the start */
+    int64_t m_outerPeak; /**< peakBytes at the start (restored at the end, such that stages can be nested) */
+    bool m_stopped; /**< stop has been called */
+
+    uint64_t m_nAllocations; /**< allocations in this stage */
+    uint64_t m_allocatedBytes; /**< bytes allocated in this stage */
+    int64_t m_netBytes; /**< change of the allocated bytes in this stage */
+    int64_t m_peakBytes; /**< peak of the heap during this stage */
+    long m_rss; /**< resident set size at the end (kB) */
+    long m_peakRSS; /**< peak resident set size of the process at the end (kB) */
+  };
+
+  inline void MemoryStage::start()
+  {
+    AllocationCounters& counters = allocationCounters();
+    m_stopped = false;
+    m_startAllocations = counters.nAllocations;
+    m_startAllocatedBytes = counters.allocatedBytes;
+    m_startBytes = counters.currentBytes;
+    m_outerPeak = counters.peakBytes.exchange(m_startBytes); // peak of this stage starts at the current value
+  }
+
+  inline void MemoryStage::stop()
+  {
+    if(m_stopped) return;
+    m_stopped = true;
+    AllocationCounters& counters = allocationCounters();
+    m_nAllocations = counters.nAllocations - m_startAllocations;
+    m_allocatedBytes = counters.allocatedBytes - m_startAllocatedBytes;
+    m_netBytes = counters.currentBytes - m_startBytes;
+    m_peakBytes = counters.peakBytes;
+    int64_t peak = counters.peakBytes;
+    while(peak < m_outerPeak && !counters.peakBytes.compare_exchange_weak(peak, m_outerPeak)) {}
+    m_rss = getCurrentRSS();
+    m_peakRSS = getPeakRSS();
+  }
+
+  inline std::string MemoryStage::print()
+  {
+    stop();
+    std::stringstream ss{};
+    ss << std::fixed << std::setprecision(1);
+    if(allocationCounters().hooked) {
+      ss << "allocations: " << m_nAllocations << " (" << m_allocatedBytes / 1048576. << " MB), heap: "
+         << (m_netBytes >= 0 ? "+" : "") << m_netBytes / 1048576. << " MB (peak " << m_peakBytes / 1048576. << " MB), ";
+    }
+    ss << "RSS: " << m_rss / 1024. << " MB (peak " << m_peakRSS / 1024. << " MB)";
+    return ss.str();
+  }
+
+  inline std::ostream& operator<<(std::ostream& os, MemoryStage& stage)
+  {
+    os << stage.print();
+    return os;
+  }
+
+  /** allocate @param size bytes and count them (used by the replaced operator new) */
+  inline void* countedAllocate(size_t size)
+  {
+    // the size is stored in front of the returned memory (keeping the alignment of malloc)
+    const size_t offset = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+    void* memory = malloc(size + offset);
+    if(memory == 0) return 0;
+    memcpy(memory, &size, sizeof(size_t));
+
+    AllocationCounters& counters = allocationCounters();
+    counters.nAllocations.fetch_add(1, std::memory_order_relaxed);
+    counters.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    int64_t current = counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    int64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while(current > peak && !counters.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {}
+    return static_cast<char*>(memory) + offset;
+  }
+
+  /** free memory allocated by countedAllocate */
+  inline void countedFree(void* pointer)
+  {
+    if(pointer == 0) return;
+    const size_t offset = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+    void* memory = static_cast<char*>(pointer) - offset;
+    size_t size;
+    memcpy(&size, memory, sizeof(size_t));
+
+    AllocationCounters& counters = allocationCounters();
+    counters.nDeallocations.fetch_add(1, std::memory_order_relaxed);
+    counters.currentBytes.fetch_sub(size, std::memory_order_relaxed);
+    free(memory);
+  }
+
+  /** operator new semantics: call the new_handler until the allocation succeeds or throw std::bad_alloc */
+  inline void* countedNew(size_t size)
+  {
+    if(size == 0) size = 1;
+    for(;;) {
+      void* pointer = countedAllocate(size);
+      if(pointer) return pointer;
+      std::new_handler handler = std::set_new_handler(0);
+      std::set_new_handler(handler);
+      if(handler == 0) throw std::bad_alloc();
+      handler();
+    }
+  }
+}
+
+/**
+ * replacement of the global operator new / delete, counting all allocations in timing::allocationCounters().
+ * To use it, define TT_MEMORY_HOOKS in exactly one translation unit of the program (e.g. -DTT_MEMORY_HOOKS for single file tools)
+ * before including this file. Without it, MemoryStage only reports the resident set size.
+ */
+#ifdef TT_MEMORY_HOOKS
+namespace timing {
+  /** marks the counters as valid before main is entered */
+  struct AllocationHooksMarker { AllocationHooksMarker() { allocationCounters().hooked = true; } };
+  static AllocationHooksMarker allocationHooksMarker;
+}
+
+void* operator new(size_t size) { return timing::countedNew(size); }
+void* operator new[](size_t size) { return timing::countedNew(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { try { return timing::countedNew(size); } catch(...) { return 0; } }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { try { return timing::countedNew(size); } catch(...) { return 0; } }
+void operator delete(void* pointer) noexcept { timing::countedFree(pointer); }
+void operator delete[](void* pointer) noexcept { timing::countedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { timing::countedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { timing::countedFree(pointer); }
+#if __cpp_sized_deallocation
+void operator delete(void* pointer, size_t) noexcept { timing::countedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { timing::countedFree(pointer); }
+#endif
+#endif
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+
+// linux
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "tt_timer.h"
+
+namespace timing {
+
+  /** the hardware events that are counted by a PerfCounterGroup */
+  enum e_perfEvents {
+    c_cycles = 0,
+    c_instructions,
+    c_l1dMisses,
+    c_llcMisses,
+    c_branchMisses,
+    c_nPerfEvents,
+  };
+
+  /** names of the hardware events (same order as e_perfEvents) */
+  const char* const c_perfEventNames[c_nPerfEvents] = { "cycles", "instructions", "L1d misses", "LLC misses", "branch misses" };
+
+  /**
+   * group of hardware performance counters (cycles, instructions, L1 data cache read misses, last level cache misses and branch
+   * misses) of the calling thread, read via perf_event_open.
+   * Counters that are not supported (e.g. in virtual machines) are left out. If no counter can be opened at all (e.g. because
+   * /proc/sys/kernel/perf_event_paranoid does not allow it), available() returns false and all values are 0.
+   * If the kernel has to multiplex the counters, the values are scaled by the fraction of time they were actually counting.
+   * NOTE: only the calling thread is counted (not the threads started by it, see PerfThreadScope)
+   */
+  class PerfCounterGroup {
+  public:
+    PerfCounterGroup();
+    ~PerfCounterGroup();
+
+    bool available() const { return m_fds[c_cycles] >= 0; } /**< check if the counters could be opened */
+
+    bool available(e_perfEvents event) const { return m_fds[event] >= 0; } /**< check if a single counter could be opened */
+
+    void start(); /**< reset and start counting */
+
+    void stop(); /**< stop counting and read the values */
+
+    double getValue(e_perfEvents event) const { return m_values[event]; } /**< get the (scaled) value of a counter after stop */
+
+  private:
+    int m_fds[c_nPerfEvents]; /**< file descriptors of the counters (-1 if not available). cycles is the group leader */
+    uint64_t m_ids[c_nPerfEvents]; /**< ids of the counters (to identify them in the group read) */
+    double m_values[c_nPerfEvents]; /**< values of the last measurement */
+
+    int open(uint32_t type, uint64_t config, int groupFd); /**< open one counter */
+
+    PerfCounterGroup(const PerfCounterGroup&); /**< not copyable */
+    PerfCounterGroup& operator=(const PerfCounterGroup&); /**< not copyable */
+  };
+
+  inline int PerfCounterGroup::open(uint32_t type, uint64_t config, int groupFd)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = groupFd < 0 ? 1 : 0; // only the leader is enabled / disabled, the others follow it
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0); // this thread, any cpu
+  }
+
+  inline PerfCounterGroup::PerfCounterGroup()
+  {
+    for(int i = 0; i < c_nPerfEvents; ++i) { m_fds[i] = -1; m_ids[i] = 0; m_values[i] = 0; }
+
+    m_fds[c_cycles] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    if(m_fds[c_cycles] < 0) return;
+    m_fds[c_instructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, m_fds[c_cycles]);
+    m_fds[c_l1dMisses] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), m_fds[c_cycles]);
+    m_fds[c_llcMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, m_fds[c_cycles]);
+    m_fds[c_branchMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, m_fds[c_cycles]);
+
+    for(int i = 0; i < c_nPerfEvents; ++i) {
+      if(m_fds[i] >= 0 && ioctl(m_fds[i], PERF_EVENT_IOC_ID, &m_ids[i]) != 0) { close(m_fds[i]); m_fds[i] = -1; }
+    }
+  }
+
+  inline PerfCounterGroup::~PerfCounterGroup()
+  {
+    for(int i = c_nPerfEvents - 1; i >= 0; --i) { if(m_fds[i] >= 0) close(m_fds[i]); } // leader last
+  }
+
+  inline void PerfCounterGroup::start()
+  {
+    if(!available()) return;
+    ioctl(m_fds[c_cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_fds[c_cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  inline void PerfCounterGroup::stop()
+  {
+    if(!available()) return;
+    ioctl(m_fds[c_cycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // layout of the group read: nr, time_enabled, time_running, {value, id} * nr
+    uint64_t buffer[3 + 2 * c_nPerfEvents];
+    ssize_t nRead = read(m_fds[c_cycles], buffer, sizeof(buffer));
+    if(nRead < ssize_t(3 * sizeof(uint64_t))) return;
+    const uint64_t nr = std::min<uint64_t>(buffer[0], c_nPerfEvents);
+    const double scale = buffer[2] > 0 ? double(buffer[1]) / buffer[2] : 0; // correction for multiplexing
+    for(uint64_t j = 0; j < nr; ++j) {
+      for(int i = 0; i < c_nPerfEvents; ++i) {
+        if(m_fds[i] >= 0 && m_ids[i] == buffer[4 + 2 * j]) m_values[i] = buffer[3 + 2 * j] * scale;
+      }
+    }
+  }
+
+  /**
+   * timed region that measures the wall time (via TicTocTimer) and, if enabled, the hardware counters of a PerfCounterGroup, and
+   * prints both (together with figures per item, e.g. cycles per evaluated sample) when it is stopped.
+   * Nothing is measured or printed unless the environment variable TT_PERF is set. If the counters are not permitted, only the wall
+   * time (per item) is reported.
+   * The counters only count the thread that created the region. Worker threads started within the region have to be counted with a
+   * PerfThreadScope each, their counts are added to the report.
+   * usage:
+   *   PerfRegion region("evaluate", nSamples, "sample");
+   *   ... // evaluate all samples
+   *   region.stop(); // (or at the end of the scope)
+   */
+  class PerfRegion {
+  public:
+    PerfRegion(std::string name, uint64_t nItems = 0, std::string itemName = "item", std::ostream& os = std::cout);
+
+    ~PerfRegion() { stop(); }
+
+    void setNItems(uint64_t nItems) { m_nItems = nItems; } /**< set the number of processed items (if not known at construction) */
+
+    void stop(); /**< stop the measurement and print the report */
+
+    bool countsEvents() const { return m_counters != 0; } /**< check if the hardware counters are measured */
+
+    std::thread::id getThreadId() const { return m_threadId; } /**< get the thread that created the region (and is counted by it) */
+
+    /** add the counts of a worker thread (thread safe, see PerfThreadScope) */
+    void addCounts(const PerfCounterGroup& counters);
+
+    static bool enabled() { const char* env = getenv("TT_PERF"); return env != 0 && env[0] != 0 && env[0] != '0'; } /**< TT_PERF set? */
+
+  private:
+    std::string m_name; /**< name of the region */
+    uint64_t m_nItems; /**< number of processed items */
+    std::string m_itemName; /**< name of one item */
+    std::ostream& m_os; /**< where the report is printed */
+    TicTocTimer m_timer; /**< wall time (ns) */
+    PerfCounterGroup* m_counters; /**< the counters (0 if not enabled) */
+    bool m_running; /**< region has not been stopped yet */
+    bool m_report; /**< print a report (TT_PERF is set) */
+    std::thread::id m_threadId; /**< thread that created the region */
+    double m_workerValues[c_nPerfEvents]; /**< summed counts of the worker threads */
+    unsigned m_nWorkers; /**< number of PerfThreadScopes that added their counts */
+    std::mutex m_mutex; /**< guards m_workerValues and m_nWorkers */
+  };
+
+  /**
+   * counts the hardware events of a worker thread of a PerfRegion from construction to destruction (with its own PerfCounterGroup) and
+   * adds them to the region. Does nothing if the region does not measure the counters or in the thread that created the region (which
+   * is counted by the region itself, e.g. if parallelFor runs everything on the calling thread).
+   * usage:
+   *   PerfRegion region("evaluate", nSamples, "sample");
+   *   parallel::parallelFor(nSamples, nThreads, [&](size_t first, size_t last, unsigned) {
+   *       PerfThreadScope perf(region);
+   *       ... // evaluate the samples [first, last)
+   *     });
+   */
+  class PerfThreadScope {
+  public:
+    PerfThreadScope(PerfRegion& region) : m_region(region), m_counters(0)
+    {
+      if(!region.countsEvents() || std::this_thread::get_id() == region.getThreadId()) return;
+      m_counters = new PerfCounterGroup();
+      m_counters->start();
+    }
+
+    ~PerfThreadScope()
+    {
+      if(m_counters == 0) return;
+      m_counters->stop();
+      m_region.addCounts(*m_counters);
+      delete m_counters;
+    }
+
+  private:
+    PerfRegion& m_region; /**< the region the counts are added to */
+    PerfCounterGroup* m_counters; /**< the counters of this thread (0 if not counted) */
+    PerfThreadScope(const PerfThreadScope&); /**< not copyable */
+    PerfThreadScope& operator=(const PerfThreadScope&); /**< not copyable */
+  };
+
+  inline PerfRegion::PerfRegion(std::string name, uint64_t nItems, std::string itemName, std::ostream& os) :
+    m_name(name), m_nItems(nItems), m_itemName(itemName), m_os(os), m_timer(1), m_counters(0), m_running(true), m_report(enabled()),
+    m_threadId(std::this_thread::get_id()), m_nWorkers(0)
+  {
+    for(int i = 0; i < c_nPerfEvents; ++i) m_workerValues[i] = 0;
+    if(m_report) {
+      m_counters = new PerfCounterGroup();
+      if(!m_counters->available()) {
+        m_os << "WARNING: hardware performance counters are not available (see /proc/sys/kernel/perf_event_paranoid), "
+             << "reporting only wall time for " << m_name << std::endl;
+        delete m_counters;
+        m_counters = 0;
+      }
+    }
+    m_timer.tic();
+    if(m_counters) m_counters->start();
+  }
+
+  inline void PerfRegion::addCounts(const PerfCounterGroup& counters)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(int i = 0; i < c_nPerfEvents; ++i) m_workerValues[i] += counters.getValue(static_cast<e_perfEvents>(i));
+    m_nWorkers++;
+  }
+
+  inline void PerfRegion::stop()
+  {
+    if(!m_running) return;
+    m_running = false;
+    if(!m_report) return;
+    if(m_counters) m_counters->stop();
+    m_timer.toc();
+
+    const double wallTime = m_timer.time();
+    std::ios::fmtflags flags = m_os.flags();
+    m_os << std::fixed << std::setprecision(2) << m_name << ": wall time " << wallTime / 1e6 << " ms";
+    if(m_nItems) m_os << " (" << wallTime / m_nItems << " ns / " << m_itemName << ")";
+    m_os << std::endl;
+
+    if(m_counters) {
+      double values[c_nPerfEvents]; // calling thread + worker threads
+      for(int i = 0; i < c_nPerfEvents; ++i) values[i] = m_counters->getValue(static_cast<e_perfEvents>(i)) + m_workerValues[i];
+      if(m_nWorkers) m_os << "  (summed over all threads)" << std::endl;
+      for(int i = 0; i < c_nPerfEvents; ++i) {
+        e_perfEvents event = static_cast<e_perfEvents>(i);
+        if(!m_counters->available(event)) continue;
+        m_os << "  " << std::left << std::setw(14) << c_perfEventNames[i] << std::right << std::setw(18) << std::setprecision(0)
+             << values[i];
+        if(m_nItems) m_os << std::setw(14) << std::setprecision(2) << values[i] / m_nItems << " / " << m_itemName;
+        m_os << std::endl;
+      }
+      if(m_counters->available(c_instructions) && values[c_cycles] > 0) {
+        m_os << "  IPC " << std::setprecision(2) << values[c_instructions] / values[c_cycles] << std::endl;
+      }
+      delete m_counters;
+      m_counters = 0;
+    }
+    m_os.flags(flags);
+  }
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <limits>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#include "tt_timer.h"
+
+namespace timing {
+
+  /**
+   * statistics of one profiled region (all times in ns).
+   * The single durations are kept for the percentiles. If there are more than c_maxSamples of them, a uniform random subset
+   * (reservoir sampling) of this size is kept.
+   */
+  class RegionStats {
+  public:
+    RegionStats() : m_count(0), m_total(0), m_min(std::numeric_limits<double>::max()), m_max(0), m_random(88172645463325252ULL) {}
+
+    void add(double duration); /**< add one measurement */
+
+    uint64_t getCount() const { return m_count; } /**< number of measurements */
+    double getTotal() const { return m_total; } /**< sum of all measurements */
+    double getMin() const { return m_count ? m_min : 0; } /**< shortest measurement */
+    double getMax() const { return m_max; } /**< longest measurement */
+    double getMean() const { return m_count ? m_total / m_count : 0; } /**< mean of all measurements */
+
+    /** get the percentile @param p (0 - 100) of the measurements */
+    double getPercentile(double p) const;
+
+    static const size_t c_maxSamples = 1 << 16; /**< maximum number of single durations that are kept */
+
+  private:
+    uint64_t m_count; /**< number of measurements */
+    double m_total; /**< sum of all measurements */
+    double m_min; /**< shortest measurement */
+    double m_max; /**< longest measurement */
+    std::vector<double> m_samples; /**< (subset of the) single measurements */
+    uint64_t m_random; /**< state of the random number generator for the reservoir sampling (xorshift) */
+  };
+
+  inline void RegionStats::add(double duration)
+  {
+    m_count++;
+    m_total += duration;
+    m_min = std::min(m_min, duration);
+    m_max = std::max(m_max, duration);
+    if(m_samples.size() < c_maxSamples) {
+      m_samples.push_back(duration);
+      return;
+    }
+    m_random ^= m_random << 13; m_random ^= m_random >> 7; m_random ^= m_random << 17;
+    uint64_t pos = m_random % m_count;
+    if(pos < c_maxSamples) m_samples[pos] = duration;
+  }
+
+  inline double RegionStats::getPercentile(double p) const
+  {
+    if(m_samples.empty()) return 0;
+    std::vector<double> sorted(m_samples);
+    size_t pos = std::min(sorted.size() - 1, size_t(p / 100. * (sorted.size() - 1) + 0.5));
+    std::nth_element(sorted.begin(), sorted.begin() + pos, sorted.end());
+    return sorted[pos];
+  }
+
+  /**
+   * registry collecting the statistics of all profiled regions (of all threads).
+   * Profiling is only enabled if the environment variable TT_PROFILE is set. At program exit a report is written to the file it
+   * points to: CSV if it ends with .csv, JSON else. If it is set to "-" a table is printed to stderr.
+   */
+  class Profiler {
+  public:
+    static Profiler& instance() { static Profiler profiler; return profiler; } /**< get the (only) instance */
+
+    bool enabled() const { return m_enabled; } /**< check if profiling is enabled */
+
+    /** add a measurement for region @param path */
+    void record(const std::string& path, double duration)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_regions[path].add(duration);
+    }
+
+    void writeJSON(std::ostream& os) const; /**< write the report as JSON */
+
+    void writeCSV(std::ostream& os) const; /**< write the report as CSV */
+
+    void print(std::ostream& os) const; /**< print the report as table */
+
+    ~Profiler(); /**< dtor, writes the report */
+
+  private:
+    Profiler();
+
+    bool m_enabled; /**< is profiling enabled */
+    std::string m_output; /**< where to write the report */
+    std::map<std::string, RegionStats> m_regions; /**< the profiled regions by path */
+    mutable std::mutex m_mutex; /**< guards m_regions */
+  };
+
+  inline Profiler::Profiler() : m_enabled(false)
+  {
+    const char* output = getenv("TT_PROFILE");
+    if(output != 0 && output[0] != 0) {
+      m_enabled = true;
+      m_output = output;
+    }
+  }
+
+  inline Profiler::~Profiler()
+  {
+    if(!m_enabled || m_regions.empty()) return;
+    if(m_output == "-") {
+      print(std::cerr);
+      return;
+    }
+    std::ofstream outfile(m_output.c_str());
+    if(!outfile) {
+      std::cerr << "WARNING: could not write profiling report to " << m_output << std::endl;
+      return;
+    }
+    if(m_output.size() > 4 && m_output.compare(m_output.size() - 4, 4, ".csv") == 0) writeCSV(outfile);
+    else writeJSON(outfile);
+  }
+
+  inline void Profiler::writeJSON(std::ostream& os) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    os << "{\n  \"unit\": \"ns\",\n  \"regions\": [";
+    bool first = true;
+    for(const auto& region : m_regions) {
+      const RegionStats& stats = region.second;
+      os << (first ? "\n" : ",\n") << "    {\"name\": \"" << region.first << "\", \"count\": " << stats.getCount()
+         << std::fixed << std::setprecision(0)
+         << ", \"total\": " << stats.getTotal() << ", \"mean\": " << stats.getMean() << ", \"min\": " << stats.getMin()
+         << ", \"max\": " << stats.getMax() << ", \"p50\": " << stats.getPercentile(50) << ", \"p90\": " << stats.getPercentile(90)
+         << ", \"p99\": " << stats.getPercentile(99) << "}" << std::defaultfloat;
+      first = false;
+    }
+    os << "\n  ]\n}\n";
+  }
+
+  inline void Profiler::writeCSV(std::ostream& os) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    os << "name,count,total_ns,mean_ns,min_ns,max_ns,p50_ns,p90_ns,p99_ns\n" << std::fixed << std::setprecision(0);
+    for(const auto& region : m_regions) {
+      const RegionStats& stats = region.second;
+      os << region.first << "," << stats.getCount() << "," << stats.getTotal() << "," << stats.getMean() << "," << stats.getMin()
+         << "," << stats.getMax() << "," << stats.getPercentile(50) << "," << stats.getPercentile(90) << "," << stats.getPercentile(99) << "\n";
+    }
+    os << std::defaultfloat;
+  }
+
+  inline void Profiler::print(std::ostream& os) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    os << std::left << std::setw(48) << "region" << std::right << std::setw(10) << "count" << std::setw(14) << "total [ms]"
+       << std::setw(12) << "mean [us]" << std::setw(12) << "min [us]" << std::setw(12) << "p50 [us]" << std::setw(12) << "p99 [us]"
+       << std::setw(12) << "max [us]" << std::endl << std::fixed << std::setprecision(2);
+    for(const auto& region : m_regions) {
+      const RegionStats& stats = region.second;
+      os << std::left << std::setw(48) << region.first << std::right << std::setw(10) << stats.getCount()
+         << std::setw(14) << stats.getTotal() / 1e6 << std::setw(12) << stats.getMean() / 1e3 << std::setw(12) << stats.getMin() / 1e3
+         << std::setw(12) << stats.getPercentile(50) / 1e3 << std::setw(12) << stats.getPercentile(99) / 1e3
+         << std::setw(12) << stats.getMax() / 1e3 << std::endl;
+    }
+    os << std::defaultfloat;
+  }
+
+  /** path of the currently active regions of this thread (e.g. "train/binning") */
+  inline std::string& currentProfilePath() { static thread_local std::string path; return path; }
+
+  /**
+   * RAII timer for a profiled region. The region is named by its path, i.e. the names of all regions that are active in the same
+   * thread when it is started, joined by '/'. Repeated measurements of the same region are accumulated by the Profiler.
+   * The region ends on destruction or with an explicit call to stop() (regions have to be stopped in reverse order of starting).
+   * Does nothing if profiling is not enabled (see Profiler).
+   * usage:
+   *   { ScopedTimer scope("read"); ... }
+   *   TT_PROFILE_SCOPE("evaluate");
+   */
+  class ScopedTimer {
+  public:
+    ScopedTimer(const char* name) : m_timer(1), m_active(Profiler::instance().enabled()), m_parentLength(0)
+    {
+      if(!m_active) return;
+      std::string& path = currentProfilePath();
+      m_parentLength = path.size();
+      if(!path.empty()) path += '/';
+      path += name;
+      m_timer.tic();
+    }
+
+    ~ScopedTimer() { stop(); }
+
+    /** end the region (before the end of the scope) */
+    void stop()
+    {
+      if(!m_active) return;
+      m_timer.toc();
+      m_active = false;
+      std::string& path = currentProfilePath();
+      Profiler::instance().record(path, m_timer.time());
+      path.resize(m_parentLength);
+    }
+
+  private:
+    TicTocTimer m_timer; /**< timer measuring in ns */
+    bool m_active; /**< region is running */
+    size_t m_parentLength; /**< length of the path of the enclosing region */
+
+    ScopedTimer(const ScopedTimer&); /**< not copyable */
+    ScopedTimer& operator=(const ScopedTimer&); /**< not copyable */
+  };
+}
+
+#define TT_PROFILE_CONCAT_IMPL(a, b) a##b
+#define TT_PROFILE_CONCAT(a, b) TT_PROFILE_CONCAT_IMPL(a, b)
+/** profile the rest of the enclosing scope as region name */
+#define TT_PROFILE_SCOPE(name) timing::ScopedTimer TT_PROFILE_CONCAT(tt_profile_scope_, __LINE__)(name)
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <chrono>
 #include <string>
 #include <sstream>
@@ -48,7 +50,7 @@ namespace timing {
     std::chrono::high_resolution_clock::time_point m_end; /**< end time point of the current time measurement */
   };
 
-  TicTocTimer::TicTocTimer(unsigned convFactor, std::string name) :
+  inline TicTocTimer::TicTocTimer(unsigned convFactor, std::string name) :
     m_convFactor(convFactor),
     m_name(name),
     m_tocked(false),
@@ -70,32 +72,32 @@ namespace timing {
     tic();
   }
 
-  void TicTocTimer::tic()
+  inline void TicTocTimer::tic()
   {
     m_tocked = false;
     m_start = std::chrono::high_resolution_clock::now();
   }
 
-  void TicTocTimer::toc()
+  inline void TicTocTimer::toc()
   {
     m_tocked = true;
     m_end = std::chrono::high_resolution_clock::now();
   }
 
-  double TicTocTimer::time()
+  inline double TicTocTimer::time()
   {
     if(!m_tocked) toc();
     return std::chrono::duration_cast<std::chrono::nanoseconds>(m_end - m_start).count() / m_convFactor;
   }
 
-  std::string TicTocTimer::print()
+  inline std::string TicTocTimer::print()
   {
     std::stringstream ss{};
     ss << m_name << " elapsed time: " << time() << " " << getUnit();
     return ss.str();
   }
   
-  std::ostream& operator<<(std::ostream& os, TicTocTimer& timer) {
+  inline std::ostream& operator<<(std::ostream& os, TicTocTimer& timer) {
     os << timer.print();
     return os;
   }
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+#include "datreader.h"
+#include "RootToolBox/vxdhelper.hpp"
+
+namespace datfile {
+
+  /**
+   * build the VXDFilterIndex of a .dat file from its topology column (written by root2dat -t, before the signal column).
+   * @param column, the column holding the topology code (negative: counted from the end, i.e. -2 is the one before the last)
+   * @returns false if the file cannot be read or does not have the column
+   */
+  inline bool buildVXDFilterIndex(std::string filename, int column, RootToolBox::VXDFilterIndex& index, unsigned nThreads = 0)
+  {
+    DatReader reader(filename);
+    if(!reader.good()) return false;
+    const int nColumns = reader.getNColumns();
+    if(column < 0) column += nColumns;
+    if(column < 0 || column >= nColumns) {
+      std::cerr << "ERROR: " << filename << " has no column " << column << " (only " << nColumns << " columns)" << std::endl;
+      return false;
+    }
+
+    index = RootToolBox::VXDFilterIndex();
+    const uint64_t chunkRows = 1 << 20;
+    std::vector<double> values;
+    for(uint64_t rowBegin = 0; rowBegin < reader.getNRows(); rowBegin += chunkRows) {
+      reader.readRowsParallel(rowBegin, rowBegin + chunkRows, values, nThreads);
+      for(size_t i = column; i < values.size(); i += nColumns) {
+        index.add(values[i] >= 0 ? unsigned(values[i]) : 0); // NaN (bad rows) end up in no category except 7
+      }
+    }
+    return true;
+  }
+
+  /**
+   * write the VXDFilterIndex of a .dat file to its sidecar file (<filename>.vxd). The size and modification time of the .dat file are
+   * stored with it (as for the DatIndex), so the .dat file has to be written completely (and closed) before.
+   * @returns false if the .dat file does not exist or the sidecar file cannot be written
+   */
+  inline bool writeVXDFilterIndex(std::string filename, RootToolBox::VXDFilterIndex& index)
+  {
+    int64_t datSize, datMTime;
+    if(!DatIndex::statFile(filename, datSize, datMTime)) return false;
+    index.setSource(datSize, datMTime);
+    return index.write(RootToolBox::VXDFilterIndex::getSidecarName(filename));
+  }
+
+  /** remove the sidecar file of the VXDFilterIndex of a .dat file (e.g. when the .dat file is rewritten without topology codes) */
+  inline void removeVXDFilterIndex(std::string filename)
+  {
+    remove(RootToolBox::VXDFilterIndex::getSidecarName(filename).c_str());
+  }
+
+  /**
+   * load the VXDFilterIndex (sidecar file) of a .dat file with nRows rows.
+   * @returns false (and prints what to do) if there is none or it does not match the .dat file (number of rows, size and modification
+   * time of the .dat file when the index was written)
+   */
+  inline bool loadVXDFilterIndex(std::string filename, uint64_t nRows, RootToolBox::VXDFilterIndex& index)
+  {
+    const std::string sidecar = RootToolBox::VXDFilterIndex::getSidecarName(filename);
+    if(!index.load(sidecar)) {
+      std::cerr << "ERROR: could not read the VXD filter index " << sidecar << ". Create it with root2dat -t or datindex -t column" << std::endl;
+      return false;
+    }
+    int64_t datSize, datMTime;
+    if(!DatIndex::statFile(filename, datSize, datMTime) || index.getSourceSize() != datSize || index.getSourceMTime() != datMTime) {
+      std::cerr << "ERROR: the VXD filter index " << sidecar << " was not written for the current version of " << filename
+                << ". Recreate it with datindex -t column" << std::endl;
+      return false;
+    }
+    if(index.getNRows() != nRows) {
+      std::cerr << "ERROR: the VXD filter index " << sidecar << " has " << index.getNRows() << " rows, but " << filename << " has "
+                << nRows << ". Recreate it with datindex -t column" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * keep only the rows of values (row-major, nColumns values per row, starting with row rowBegin of the file) that pass filter.
+   * @returns the number of remaining rows
+   */
+  inline size_t applyVXDFilter(const RootToolBox::VXDFilterIndex& index, unsigned filter, uint64_t rowBegin, size_t nColumns,
+                               std::vector<double>& values)
+  {
+    const size_t nRows = nColumns ? values.size() / nColumns : 0;
+    size_t nKept = 0;
+    for(size_t i = 0; i < nRows; ++i) {
+      if(!index.test(filter, rowBegin + i)) continue;
+      if(nKept != i) std::copy(values.begin() + i * nColumns, values.begin() + (i + 1) * nColumns, values.begin() + nKept * nColumns);
+      nKept++;
+    }
+    values.resize(nKept * nColumns);
+    return nKept;
+  }
+}